@@ -2,10 +2,38 @@ set(CONFIG_HWMOCK_SPI
     ON
     CACHE INTERNAL "SPI hw support")
 
+set(CONFIG_HWMOCK_UART
+    ON
+    CACHE INTERNAL "UART hw support")
+
+set(CONFIG_HWMOCK_I2C
+    ON
+    CACHE INTERNAL "I2C hw support")
+
+set(CONFIG_HWMOCK_MAILBOX
+    ON
+    CACHE INTERNAL "host-soc shared memory mailbox support")
+
 set(CONFIG_HWMOCK_TESTS
     ON
     CACHE INTERNAL "hwmock unit tests")
 
+set(CONFIG_HWMOCK_TOOLS
+    ON
+    CACHE INTERNAL "hwmock host tools")
+
 set(CONFIG_HWMOCK_IRQ_SIGNUM
     "(SIGRTMIN + 3)"
     CACHE INTERNAL "Irq signal number used")
+
+set(CONFIG_HWMOCK_IRQ_LINES
+    "256"
+    CACHE INTERNAL "Number of irq lines per irq controller, multiple of 64")
+
+set(CONFIG_HWMOCK_IRQ_PRIORITIES
+    "16"
+    CACHE INTERNAL "Number of irq priority levels, at most 32")
+
+set(CONFIG_HWMOCK_IRQ_CHANNELS
+    "4"
+    CACHE INTERNAL "Number of signals, after the irq one, shared by the irq handlers")
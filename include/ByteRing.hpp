@@ -0,0 +1,148 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_BYTERING_HPP
+#define __HWMOCKER_BYTERING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace HWMocker {
+
+///
+/// class ByteRing
+///
+/// Single producer, single consumer ring of bytes: the producer only moves the
+/// tail and the consumer the head, so both sides copy without lock, in at most
+/// two chunks around the end of the ring. The consumer may also read in place:
+/// it gets the contiguous span at the head and consumes it once done.
+///
+/// The head and the tail sit on their own cache lines, each side with its copy
+/// of the other position, only reloaded when the ring looks full or empty.
+class ByteRing {
+  public:
+    static constexpr size_t cache_line = 64;
+
+    ///
+    /// Allocates the ring, emptied
+    /// @param  size power of 2
+    void resize(size_t size) {
+        data.reset(new uint8_t[size]);
+        this->size = size;
+        reset();
+    }
+
+    /// Empties the ring, neither side may use it meanwhile
+    void reset() {
+        head.store(0);
+        tail.store(0);
+        head_cache = 0;
+        tail_cache = 0;
+    }
+
+    size_t capacity() { return size; }
+    size_t level() {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    ///
+    /// @return the number of bytes written, fewer than count when full
+    size_t write(const void *buf, size_t count) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        if (count > size - (pos - head_cache))
+            head_cache = head.load(std::memory_order_acquire);
+        count = std::min(count, size - (pos - head_cache));
+        if (!count)
+            return 0;
+        size_t offset = pos & (size - 1);
+        size_t first = std::min(count, size - offset);
+        memcpy(&data[offset], buf, first);
+        memcpy(&data[0], (const uint8_t *)buf + first, count - first);
+        tail.store(pos + count, std::memory_order_release);
+        return count;
+    }
+
+    ///
+    /// @return the number of bytes read, fewer than count when empty
+    size_t read(void *buf, size_t count) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        count = std::min(count, readable(pos, count));
+        if (!count)
+            return 0;
+        size_t offset = pos & (size - 1);
+        size_t first = std::min(count, size - offset);
+        memcpy(buf, &data[offset], first);
+        memcpy((uint8_t *)buf + first, &data[0], count - first);
+        head.store(pos + count, std::memory_order_release);
+        return count;
+    }
+
+    ///
+    /// @return the number of contiguous bytes readable in place, up to the end
+    /// of the ring
+    /// @param  span set to the first of them
+    size_t read_span(const uint8_t **span) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        size_t offset = pos & (size - 1);
+        *span = &data[offset];
+        return std::min(readable(pos, size - offset), size - offset);
+    }
+
+    ///
+    /// Frees bytes read in place
+    /// @return the number of bytes consumed, fewer than count when empty
+    size_t consume(size_t count) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        count = std::min(count, readable(pos, count));
+        head.store(pos + count, std::memory_order_release);
+        return count;
+    }
+
+    ///
+    /// @return the free running count of bytes ever written
+    size_t produced() { return tail.load(std::memory_order_acquire); }
+
+  private:
+    std::unique_ptr<uint8_t[]> data;
+    size_t size = 0;
+    /// free running positions, the ring offset is modulo size
+    alignas(cache_line) std::atomic<size_t> head = 0;
+    /// consumer copy of the tail
+    size_t tail_cache = 0;
+    alignas(cache_line) std::atomic<size_t> tail = 0;
+    /// producer copy of the head
+    size_t head_cache = 0;
+
+    /// Consumer side: reloads the tail when fewer than count bytes are cached
+    size_t readable(size_t pos, size_t count) {
+        if (count > tail_cache - pos)
+            tail_cache = tail.load(std::memory_order_acquire);
+        return tail_cache - pos;
+    }
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_BYTERING_HPP
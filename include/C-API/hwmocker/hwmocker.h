@@ -32,6 +32,10 @@ extern "C" {
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 struct hwmocker;
 
@@ -51,16 +55,400 @@ void hwmocker_set_host_ready(struct hwmocker *mocker);
 void hwmocker_wait_soc_ready(struct hwmocker *mocker);
 void hwmocker_wait_host_ready(struct hwmocker *mocker);
 
+/*
+ * Simulation time in ns, the time the modeled durations wait for. With the system "time" config
+ * "virtual", they jump the clock to their end instead of sleeping.
+ */
+unsigned long long hwmocker_get_time_ns(struct hwmocker *mocker);
+
+/*
+ * The irq line of a gpio is its pin number: gpio pins and device "irq" configs share the
+ * HWMOCK_IRQ_LINES lines of a processing unit. Returns -EINVAL if the pin is not a gpio or is
+ * not below HWMOCK_IRQ_LINES, -EBUSY if a device irq already uses the line.
+ */
 int hwmocker_set_gpio_irq_handler(void *hw_element, unsigned int pin_idx, int (*handler)(void));
+/* trigger is a mask of enum hwmocker_irq_type, both edges by default */
+int hwmocker_set_gpio_irq_trigger(void *hw_element, unsigned int pin_idx, unsigned int trigger);
 void hwmocker_set_gpio_level(void *hw_element, unsigned int pin_idx, bool level);
+bool hwmocker_get_gpio_level(void *hw_element, unsigned int pin_idx);
+/*
+ * Block until an edge (mask of HWMOCKER_IRQ_RISING_EDGE and HWMOCKER_IRQ_FALLING_EDGE) or until
+ * the level of a gpio, timeout_us negative to wait forever. The pin must not become an irq gpio
+ * meanwhile. Returns 0, -ETIMEDOUT or -EINVAL.
+ */
+int hwmocker_gpio_wait_edge(void *hw_element, unsigned int pin_idx, unsigned int type,
+                            int timeout_us);
+int hwmocker_gpio_wait_level(void *hw_element, unsigned int pin_idx, bool level, int timeout_us);
+
+/*
+ * Gpio ports: banks of up to 64 gpios updated and propagated at once, bit n is the port pin n.
+ * Port pins are a namespace of their own: they are not gpio pins, the gpio level and wait calls
+ * do not see them.
+ */
+void *hwmocker_get_gpio_port(void *hw_element, unsigned int port_idx);
+void hwmocker_gpio_port_set_mask(void *port, uint64_t mask);
+void hwmocker_gpio_port_clear_mask(void *port, uint64_t mask);
+void hwmocker_gpio_port_toggle_mask(void *port, uint64_t mask);
+uint64_t hwmocker_gpio_port_read(void *port);
+/* The handler gets the irq_mask pins changed by the remote port, -ENOENT without port irq */
+int hwmocker_gpio_port_set_irq_handler(void *port, uint64_t irq_mask,
+                                       int (*handler)(uint64_t changed));
+
+/* Interrupt check points, required with the "doorbell" irq delivery */
+void hwmocker_poll_irqs(void *hw_element);
+int hwmocker_wait_irq(void *hw_element, int timeout_us);
+
+/* Irq lines are the gpio pin numbers and the configured device irqs, 0 is the highest priority */
+int hwmocker_set_irq_priority(void *hw_element, unsigned int irqn, unsigned int priority);
+
+/*
+ * Nested interrupts: a line preempts the running handler when its group priority is higher.
+ * The subpriority_bits low bits of the priorities are not used for preemption.
+ */
+int hwmocker_set_irq_priority_grouping(void *hw_element, unsigned int subpriority_bits);
+/* Mask the lines of a group priority lower or equal to basepri's one, 0 to unmask them all */
+int hwmocker_set_irq_basepri(void *hw_element, unsigned int basepri);
+unsigned int hwmocker_get_irq_basepri(void *hw_element);
+/* Priority of the running handler, HWMOCK_IRQ_PRIORITIES if none */
+unsigned int hwmocker_get_irq_running_priority(void *hw_element);
+
+struct hwmocker_irq_stats {
+    unsigned long long raised;    /* number of raises */
+    unsigned long long delivered; /* number of handler runs */
+    unsigned long long merged;    /* raises merged into another handler run */
+    unsigned long long polled;    /* handler runs while the controller was polling */
+};
+
+/* Run the handler once per max_events raises, at most max_delay_us after the first one */
+int hwmocker_set_irq_coalescing(void *hw_element, unsigned int irqn, unsigned int max_events,
+                                unsigned int max_delay_us);
+/* Poll every interval_us when notified more than budget times per interval, 0 to disable */
+int hwmocker_set_irq_polling(void *hw_element, unsigned int budget, unsigned int interval_us);
+int hwmocker_get_irq_stats(void *hw_element, unsigned int irqn, struct hwmocker_irq_stats *stats);
+
+/* Latencies from the first raise of an irq to the start of its handler, in ns */
+struct hwmocker_irq_latency {
+    unsigned long long count;
+    unsigned long long min;
+    unsigned long long max;
+    unsigned long long mean;
+    unsigned long long p50;
+    unsigned long long p90;
+    unsigned long long p99;
+    unsigned long long p999;
+};
+
+void hwmocker_set_irq_latency_tracking(void *hw_element, bool enable);
+/* Returns -ENODATA if the latency tracking was never enabled */
+int hwmocker_get_irq_latency(void *hw_element, unsigned int irqn,
+                             struct hwmocker_irq_latency *latency);
+void hwmocker_reset_irq_latencies(void *hw_element);
+/* One line per irq with latencies recorded */
+void hwmocker_dump_irq_latencies(void *hw_element, FILE *stream);
+
+/*
+ * Run the irq handler out of the signal handler, on the softirq thread or at the
+ * interrupt check points depending on the system "bottom-half" config
+ */
+int hwmocker_set_irq_bottom_half(void *hw_element, unsigned int irqn, bool bottom_half);
 
 #ifdef CONFIG_HWMOCK_SPI
+/* Segments of an iovec list */
+#define HWMOCKER_SPI_MAX_SEGMENTS 16
+
 void *hwmocker_get_spi_device(void *hw_element, unsigned int spi_idx);
+/*
+ * A master "spi" config with "csn-pins" drives a bus of targets, the slaves whose "csn-pin" is
+ * connected to one of them. Its transfers go to the selected target, the first one by default,
+ * and hold its chip select low. Returns -EINVAL beyond the chip selects, -ENODEV without target.
+ */
+int hwmocker_spi_select(void *spi_dev, unsigned int cs);
 void hwmocker_spi_enable_irq(void *hw_element);
 void hwmocker_spi_disable_irq(void *hw_element);
 int hwmocker_spi_xfer(void *spi_dev, const void *txbuf, void *rxbuf, size_t size);
 int hwmocker_spi_xfer_async(void *spi_dev, const void *txbuf, void *rxbuf, size_t size,
                             int (*callback)(void *ctx), void *ctx);
+/*
+ * Scatter-gather transfers of the largest of the tx and rx sizes, copied segment to segment.
+ * The iovec arrays may be reused once the call returns, not the buffers they point to.
+ * Returns -E2BIG above HWMOCKER_SPI_MAX_SEGMENTS segments.
+ */
+int hwmocker_spi_xfer_iov(void *spi_dev, const struct iovec *tx_iov, int tx_count,
+                          const struct iovec *rx_iov, int rx_count);
+int hwmocker_spi_xfer_iov_async(void *spi_dev, const struct iovec *tx_iov, int tx_count,
+                                const struct iovec *rx_iov, int rx_count,
+                                int (*callback)(void *ctx), void *ctx);
+/*
+ * Slave transfer reading the master tx segments in place: *rx_iov points to them and the master
+ * stays in its transfer until hwmocker_spi_release_borrowed()
+ */
+int hwmocker_spi_xfer_borrow(void *spi_dev, const struct iovec *tx_iov, int tx_count,
+                             size_t size, const struct iovec **rx_iov, int *rx_count);
+int hwmocker_spi_release_borrowed(void *spi_dev);
+/*
+ * Slave asynchronous transfers are queued up to the spi "queue-depth" config, -EBUSY beyond, and
+ * complete in order. The status is the transferred size.
+ */
+int hwmocker_spi_submit(void *spi_dev, const struct iovec *tx_iov, int tx_count,
+                        const struct iovec *rx_iov, int rx_count,
+                        int (*callback)(void *ctx, int status), void *ctx);
+
+/*
+ * Bus statistics, the transfers last their modeled time with the spi "clk-hz", "word-bits" (8 by
+ * default) and "word-gap-ns" configs. The bus utilization is busy_ns / elapsed_ns.
+ */
+struct hwmocker_spi_stats {
+    unsigned long long xfers;
+    unsigned long long bytes;
+    unsigned long long busy_ns;    /* modeled transfer time, 0 without clk-hz */
+    unsigned long long elapsed_ns; /* simulation time since the reset */
+};
+
+/* Modeled duration of a transfer of size bytes */
+unsigned long long hwmocker_spi_xfer_duration_ns(void *spi_dev, size_t size);
+void hwmocker_spi_get_stats(void *spi_dev, struct hwmocker_spi_stats *stats);
+void hwmocker_spi_reset_stats(void *spi_dev);
+
+/*
+ * Streaming: while a master streams with its selected target, its chip select stays low and
+ * both ends write into the rx ring, of the spi "stream-ring-size" config (4096 by default), of
+ * the other one without handshake. The normal master transfers return -EBUSY meanwhile.
+ */
+#define HWMOCKER_SPI_STREAM_RX 1    /* the rx ring reached the watermark */
+#define HWMOCKER_SPI_STREAM_START 2 /* the master started a stream, the rx ring is empty */
+#define HWMOCKER_SPI_STREAM_STOP 4  /* the master stopped the stream */
+
+int hwmocker_spi_stream_start(void *spi_dev);
+int hwmocker_spi_stream_stop(void *spi_dev);
+/* Returns the number of bytes written or read, fewer when the ring is full or empty */
+ssize_t hwmocker_spi_stream_write(void *spi_dev, const void *buf, size_t size);
+ssize_t hwmocker_spi_stream_read(void *spi_dev, void *buf, size_t size);
+size_t hwmocker_spi_stream_level(void *spi_dev);
+/*
+ * The handler runs from the spi irq with the events, HWMOCKER_SPI_STREAM_RX when the rx ring
+ * level crosses the watermark: the handler should drain it. 0 disables the watermark.
+ */
+int hwmocker_spi_stream_set_handler(void *spi_dev, size_t watermark,
+                                    int (*handler)(unsigned int events, void *ctx), void *ctx);
+
+/*
+ * A slave with a "responder" config is a register map answering its master inline, in the
+ * master transfer, without slave thread nor handshake. The first byte of a transfer is the
+ * command: a canned command of "commands" answers its "response", otherwise the command holds
+ * the register address, of "address-mask", and the read bit, of "read-mask". The next bytes read
+ * or write the registers from this address, auto incremented, except the "read-only" ones. The
+ * miso bytes of the command are the "status". The slave transfers return -EBUSY.
+ * The register accessors below return -ENODEV without responder, -EINVAL past the map.
+ */
+int hwmocker_spi_responder_read(void *spi_dev, unsigned int address, void *buf, size_t size);
+int hwmocker_spi_responder_write(void *spi_dev, unsigned int address, const void *buf,
+                                 size_t size);
+
+/*
+ * A slave with a "bit-bang" config, {"mode": 0..3, "lsb-first": false}, decodes a master
+ * bit-banging gpios connected to its pins: a chip select window transfers its oldest queued
+ * transfer, completed with the number of whole bytes clocked, up to its size, once the chip
+ * select is released. The bytes clocked without queued transfer are dropped, zeros are shifted
+ * out past the transfer.
+ */
+
+/* Gpios of the host or soc bit-banging a spi master, the chip select is left to the caller */
+struct hwmocker_spi_bitbang {
+    unsigned int clk_pin;
+    unsigned int mosi_pin;
+    unsigned int miso_pin;
+    unsigned int mode; /* 0..3 */
+    int lsb_first;
+};
+
+/*
+ * Bit-bangs size bytes, zeros if txbuf is NULL, and reads the miso ones into rxbuf if not NULL.
+ * A selected bit-bang slave of the same mode and bit order, the only receiver of the clock, takes
+ * the bytes whole: their clock edges are skipped, mosi and miso only take the level of their
+ * last bit. Otherwise every clock edge is driven. Returns size, -EINVAL if a pin is not a gpio
+ * or the mode is not in 0..3.
+ */
+int hwmocker_spi_bitbang_xfer(void *hw_element, const struct hwmocker_spi_bitbang *bus,
+                              const void *txbuf, void *rxbuf, size_t size);
+
+/*
+ * Dma engines of the "dma" config run rings of descriptors against a spi device, one transfer
+ * per descriptor. A descriptor belongs to the engine while HWMOCKER_DMA_DESC_OWN is set: the
+ * engine clears it once the transfer is done and its status, the transferred size or a negative
+ * errno, is written. The engine runs the owned descriptors from its position on a kick and stops
+ * after a descriptor without HWMOCKER_DMA_DESC_CHAIN, on a descriptor it does not own or on an
+ * error.
+ */
+#define HWMOCKER_DMA_DESC_OWN 1
+#define HWMOCKER_DMA_DESC_CHAIN 2
+#define HWMOCKER_DMA_DESC_IRQ 4 /* raise HWMOCKER_DMA_IRQ_DESC once done */
+
+/* Dma irq events, HALF and FULL when the middle and the last descriptors of the ring are done */
+#define HWMOCKER_DMA_IRQ_DESC 1
+#define HWMOCKER_DMA_IRQ_HALF 2
+#define HWMOCKER_DMA_IRQ_FULL 4
+#define HWMOCKER_DMA_IRQ_ERROR 8
+
+struct hwmocker_dma_desc {
+    const void *src; /* NULL to send zeros */
+    void *dst;       /* NULL to drop the received bytes */
+    uint32_t len;
+    uint32_t flags;
+    int32_t status;
+};
+
+struct hwmocker_dma_stats {
+    unsigned long long descriptors; /* descriptors done without error */
+    unsigned long long bytes;
+    unsigned long long errors;
+    unsigned long long busy_ns; /* simulation time in the transfers, waits for the peer included */
+};
+
+void *hwmocker_get_dma(void *hw_element, unsigned int dma_idx);
+/* The ring memory must stay valid while the engine may run it, -EBUSY while it runs */
+int hwmocker_dma_set_ring(void *dma, struct hwmocker_dma_desc *ring, unsigned int count);
+int hwmocker_dma_kick(void *dma);
+/* The handler gets the irq_mask events since its previous call, -ENOENT without dma irq */
+int hwmocker_dma_set_irq_handler(void *dma, unsigned int irq_mask,
+                                 int (*handler)(unsigned int status, void *ctx), void *ctx);
+void hwmocker_dma_get_stats(void *dma, struct hwmocker_dma_stats *stats);
+#endif
+
+#ifdef CONFIG_HWMOCK_UART
+/*
+ * A "uart" config, {"index", "tx-pin", "rx-pin", "baud", "fifo-depth", "irq"}, connects to the
+ * uart whose rx pin is connected to its tx pin. A write copies into the rx fifo of the peer and
+ * returns fewer bytes when it is full, -ENOTCONN without peer. With a baud rate, 8N1 frames by
+ * default, a writer ahead of its line by more than the fifo depth waits for it, on the simulation
+ * clock: a stream runs at the baud rate.
+ */
+#define HWMOCKER_UART_IRQ_RX 1       /* the rx fifo level reached the rx threshold */
+#define HWMOCKER_UART_IRQ_TX_EMPTY 2 /* the peer read all the bytes written */
+
+struct hwmocker_uart_stats {
+    unsigned long long tx_bytes;
+    unsigned long long rx_bytes;
+    unsigned long long busy_ns;    /* modeled tx line time, 0 without baud */
+    unsigned long long elapsed_ns; /* simulation time since the reset */
+};
+
+void *hwmocker_get_uart(void *hw_element, unsigned int uart_idx);
+ssize_t hwmocker_uart_write(void *uart, const void *buf, size_t size);
+ssize_t hwmocker_uart_read(void *uart, void *buf, size_t size);
+/*
+ * Zero copy read: returns the number of contiguous bytes at the head of the rx fifo, read in
+ * place from *span until consumed
+ */
+size_t hwmocker_uart_read_span(void *uart, const void **span);
+size_t hwmocker_uart_consume(void *uart, size_t size);
+size_t hwmocker_uart_rx_level(void *uart);
+/* Modeled line time of size bytes */
+unsigned long long hwmocker_uart_xfer_duration_ns(void *uart, size_t size);
+/*
+ * The handler gets the irq_mask events since its previous call, -ENOENT without uart irq,
+ * -EINVAL if rx_threshold exceeds the fifo
+ */
+int hwmocker_uart_set_irq_handler(void *uart, unsigned int irq_mask, size_t rx_threshold,
+                                  int (*handler)(unsigned int status, void *ctx), void *ctx);
+void hwmocker_uart_get_stats(void *uart, struct hwmocker_uart_stats *stats);
+void hwmocker_uart_reset_stats(void *uart);
+#endif
+
+#ifdef CONFIG_HWMOCK_I2C
+/*
+ * An "i2c" config, {"index", "scl-pin", "sda-pin", "controller", "clk-hz", "addresses"}, is a
+ * controller or a target. The bus of a controller gets the 7 bit "addresses" of the targets whose
+ * pins are connected to its own ones. A transfer runs its messages with a repeated start between
+ * them and a stop at the end, calling the target callbacks inline. It lasts the time to clock its
+ * bits at "clk-hz", 100kHz by default, plus the clock stretching of the targets, on the
+ * simulation clock.
+ */
+#define HWMOCKER_I2C_ADDRESSES 128
+#define HWMOCKER_I2C_M_RD 1 /* the message reads from the target */
+
+struct hwmocker_i2c_msg {
+    unsigned short addr;
+    unsigned short flags;
+    size_t len;
+    unsigned char *buf;
+};
+
+struct hwmocker_i2c_target_ops {
+    /* Returns the number of bytes acknowledged, fewer ends the transfer with -EIO */
+    int (*write)(void *ctx, const unsigned char *buf, size_t size);
+    /* Returns the number of bytes provided, the bus reads 0xff past them */
+    int (*read)(void *ctx, unsigned char *buf, size_t size);
+    /* Optional: (repeated) start addressing the target, and stop of the transfer */
+    void (*start)(void *ctx, int read);
+    void (*stop)(void *ctx);
+};
+
+struct hwmocker_i2c_stats {
+    unsigned long long transfers;
+    unsigned long long messages;
+    unsigned long long bytes;
+    unsigned long long nacks;
+    unsigned long long busy_ns;    /* modeled bus time, clock stretching included */
+    unsigned long long elapsed_ns; /* simulation time since the reset */
+};
+
+void *hwmocker_get_i2c_device(void *hw_element, unsigned int i2c_idx);
+/*
+ * Returns the number of messages transferred, -ENXIO if an address was not acknowledged, -EIO a
+ * written byte, -ENOTCONN for a target
+ */
+int hwmocker_i2c_transfer(void *i2c_dev, struct hwmocker_i2c_msg *msgs, int count);
+unsigned long long hwmocker_i2c_xfer_duration_ns(void *i2c_dev,
+                                                 const struct hwmocker_i2c_msg *msgs, int count);
+/*
+ * Returns -ENOENT if the address is not in the target "addresses". May be called
+ * while the controller runs: a transfer sees either the previous ops and ctx or
+ * the new ones, never a mix. A callback already running may still use the
+ * previous ctx, so keep it alive until the transfers addressing it are done.
+ */
+int hwmocker_i2c_set_target(void *i2c_dev, unsigned int address,
+                            const struct hwmocker_i2c_target_ops *ops, void *ctx);
+/* Holds the clock low for ns more, called from the target callbacks */
+void hwmocker_i2c_stretch(void *i2c_dev, unsigned long long ns);
+/* Returns -ENOTCONN for a target */
+int hwmocker_i2c_get_stats(void *i2c_dev, struct hwmocker_i2c_stats *stats);
+void hwmocker_i2c_reset_stats(void *i2c_dev);
+#endif
+
+#ifdef CONFIG_HWMOCK_MAILBOX
+/*
+ * A "host-soc-mailboxes" system config, [{"index", "ring-size", "host-irq", "soc-irq"}], shares
+ * a ring of "ring-size" bytes, a power of 2, for each direction between the host and the soc.
+ * Each side gets an endpoint which writes into the ring of its peer and reads its own one. A
+ * write rings the doorbell of the peer, the rx irq, unless the peer handler is running: the
+ * handler is expected to drain the ring and the doorbell rings again after it if bytes came
+ * meanwhile. A write short of space gets a tx irq once the peer read.
+ */
+#define HWMOCKER_MAILBOX_IRQ_RX 1 /* doorbell: the peer wrote into the ring */
+#define HWMOCKER_MAILBOX_IRQ_TX 2 /* the peer read from the ring after a short write */
+
+struct hwmocker_mailbox_stats {
+    unsigned long long tx_bytes;
+    unsigned long long rx_bytes;
+    unsigned long long doorbells;  /* writes which rang the peer doorbell */
+    unsigned long long suppressed; /* writes seen by the draining peer handler */
+};
+
+void *hwmocker_get_mailbox(void *hw_element, unsigned int mailbox_idx);
+ssize_t hwmocker_mailbox_write(void *mailbox, const void *buf, size_t size);
+ssize_t hwmocker_mailbox_read(void *mailbox, void *buf, size_t size);
+/*
+ * Zero copy read: returns the number of contiguous bytes at the head of the ring, read in place
+ * from *span until consumed
+ */
+size_t hwmocker_mailbox_read_span(void *mailbox, const void **span);
+size_t hwmocker_mailbox_consume(void *mailbox, size_t size);
+size_t hwmocker_mailbox_rx_level(void *mailbox);
+/* The handler gets the irq_mask events since its previous call, -ENOENT without irq */
+int hwmocker_mailbox_set_irq_handler(void *mailbox, unsigned int irq_mask,
+                                     int (*handler)(unsigned int status, void *ctx), void *ctx);
+void hwmocker_mailbox_get_stats(void *mailbox, struct hwmocker_mailbox_stats *stats);
+void hwmocker_mailbox_reset_stats(void *mailbox);
 #endif
 
 #ifdef __cplusplus
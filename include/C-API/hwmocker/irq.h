@@ -41,7 +41,9 @@ enum hwmocker_irq_type {
 
 typedef int (*irq_handler_t)(int irq_number, void *priv);
 
+/* NULL if the irq signals cannot be registered or too many handlers exist */
 struct hwmocker_irq_handler *hwmocker_irq_handler_create(struct hwmocker *mocker, int is_device);
+/* The irq signals still queued for irqh are ignored, not to be called from its irq handlers */
 void hwmocker_irq_handler_destroy(struct hwmocker_irq_handler *irqh);
 
 int hwmocker_irq_handler_declare_irq(struct hwmocker_irq_handler *irqh, int irq_number);
@@ -53,7 +55,18 @@ int hwmocker_irq_handler_unregister_handler(struct hwmocker_irq_handler *irqh, i
 
 struct hwmocker_irq_desc *hwmocker_irq_handler_get_irq_desc(struct hwmocker_irq_handler *irqh,
                                                             int irq_number);
+/* Pulse: fires the rising edge and high level handlers */
 int hwmocker_irq_handler_trigger_irq(struct hwmocker_irq_desc *desc);
+/*
+ * Drives the irq line: fires the handlers of the edge and of the level which
+ * became active. Writing an already active level does not fire again, except
+ * once after the handlers if it was written while they ran.
+ */
+int hwmocker_irq_handler_set_irq_level(struct hwmocker_irq_desc *desc, int level);
+
+/* A masked irq triggered is postponed until it is unmasked */
+int hwmocker_irq_handler_mask_irq(struct hwmocker_irq_desc *desc);
+int hwmocker_irq_handler_unmask_irq(struct hwmocker_irq_desc *desc);
 
 #ifdef __cplusplus
 } /* extern "C" */
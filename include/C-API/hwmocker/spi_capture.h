@@ -0,0 +1,74 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_SPI_CAPTURE_H__
+#define __HWMOCKER_SPI_CAPTURE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Spi capture log, enabled by the system "spi-capture" config: {"file": "spi.cap", "size-kb": N}.
+ * The file starts with a header followed by the transactions records, in the order of their
+ * transfer. A record is 8 bytes aligned: its header, the mosi payload, then the miso one. A
+ * payload is shorter than the transaction length when its sender had fewer bytes to send, the
+ * rest of the transaction is clocked as zeros. A record without its magic was being written when
+ * the log was cut, the log ends at a zero size.
+ */
+#define HWMOCKER_SPI_CAPTURE_MAGIC "HWMSPCAP"
+#define HWMOCKER_SPI_CAPTURE_VERSION 1
+#define HWMOCKER_SPI_CAPTURE_RECORD_MAGIC 0x43505348 /* "HSPC" */
+
+/* Processing unit of the master */
+#define HWMOCKER_SPI_CAPTURE_HOST 0
+#define HWMOCKER_SPI_CAPTURE_SOC 1
+/* master_index of the transfers of a master bit-banged over gpios */
+#define HWMOCKER_SPI_CAPTURE_BITBANG 0xff
+
+struct hwmocker_spi_capture_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+};
+
+struct hwmocker_spi_capture_record {
+    uint32_t magic;        /* HWMOCKER_SPI_CAPTURE_RECORD_MAGIC once the record is complete */
+    uint32_t size;         /* record size, header and payloads padded to 8 bytes */
+    uint64_t timestamp_ns; /* simulation time of the transfer */
+    uint8_t master;        /* HWMOCKER_SPI_CAPTURE_HOST or HWMOCKER_SPI_CAPTURE_SOC */
+    uint8_t cs;            /* chip select of the master */
+    uint8_t master_index;  /* spi index of the master */
+    uint8_t target_index;  /* spi index of the slave */
+    uint32_t length;       /* clocked bytes */
+    uint32_t mosi_length;
+    uint32_t miso_length;
+};
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __HWMOCKER_SPI_CAPTURE_H__ */
@@ -0,0 +1,52 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __HWMOCKER_CLOCK_HPP
+#define __HWMOCKER_CLOCK_HPP
+
+#include <cstdint>
+
+#include <time.h>
+
+namespace HWMocker {
+
+///
+/// @return the CLOCK_MONOTONIC time in nanoseconds
+static inline uint64_t clock_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+///
+/// Converts a CLOCK_MONOTONIC time in nanoseconds into a timespec
+/// @return ts
+/// @param  ns
+/// @param  ts storage
+static inline struct timespec *clock_timespec(uint64_t ns, struct timespec *ts) {
+    ts->tv_sec = ns / 1000000000ULL;
+    ts->tv_nsec = ns % 1000000000ULL;
+    return ts;
+}
+} // namespace HWMocker
+
+#endif // __HWMOCKER_CLOCK_HPP
@@ -0,0 +1,141 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_DMACONTROLLER_HPP
+#define __HWMOCKER_DMACONTROLLER_HPP
+
+#include "HwElement.hpp"
+#include "HwIrq.hpp"
+#include "IrqController.hpp"
+#include "SpiDevice.hpp"
+#include <hwmocker/hwmocker.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include <pthread.h>
+
+namespace HWMocker {
+
+void *dma_thread_fn(void *data);
+
+///
+/// class DmaController
+///
+/// Dma engine feeding a spi device from a ring of descriptors in the driver
+/// memory. The engine thread runs the descriptors owned by the engine from its
+/// position, one spi transfer each, gives them back with their status and
+/// follows the chain flags. Its irq latches the descriptor, half ring, full
+/// ring and error events of its irq mask in a status word given to the handler.
+class DmaController : virtual public HwElement {
+  public:
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    DmaController(IrqController *irq_controller, HwIrq *irq = new HwIrq());
+
+    ///
+    /// Empty Destructor: stops the engine thread
+    virtual ~DmaController();
+
+    ///
+    /// @return 0 on success
+    /// @param  config {"index", "spi", "irq"}
+    int load_config(json config);
+
+    unsigned int get_dma_index() { return dma_index; }
+    unsigned int get_spi_index() { return spi_index; }
+    void set_spi_device(SpiDevice *spi_dev) { this->spi_dev = spi_dev; }
+
+    /// Sets the descriptor ring and rewinds the engine to its first descriptor
+    /// @return 0 on success, -EINVAL without descriptors, -EBUSY while the
+    /// engine runs descriptors
+    int set_ring(struct hwmocker_dma_desc *ring, unsigned int count);
+
+    /// Runs the owned descriptors from the engine position, the engine runs
+    /// nothing before its first kick
+    /// @return 0 on success, -EINVAL without ring
+    int kick();
+
+    /// Cancels the running descriptor and joins the engine thread, before
+    /// the spi devices it may wait on are destroyed
+    void stop();
+
+    /// @return the index of the next descriptor to run
+    unsigned int get_position() { return position.load(); }
+
+    ///
+    /// @return 0 on success, -ENOENT if the engine has no irq
+    /// @param  irq_mask HWMOCKER_DMA_IRQ_* events raising the irq
+    /// @param  handler called with the events since its previous call
+    int set_irq_handler(unsigned int irq_mask, int (*handler)(unsigned int status, void *ctx),
+                        void *ctx);
+
+    void get_stats(struct hwmocker_dma_stats *stats);
+
+    static bool config_has_dmas(json config) { return config.contains("dma"); }
+
+  private:
+    unsigned int dma_index = 0;
+    unsigned int spi_index = 0;
+    SpiDevice *spi_dev = nullptr;
+
+    /// held by the engine while it runs descriptors, set_ring() does not wait for it
+    pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+    std::atomic<struct hwmocker_dma_desc *> ring = nullptr;
+    unsigned int ring_size = 0;
+    std::atomic<unsigned int> position = 0;
+
+    IrqController *irq_controller = nullptr;
+    HwIrq *irq = nullptr;
+    bool has_irq = false;
+    std::atomic<unsigned int> irq_mask = 0;
+    /// events not handled yet
+    std::atomic<unsigned int> irq_status = 0;
+    int (*handler)(unsigned int status, void *ctx) = nullptr;
+    void *handler_ctx = nullptr;
+
+    std::atomic<uint64_t> descriptors = 0;
+    std::atomic<uint64_t> bytes = 0;
+    std::atomic<uint64_t> errors = 0;
+    std::atomic<uint64_t> busy_ns = 0;
+
+    pthread_t engine_pthread = {0};
+    std::atomic<bool> engine_started = false;
+    std::atomic<bool> engine_stopped = false;
+    std::atomic<uint32_t> engine_kick = 0;
+    /// kicks before the engine thread started
+    uint32_t engine_kick_seen = 0;
+
+    static int dma_irq_handler(void *ctx);
+
+    void start();
+    void run_descriptors();
+    void raise(unsigned int events);
+
+    friend void *dma_thread_fn(void *data);
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_DMACONTROLLER_HPP
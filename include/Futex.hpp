@@ -0,0 +1,91 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __HWMOCKER_FUTEX_HPP
+#define __HWMOCKER_FUTEX_HPP
+
+#include <atomic>
+#include <cstdint>
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace HWMocker {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+
+///
+/// Hints the cpu that the thread is spinning
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+///
+/// Computes the absolute CLOCK_MONOTONIC deadline of a timeout
+/// @return the deadline to give to futex_wait, null if timeout_us is negative
+/// @param  timeout_us
+/// @param  deadline storage
+static inline const struct timespec *futex_deadline(int timeout_us, struct timespec *deadline) {
+    if (timeout_us < 0)
+        return nullptr;
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_us / 1000000;
+    deadline->tv_nsec += (timeout_us % 1000000) * 1000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+///
+/// Sleep while *word == expected
+/// @return 0 when woken up, -ETIMEDOUT, -EAGAIN if the word changed or -EINTR
+/// @param  word
+/// @param  expected
+/// @param  deadline absolute CLOCK_MONOTONIC deadline, null to wait forever
+static inline int futex_wait(std::atomic<uint32_t> *word, uint32_t expected,
+                             const struct timespec *deadline = nullptr) {
+    if (syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT_BITSET_PRIVATE, expected, deadline, NULL,
+                FUTEX_BITSET_MATCH_ANY))
+        return -errno;
+    return 0;
+}
+
+///
+/// Wake up at most count waiters sleeping on word
+/// @return the number of waiters woken up
+/// @param  word
+/// @param  count
+static inline int futex_wake(std::atomic<uint32_t> *word, int count = INT32_MAX) {
+    return syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+} // namespace HWMocker
+
+#endif // __HWMOCKER_FUTEX_HPP
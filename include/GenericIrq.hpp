@@ -25,6 +25,8 @@
 
 namespace HWMocker {
 
+class IrqController;
+
 ///
 /// class GenericIrq
 
@@ -38,6 +40,12 @@ class GenericIrq {
     /// Handle the irq
     /// @return int
     virtual int handle() = 0;
+
+  private:
+    friend class IrqController;
+
+    /// Irq line registered on the IrqController, -1 if none
+    int irq_line = -1;
 };
 } // namespace HWMocker
 
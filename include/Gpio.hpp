@@ -23,8 +23,12 @@
 #ifndef __HWMOCKER_GPIO_HPP
 #define __HWMOCKER_GPIO_HPP
 
+#include "Futex.hpp"
+#include "NetGraph.hpp"
 #include "Pin.hpp"
 
+#include <atomic>
+
 namespace HWMocker {
 
 ///
@@ -54,20 +58,65 @@ class Gpio : public Pin {
     /// @param  value
     void set_value(bool value) {
         /*if (!input)*/ {
+            bool previous = get_value();
             level = value;
             change(value);
+            count_edge(previous, value);
         }
     }
 
     ///
     /// @return bool
-    bool get_value() { return level; }
+    bool get_value() { return graph ? graph->get_level(net_node) : level; }
+
+    bool get_level() { return get_value(); }
+
+    /// Its level is in the net graph
+    bool wants_changes() { return false; }
+
+    ///
+    /// Wait for an edge of the pin, written locally or by a remote driver
+    /// @return 0 on success, -ETIMEDOUT on timeout
+    /// @param  type mask of HWMOCKER_IRQ_RISING_EDGE and HWMOCKER_IRQ_FALLING_EDGE
+    /// @param  timeout_us negative to wait forever
+    int wait_edge(unsigned int type, int timeout_us);
+
+    ///
+    /// Wait for the pin level, returns immediately if it is the current one
+    /// @return 0 on success, -ETIMEDOUT on timeout
+    /// @param  value
+    /// @param  timeout_us negative to wait forever
+    int wait_level(bool value, int timeout_us);
 
   protected:
     bool input;
     bool level;
 
-    void on_change(bool value) { level = value; }
+    /// Edge counters, edges is the futex word of the waiters
+    std::atomic<uint32_t> rising = 0;
+    std::atomic<uint32_t> falling = 0;
+    std::atomic<uint32_t> edges = 0;
+    std::atomic<uint32_t> waiters = 0;
+    std::atomic<bool> watched = false;
+
+    void on_change(bool value) {
+        bool previous = level;
+        level = value;
+        count_edge(previous, value);
+    }
+
+    void count_edge(bool previous, bool value) {
+        if (previous == value)
+            return;
+
+        (value ? rising : falling).fetch_add(1);
+        edges.fetch_add(1);
+        if (waiters.load())
+            futex_wake(&edges);
+    }
+
+    /// Gets the changes of the net graph from now on
+    void watch();
 };
 } // namespace HWMocker
 
@@ -26,11 +26,19 @@
 #include "GenericIrq.hpp"
 #include "Gpio.hpp"
 #include "IrqController.hpp"
+#include <hwmocker/irq.h>
+
+#include <atomic>
 
 namespace HWMocker {
 
 ///
 /// class GpioIrq
+///
+/// Gpio raising an irq on its edges and/or levels. A level irq is raised when
+/// the line becomes active; holding it active does not raise it again, but
+/// writing it active while its handler runs re-asserts it once after the end of
+/// the handler.
 
 class GpioIrq : public Gpio, virtual public GenericIrq {
   public:
@@ -51,9 +59,17 @@ class GpioIrq : public Gpio, virtual public GenericIrq {
     void enable() {}
     void disable() {}
     bool enabled() { return true; }
-    int handle() { return handler(); }
+    int handle();
     void set_handler(int (*handler)(void)) { this->handler = handler; }
 
+    /// Changes raise the irq
+    bool wants_changes() { return true; }
+
+    ///
+    /// @param  trigger bitmask of enum hwmocker_irq_type
+    void set_trigger(unsigned int trigger) { this->trigger = trigger; }
+    unsigned int get_trigger() { return trigger; }
+
     // Public static attribute accessor methods
 
     // Public attribute accessor methods
@@ -72,13 +88,18 @@ class GpioIrq : public Gpio, virtual public GenericIrq {
 
     // Private attributes
     IrqController *irq_controller;
-    int (*handler)(void);
-
-    void on_change(bool value) {
-        level = value;
-        irq_controller->local_raise(this);
+    int (*handler)(void) = nullptr;
+    unsigned int trigger = HWMOCKER_IRQ_RISING_EDGE | HWMOCKER_IRQ_FALLING_EDGE;
+    /// number of writes of the active level
+    std::atomic<uint32_t> asserted = 0;
+
+    bool is_active(bool value) {
+        return (value && (trigger & HWMOCKER_IRQ_HIGH_LEVEL)) ||
+               (!value && (trigger & HWMOCKER_IRQ_LOW_LEVEL));
     }
 
+    void on_change(bool value);
+
     // Public static attribute accessor methods
 
     // Public attribute accessor methods
@@ -0,0 +1,105 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_GPIOPORT_HPP
+#define __HWMOCKER_GPIOPORT_HPP
+
+#include "HwElement.hpp"
+#include "HwIrq.hpp"
+#include "IrqController.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace HWMocker {
+
+///
+/// class GpioPort
+///
+/// Bank of up to 64 gpios stored in one atomic word. The set, clear and toggle
+/// operations update the whole bank at once. Connected ports share that word,
+/// so both sides see the updates in the same order, and the changed bits are
+/// notified to the remote port. The optional port irq latches the changed bits
+/// of its irq mask in a status word given to the handler.
+class GpioPort : virtual public HwElement {
+  public:
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    GpioPort(IrqController *irq_controller, HwIrq *irq = new HwIrq());
+
+    ///
+    /// Empty Destructor
+    virtual ~GpioPort();
+
+    ///
+    /// @return 0 on success, -EINVAL if the width is not within 1 and 64
+    /// @param  config
+    int load_config(json config);
+
+    unsigned int get_port_index() { return port_index; }
+    unsigned int get_width() { return width; }
+    uint64_t get_pins_mask() { return width >= 64 ? UINT64_MAX : (1ULL << width) - 1; }
+
+    /// Connect both ports, the remote port takes the levels of this one
+    /// @return 0 on success, -EINVAL if their widths differ
+    int connect(GpioPort *remote_port);
+
+    void set_mask(uint64_t mask);
+    void clear_mask(uint64_t mask);
+    void toggle_mask(uint64_t mask);
+    uint64_t read() { return levels->load(std::memory_order_acquire); }
+
+    /// Handle the changes of the irq_mask pins received from the remote port
+    /// @return 0 on success, -ENOENT if the port has no irq
+    /// @param  irq_mask
+    /// @param  handler called with the pins changed since its previous call
+    int set_irq_handler(uint64_t irq_mask, int (*handler)(uint64_t changed));
+
+    static bool config_has_ports(json config) { return config.contains("gpio-ports"); }
+
+  private:
+    unsigned int port_index = 0;
+    unsigned int width = 0;
+    std::atomic<uint64_t> own_levels = 0;
+    /// own_levels or the ones of the connected port
+    std::atomic<uint64_t> *levels = &own_levels;
+    GpioPort *remote_port = nullptr;
+
+    IrqController *irq_controller = nullptr;
+    HwIrq *irq = nullptr;
+    bool has_irq = false;
+    std::atomic<uint64_t> irq_mask = 0;
+    /// changed irq pins not handled yet
+    std::atomic<uint64_t> irq_status = 0;
+    int (*handler)(uint64_t changed) = nullptr;
+
+    static int port_irq_handler(void *ctx);
+
+    void propagate(uint64_t changed);
+    void receive(uint64_t changed);
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_GPIOPORT_HPP
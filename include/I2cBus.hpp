@@ -0,0 +1,97 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_I2CBUS_HPP
+#define __HWMOCKER_I2CBUS_HPP
+
+#include "SimClock.hpp"
+#include <hwmocker/hwmocker.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace HWMocker {
+
+class I2cDevice;
+
+///
+/// class I2cBus
+///
+/// Bus of a controller: the targets connected to its pins, indexed by their 7
+/// bit address. A transfer runs message by message, a repeated start between
+/// two of them and a stop at the end, and calls the callbacks of the addressed
+/// targets inline, in the controller thread. An address or a data byte not
+/// acknowledged ends the transfer.
+///
+/// With a clock rate, a transfer lasts the time to clock its start, address,
+/// data, acknowledge and stop bits, plus the clock stretching of its targets,
+/// on the simulation clock.
+class I2cBus {
+  public:
+    I2cBus(uint64_t clk_hz) : clk_hz(clk_hz) {}
+
+    void set_sim_clock(SimClock *sim_clock) {
+        this->sim_clock = sim_clock;
+        stats_since_ns.store(now_ns());
+    }
+
+    ///
+    /// @return 0 on success, -EINVAL if the address is not 7 bit, -EBUSY if
+    /// another target has it
+    int attach(unsigned int address, I2cDevice *target);
+    I2cDevice *lookup(unsigned int address) {
+        return address < targets.size() ? targets[address] : nullptr;
+    }
+
+    ///
+    /// @return the number of messages transferred, -ENXIO if a target did not
+    /// acknowledge its address, -EIO a data byte, -EINVAL on invalid message
+    int transfer(struct hwmocker_i2c_msg *msgs, int count);
+
+    ///
+    /// @return the modeled duration of the messages without clock stretching,
+    /// 0 without clock rate
+    uint64_t xfer_duration_ns(const struct hwmocker_i2c_msg *msgs, int count);
+
+    void get_stats(struct hwmocker_i2c_stats *stats);
+    void reset_stats();
+
+  private:
+    std::array<I2cDevice *, HWMOCKER_I2C_ADDRESSES> targets = {};
+    SimClock *sim_clock = nullptr;
+    uint64_t clk_hz = 0;
+
+    uint64_t bits_duration_ns(uint64_t bits);
+    uint64_t now_ns() { return sim_clock ? sim_clock->now_ns() : clock_now_ns(); }
+
+    std::atomic<uint64_t> stats_transfers = 0;
+    std::atomic<uint64_t> stats_messages = 0;
+    std::atomic<uint64_t> stats_bytes = 0;
+    std::atomic<uint64_t> stats_nacks = 0;
+    std::atomic<uint64_t> stats_busy_ns = 0;
+    std::atomic<uint64_t> stats_since_ns = 0;
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_I2CBUS_HPP
@@ -0,0 +1,146 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_I2CDEVICE_HPP
+#define __HWMOCKER_I2CDEVICE_HPP
+
+#include "Gpio.hpp"
+#include "HwElement.hpp"
+#include "I2cBus.hpp"
+#include "SimClock.hpp"
+#include <hwmocker/hwmocker.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace HWMocker {
+
+///
+/// class I2cDevice
+///
+/// I2c controller or target on its "scl-pin" and "sda-pin". A controller owns
+/// the bus of the targets whose pins are connected to its own ones, resolved
+/// once when the system is connected, and transfers on it.
+///
+/// A target answers the 7 bit addresses of its "addresses" config, each one
+/// with the callbacks set for it: a target of several sensors is one device.
+/// The callbacks run in the controller transfer, they may stretch the clock.
+class I2cDevice : virtual public HwElement {
+  public:
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    I2cDevice();
+
+    ///
+    /// Empty Destructor
+    virtual ~I2cDevice();
+
+    ///
+    /// @return 0 on success
+    /// @param  config {"index", "scl-pin", "sda-pin", "controller", "clk-hz",
+    /// "addresses"}
+    int load_config(json config);
+
+    unsigned int get_i2c_index() { return i2c_index; }
+    bool is_controller_device() { return is_controller; }
+    std::vector<Pin *> get_pins() { return {scl, sda}; }
+    const std::vector<unsigned int> &get_addresses() { return addresses; }
+
+    void set_sim_clock(SimClock *sim_clock);
+
+    ///
+    /// Puts the addresses of a target connected to the pins of this controller
+    /// on its bus
+    /// @return the number of addresses attached, -EINVAL if not connected
+    int attach(I2cDevice *target);
+
+    ///
+    /// @return the number of messages transferred or a negative errno, see
+    /// I2cBus::transfer, -ENOTCONN for a target
+    int transfer(struct hwmocker_i2c_msg *msgs, int count);
+    uint64_t xfer_duration_ns(const struct hwmocker_i2c_msg *msgs, int count);
+
+    ///
+    /// @return 0 on success, -ENOENT if the target does not have the address
+    int set_target(unsigned int address, const struct hwmocker_i2c_target_ops *ops, void *ctx);
+    ///
+    /// Reads the pair published by set_target, retrying while a set_target
+    /// of the same address is in progress so ops never run with another ctx
+    ///
+    /// @return the callbacks of the address, nullptr if not set
+    const struct hwmocker_i2c_target_ops *get_target(unsigned int address, void **ctx) {
+        TargetSlot &slot = slots[address % HWMOCKER_I2C_ADDRESSES];
+        const struct hwmocker_i2c_target_ops *ops;
+        uint32_t seq;
+
+        do {
+            seq = slot.seq.load(std::memory_order_acquire);
+            ops = slot.ops.load(std::memory_order_relaxed);
+            *ctx = slot.ctx.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || seq != slot.seq.load(std::memory_order_relaxed));
+        return ops;
+    }
+
+    /// Holds the clock low for ns more, called from the target callbacks
+    void stretch(uint64_t ns) { stretch_ns.fetch_add(ns, std::memory_order_relaxed); }
+    uint64_t take_stretch_ns() { return stretch_ns.exchange(0, std::memory_order_relaxed); }
+
+    /// @return -ENOTCONN for a target
+    int get_stats(struct hwmocker_i2c_stats *stats);
+    void reset_stats();
+
+    static bool config_has_device(json config) { return config.contains("i2c"); }
+
+  private:
+    /// ops and ctx are read by the controller thread while the target may
+    /// rebind them, seq is odd during a set_target
+    struct TargetSlot {
+        std::atomic<const struct hwmocker_i2c_target_ops *> ops{nullptr};
+        std::atomic<void *> ctx{nullptr};
+        std::atomic<uint32_t> seq{0};
+        bool declared = false;
+    };
+
+    unsigned int i2c_index = 0;
+    bool is_controller = false;
+    Gpio *scl = nullptr;
+    Gpio *sda = nullptr;
+
+    /// controller bus
+    I2cBus *bus = nullptr;
+    /// target addresses and their callbacks
+    std::vector<unsigned int> addresses;
+    std::array<TargetSlot, HWMOCKER_I2C_ADDRESSES> slots;
+    bool attached = false;
+    std::atomic<uint64_t> stretch_ns = 0;
+
+    bool is_connected(Gpio *pin, Gpio *peer_pin);
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_I2CDEVICE_HPP
@@ -24,9 +24,13 @@
 #define __HWMOCKER_IRQCONTROLLER_HPP
 
 #include "GenericIrq.hpp"
+#include "LatencyHistogram.hpp"
+#include "Workqueue.hpp"
+#include <hwmocker/config.h>
 
+#include <atomic>
+#include <cstdint>
 #include <cstring>
-#include <set>
 #include <string>
 
 #include <errno.h>
@@ -35,10 +39,56 @@
 
 namespace HWMocker {
 
+static_assert(HWMOCK_IRQ_LINES % 64 == 0, "HWMOCK_IRQ_LINES must be a multiple of 64");
+static_assert(HWMOCK_IRQ_PRIORITIES <= 32, "HWMOCK_IRQ_PRIORITIES must be at most 32");
+
+///
+/// struct IrqLineStats
+struct IrqLineStats {
+    /// number of raises
+    uint64_t raised;
+    /// number of handler runs
+    uint64_t delivered;
+    /// raises merged into another handler run
+    uint64_t merged;
+    /// handler runs while the controller was polling
+    uint64_t polled;
+};
+
 ///
 /// class IrqController
+///
+/// NVIC like controller: HWMOCK_IRQ_LINES numbered lines, each one with a
+/// priority (0 is the highest). The pending lines are kept in one atomic bitmap
+/// per priority level so that the dispatch is a find-first-set and never
+/// allocates.
+///
+/// A line can coalesce its raises: it is only set pending after max_events
+/// raises or max_delay_us after its first raise. Under sustained load, the
+/// controller stops notifying its thread on every raise and polls the pending
+/// lines every poll interval instead, until a poll finds nothing to do.
+///
+/// The handler of a bottom half line does not run in the top half: the top
+/// half only acknowledges the line and queues its handler on the workqueue.
+///
+/// Handlers nest: a line preempts the running handler when its group priority
+/// is higher. The priority grouping splits the priorities in a group priority
+/// and a subpriority which only orders the pending lines of a group, and
+/// basepri masks the lines of a group priority lower or equal to its own.
+///
+/// With the latency tracking, the time from the first raise of a line to the
+/// start of its handler is recorded in a histogram per line. A line handler
+/// only runs on one thread at a time, so each histogram has a single writer.
 class IrqController {
   public:
+    /// How the irqs are delivered to the processing unit thread
+    enum class Delivery {
+        /// pthread_kill(HWMOCK_IRQ_SIGNUM), irqs are handled in the signal handler
+        SIGNAL,
+        /// futex doorbell, irqs are handled at the interrupt check points
+        DOORBELL,
+    };
+
     // Constructors/Destructors
 
     ///
@@ -50,6 +100,74 @@ class IrqController {
     virtual ~IrqController();
 
     void start();
+
+    /// Attach an irq to a line
+    /// @return 0 on success, -EINVAL if irqn is out of range, -EBUSY if already used
+    int register_irq(GenericIrq *irq, unsigned int irqn);
+    void unregister_irq(GenericIrq *irq);
+    bool is_line_free(unsigned int irqn) {
+        return irqn < HWMOCK_IRQ_LINES && !lines[irqn].irq.load();
+    }
+
+    /// @return 0 on success, -EINVAL if irqn or priority is out of range
+    int set_priority(unsigned int irqn, unsigned int priority);
+    int get_priority(unsigned int irqn) {
+        return irqn < HWMOCK_IRQ_LINES ? lines[irqn].priority.load() : -EINVAL;
+    }
+
+    /// Split the priorities in group priority and subpriority
+    /// @return 0 on success, -EINVAL if there are less than subpriority_bits
+    /// priority bits
+    /// @param  subpriority_bits low priority bits not used for preemption
+    int set_priority_grouping(unsigned int subpriority_bits);
+    unsigned int get_priority_grouping() { return priority_grouping.load(); }
+
+    /// Mask the lines of a group priority lower or equal to basepri's one
+    /// @return 0 on success, -EINVAL if basepri is out of range
+    /// @param  basepri 0 to unmask all the lines
+    int set_basepri(unsigned int basepri);
+    unsigned int get_basepri() { return basepri.load(); }
+
+    /// @return the priority of the running handler, HWMOCK_IRQ_PRIORITIES if none
+    unsigned int get_running_priority() { return running_priority.load(); }
+
+    /// Coalesce the raises of a line
+    /// @return 0 on success, -EINVAL if irqn is out of range or if max_events
+    /// is greater than 1 without max_delay_us
+    /// @param  max_events raises per handler run, 0 or 1 to disable the coalescing
+    /// @param  max_delay_us maximum delay between the first raise and the handler run
+    int set_coalescing(unsigned int irqn, unsigned int max_events, unsigned int max_delay_us);
+
+    /// Switch to polling when the thread is notified more than budget times
+    /// within interval_us
+    /// @return 0 on success, -EINVAL if the interval is null while budget is not
+    /// @param  budget 0 to disable the adaptive polling
+    /// @param  interval_us
+    int set_polling(unsigned int budget, unsigned int interval_us);
+    bool is_polling() { return polling.load(); }
+
+    /// Run the handler of a line in a bottom half, needs a workqueue
+    /// @return 0 on success, -EINVAL if irqn is out of range or without workqueue
+    int set_bottom_half(unsigned int irqn, bool bottom_half);
+    bool is_bottom_half(unsigned int irqn) {
+        return irqn < HWMOCK_IRQ_LINES && lines[irqn].bottom_half.load();
+    }
+    void set_workqueue(Workqueue *workqueue) { this->workqueue.store(workqueue); }
+
+    /// @return 0 on success, -EINVAL if irqn is out of range
+    int get_stats(unsigned int irqn, IrqLineStats *stats);
+
+    /// Record the raise to handler latencies, the histograms are kept when disabled
+    void set_latency_tracking(bool enable);
+    bool is_latency_tracking() { return latencies.load() != nullptr; }
+    /// @return 0 on success, -EINVAL if irqn is out of range, -ENODATA if the
+    /// latency tracking was never enabled
+    int get_latency(unsigned int irqn, LatencySnapshot *snapshot);
+    void reset_latencies();
+
+    bool is_pending(unsigned int irqn);
+    bool is_active(unsigned int irqn);
+
     void disableIrq(GenericIrq *irq);
     void enableIrq(GenericIrq *irq);
     void disableIrqs();
@@ -59,22 +177,113 @@ class IrqController {
     void local_raise(GenericIrq *irq);
     void dest_raise(GenericIrq *irq);
 
-    /// Handle the pending irqs
+    /// Handle the pending irqs, highest priority first
     /// @return int
     int handle();
 
+    /// Interrupt check point: handles the pending irqs when called from the
+    /// controller thread with the doorbell delivery
+    void check_point();
+
+    /// Wait for an irq to be raised or handled on this controller since the
+    /// previous wait, the pending irqs are handled before returning
+    /// @return 0 on success, -ETIMEDOUT if nothing was raised within timeout_us
+    /// @param  timeout_us negative to wait forever
+    int wait(int timeout_us);
+
     void set_dest_irq_controller(IrqController *dest_controller);
 
+    void set_delivery(Delivery delivery) { this->delivery = delivery; }
+    Delivery get_delivery() { return delivery; }
+    static Delivery delivery_from_string(const std::string &name);
+
   private:
-    bool allirqs_enabled;
-    std::set<GenericIrq *> pending_irqs;
+    static constexpr unsigned int words = HWMOCK_IRQ_LINES / 64;
+
+    struct IrqLine {
+        std::atomic<GenericIrq *> irq = nullptr;
+        std::atomic<uint8_t> priority = 0;
+        // coalescing policy
+        std::atomic<uint32_t> max_events = 0;
+        std::atomic<uint32_t> max_delay_us = 0;
+        /// raises not handled yet
+        std::atomic<uint32_t> batched = 0;
+        std::atomic<uint64_t> first_raise_ns = 0;
+        // statistics
+        std::atomic<uint64_t> raised = 0;
+        std::atomic<uint64_t> delivered = 0;
+        std::atomic<uint64_t> merged = 0;
+        std::atomic<uint64_t> polled = 0;
+        /// first raise of the handled batch, for the bottom half latency
+        std::atomic<uint64_t> handled_raise_ns = 0;
+        // bottom half
+        std::atomic<bool> bottom_half = false;
+        Work work;
+    };
+
+    bool allirqs_enabled = true;
+    Delivery delivery = Delivery::SIGNAL;
+    IrqLine lines[HWMOCK_IRQ_LINES];
+    /// pending lines bitmap for each priority level
+    std::atomic<uint64_t> pending[HWMOCK_IRQ_PRIORITIES][words] = {};
+    /// one bit per priority level with pending lines
+    std::atomic<uint32_t> pending_levels = 0;
+    std::atomic<uint64_t> active[words] = {};
+    // nesting
+    std::atomic<uint32_t> priority_grouping = 0;
+    std::atomic<uint32_t> basepri = 0;
+    /// priority of the running handler, restored by each handle() frame
+    std::atomic<uint32_t> running_priority = HWMOCK_IRQ_PRIORITIES;
+    /// a handle() frame is claiming a line, nested ones leave it to it
+    std::atomic<bool> claiming = false;
+    std::atomic<bool> claim_preempted = false;
+    /// lines with a coalescing delay, watched by the timer thread
+    std::atomic<uint64_t> coalesced[words] = {};
+    std::atomic<uint32_t> doorbell = 0;
+    std::atomic<uint32_t> doorbell_waiters = 0;
+    /// doorbell value at the end of the previous wait
+    uint32_t doorbell_seen = 0;
     struct sigaction action;
     pthread_t pthread = {0};
     IrqController *dest_controller = nullptr;
+    std::atomic<Workqueue *> workqueue = nullptr;
+
+    // latency tracking, the histograms are allocated on first enable
+    LatencyHistogram *latency_histograms = nullptr;
+    std::atomic<LatencyHistogram *> latencies = nullptr;
+    std::atomic<uint64_t> latency_since_ns = 0;
 
-    void interrupt_self();
-    void interrupt_dest();
+    // adaptive polling
+    std::atomic<bool> polling = false;
+    std::atomic<uint32_t> poll_budget = 0;
+    std::atomic<uint32_t> poll_interval_us = 0;
+    std::atomic<uint64_t> notify_window_ns = 0;
+    std::atomic<uint32_t> notify_count = 0;
+
+    // timer thread delivering the coalesced lines and the polls
+    pthread_t timer_pthread = {0};
+    std::atomic<bool> timer_started = false;
+    std::atomic<bool> timer_stopped = false;
+    std::atomic<uint32_t> timer_kick = 0;
+
+    void raise(GenericIrq *irq);
+    void ring_doorbell();
+    void interrupt();
+    void notify();
+    bool set_pending(unsigned int irqn, unsigned int priority);
+    void deliver(unsigned int irqn);
+    uint32_t preemption_levels(uint32_t running);
+    int claim_pending(uint32_t levels_mask);
+    void record_latency(unsigned int irqn, uint64_t raise_ns);
+    void start_timer();
+    void wake_timer();
+    uint64_t run_timer(uint64_t now_ns, uint64_t &next_poll_ns);
+    static void run_bottom_half(void *ctx, unsigned int irqn);
+
+    friend void *irq_timer_thread_fn(void *data);
 };
+
+void *irq_timer_thread_fn(void *data);
 } // namespace HWMocker
 
 #endif // __HWMOCKER_IRQCONTROLLER_HPP
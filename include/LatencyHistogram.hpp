@@ -0,0 +1,99 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_LATENCYHISTOGRAM_HPP
+#define __HWMOCKER_LATENCYHISTOGRAM_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace HWMocker {
+
+///
+/// struct LatencySnapshot
+struct LatencySnapshot {
+    uint64_t count;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+};
+
+///
+/// class LatencyHistogram
+///
+/// HDR like histogram: each power of two is split in sub_buckets linear buckets
+/// so that a recorded value is known within 1 / sub_buckets. Recording is a
+/// few relaxed atomic increments and never allocates, it is safe in a signal
+/// handler.
+class LatencyHistogram {
+  public:
+    static constexpr unsigned int sub_bits = 4;
+    static constexpr unsigned int sub_buckets = 1 << sub_bits;
+    /// values of max_magnitude bits and more go to the last bucket
+    static constexpr unsigned int max_magnitude = 36;
+    static constexpr unsigned int buckets = (max_magnitude - sub_bits + 1) * sub_buckets;
+
+    void record(uint64_t value_ns) {
+        counts[bucket_index(value_ns)].fetch_add(1, std::memory_order_relaxed);
+        total_count.fetch_add(1, std::memory_order_relaxed);
+        total_ns.fetch_add(value_ns, std::memory_order_relaxed);
+
+        uint64_t min = min_ns.load(std::memory_order_relaxed);
+        while (value_ns < min && !min_ns.compare_exchange_weak(min, value_ns))
+            ;
+        uint64_t max = max_ns.load(std::memory_order_relaxed);
+        while (value_ns > max && !max_ns.compare_exchange_weak(max, value_ns))
+            ;
+    }
+
+    void reset();
+    void snapshot(LatencySnapshot *snapshot);
+
+    static unsigned int bucket_index(uint64_t value) {
+        if (value < sub_buckets)
+            return value;
+
+        unsigned int magnitude = 63 - __builtin_clzll(value);
+        if (magnitude >= max_magnitude)
+            return buckets - 1;
+        return (magnitude - sub_bits + 1) * sub_buckets +
+               ((value >> (magnitude - sub_bits)) & (sub_buckets - 1));
+    }
+
+    /// @return the highest value recorded in the bucket index
+    static uint64_t bucket_value(unsigned int index);
+
+  private:
+    std::atomic<uint64_t> counts[buckets] = {};
+    std::atomic<uint64_t> total_count = 0;
+    std::atomic<uint64_t> total_ns = 0;
+    std::atomic<uint64_t> min_ns = UINT64_MAX;
+    std::atomic<uint64_t> max_ns = 0;
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_LATENCYHISTOGRAM_HPP
@@ -0,0 +1,143 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_MAILBOX_HPP
+#define __HWMOCKER_MAILBOX_HPP
+
+#include "ByteRing.hpp"
+#include "HwElement.hpp"
+#include "HwIrq.hpp"
+#include "IrqController.hpp"
+#include <hwmocker/hwmocker.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace HWMocker {
+
+///
+/// class Mailbox
+///
+/// Shared memory between the host and the soc: a lock free single producer
+/// single consumer ring of "ring-size" bytes for each direction, and a
+/// doorbell irq into the controller of each side, "host-irq" and "soc-irq".
+/// Each side gets an endpoint which writes into the ring of its peer and reads
+/// its own one.
+///
+/// A write rings the doorbell of the peer, unless the peer handler is running:
+/// the handler drains the ring it was rung for and, once back, rings its own
+/// doorbell again if bytes were written meanwhile. A write short of space asks
+/// the peer for a tx irq once it reads.
+class Mailbox : virtual public HwElement {
+  public:
+    class Endpoint {
+      public:
+        ///
+        /// @return the number of bytes written, fewer when the peer ring is full
+        ssize_t write(const void *buf, size_t size);
+
+        ///
+        /// @return the number of bytes read, fewer when the ring is empty
+        ssize_t read(void *buf, size_t size);
+
+        ///
+        /// Zero copy read: the span stays valid until consumed
+        /// @return the number of contiguous bytes at the head of the ring
+        /// @param  span set to the first of them
+        size_t read_span(const void **span) { return rx->read_span((const uint8_t **)span); }
+        /// @return the number of bytes consumed, fewer when the ring is empty
+        size_t consume(size_t size);
+
+        size_t rx_level() { return rx->level(); }
+
+        ///
+        /// @return 0 on success, -ENOENT if the endpoint has no irq
+        /// @param  irq_mask HWMOCKER_MAILBOX_IRQ_* events raising the irq
+        /// @param  handler called with the events since its previous call
+        int set_irq_handler(unsigned int irq_mask,
+                            int (*handler)(unsigned int status, void *ctx), void *ctx);
+
+        void get_stats(struct hwmocker_mailbox_stats *stats);
+        void reset_stats();
+
+      private:
+        friend class Mailbox;
+
+        ByteRing *rx = nullptr;
+        Endpoint *peer = nullptr;
+
+        IrqController *irq_controller = nullptr;
+        HwIrq *irq = nullptr;
+        bool has_irq = false;
+        std::atomic<unsigned int> irq_mask = 0;
+        std::atomic<unsigned int> irq_status = 0;
+        int (*handler)(unsigned int status, void *ctx) = nullptr;
+        void *handler_ctx = nullptr;
+
+        /// Written by the peer, on their own cache line: the handler is
+        /// draining the rx ring, the writer waits for space in its tx ring
+        alignas(ByteRing::cache_line) std::atomic<bool> draining = false;
+        std::atomic<bool> tx_waiting = false;
+
+        alignas(ByteRing::cache_line) std::atomic<uint64_t> stats_tx_bytes = 0;
+        std::atomic<uint64_t> stats_rx_bytes = 0;
+        std::atomic<uint64_t> stats_doorbells = 0;
+        std::atomic<uint64_t> stats_suppressed = 0;
+
+        void raise(unsigned int events);
+        void consumed();
+        static int irq_handler(void *ctx);
+    };
+
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    Mailbox(IrqController *host_irq_controller, IrqController *soc_irq_controller);
+
+    ///
+    /// Empty Destructor
+    virtual ~Mailbox();
+
+    ///
+    /// @return 0 on success
+    /// @param  config {"index", "ring-size", "host-irq", "soc-irq"}
+    int load_config(json config);
+
+    unsigned int get_mailbox_index() { return mailbox_index; }
+    Endpoint *get_host_endpoint() { return &host; }
+    Endpoint *get_soc_endpoint() { return &soc; }
+
+  private:
+    unsigned int mailbox_index = 0;
+    /// rx rings of the host and of the soc
+    ByteRing host_rx;
+    ByteRing soc_rx;
+    Endpoint host;
+    Endpoint soc;
+
+    int load_endpoint_irq(Endpoint *endpoint, json config, const char *name);
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_MAILBOX_HPP
@@ -0,0 +1,110 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_NETGRAPH_HPP
+#define __HWMOCKER_NETGRAPH_HPP
+
+#include "Pin.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace HWMocker {
+
+///
+/// class NetGraph
+///
+/// Nets connect N driver pins to N receiver pins. Once compiled, the receivers
+/// driven by each pin are stored in a CSR layout: the receivers of node n are
+/// targets[offsets[n]] to targets[offsets[n + 1] - 1]. A change walks this flat
+/// range, stores the receivers levels and only dispatches on_change() to the
+/// receivers which want it (irq pins), the others read their level from the
+/// graph.
+class NetGraph {
+  public:
+    struct Net {
+        std::string name;
+        std::vector<Pin *> drivers;
+        std::vector<Pin *> receivers;
+    };
+
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    NetGraph() {}
+
+    ///
+    /// Empty Destructor
+    virtual ~NetGraph() {}
+
+    /// Adds a net, to be called before compile()
+    /// @return 0 on success, -EBUSY if compiled already
+    int add_net(const std::string &name, const std::vector<Pin *> &drivers,
+                const std::vector<Pin *> &receivers);
+    const Net *find_net(const std::string &name);
+    const std::vector<Net> &get_nets() { return nets; }
+
+    /// Builds the CSR layout and attaches the pins to the graph, their per
+    /// pin connection lists are not used anymore
+    void compile();
+    bool is_compiled() { return compiled; }
+
+    /// Replaces a pin of the graph by another one of the same node
+    void replace_pin(Pin *old_pin, Pin *new_pin);
+
+    /// @return the pins driven by node
+    std::vector<Pin *> get_receivers(unsigned int node);
+
+    bool get_level(unsigned int node) { return levels[node].load(std::memory_order_acquire); }
+
+    /// Dispatches the changes of node to its pin from now on
+    void watch(unsigned int node) { dispatch[node].store(true, std::memory_order_release); }
+
+    /// Drives the receivers of node
+    void propagate(unsigned int node, bool value) {
+        levels[node].store(value, std::memory_order_release);
+        for (uint32_t edge = offsets[node]; edge < offsets[node + 1]; edge++) {
+            uint32_t target = targets[edge];
+            levels[target].store(value, std::memory_order_release);
+            if (dispatch[target].load(std::memory_order_acquire))
+                pins[target].load(std::memory_order_relaxed)->on_change(value);
+        }
+    }
+
+  private:
+    std::vector<Net> nets;
+    bool compiled = false;
+    unsigned int nodes = 0;
+    std::unique_ptr<uint32_t[]> offsets;
+    std::unique_ptr<uint32_t[]> targets;
+    std::unique_ptr<std::atomic<Pin *>[]> pins;
+    std::unique_ptr<std::atomic<bool>[]> dispatch;
+    std::unique_ptr<std::atomic<bool>[]> levels;
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_NETGRAPH_HPP
@@ -23,10 +23,14 @@
 #ifndef __HWMOCKER_PIN_HPP
 #define __HWMOCKER_PIN_HPP
 
+#include <cstdint>
 #include <vector>
 
 namespace HWMocker {
 
+class NetGraph;
+class WaveformRecorder;
+
 ///
 /// class Pin
 
@@ -54,16 +58,41 @@ class Pin {
 
     std::vector<Pin *> &get_connected_pins() { return connected_pins; }
 
+    /// @return the pins driven by this one, from its net graph once compiled
+    std::vector<Pin *> get_receivers();
+
+    NetGraph *get_net_graph() { return graph; }
+
+    /// Records the changes driven by this pin as signal
+    void add_trace(WaveformRecorder *recorder, uint32_t signal) {
+        this->recorder = recorder;
+        trace_signals.push_back(signal);
+    }
+    void copy_traces(Pin *pin) {
+        recorder = pin->recorder;
+        trace_signals = pin->trace_signals;
+    }
+
+    /// Current level of the pin, its net one once in a net graph
+    virtual bool get_level();
+
+    /// A pin which does not want its changes gets its level from the net graph
+    virtual bool wants_changes() { return true; }
+
   protected:
     // Static Protected attributes
 
     // Protected attributes
     std::vector<Pin *> connected_pins;
-
-    void change(bool value) {
-        for (Pin *pin : connected_pins)
-            pin->on_change(value);
-    }
+    /// Compiled net graph of the pin, if any, and its node in it
+    NetGraph *graph = nullptr;
+    unsigned int net_node = 0;
+    /// Waveform signals following the changes driven by this pin: its own one
+    /// and the ones of the nets and receivers it drives
+    WaveformRecorder *recorder = nullptr;
+    std::vector<uint32_t> trace_signals;
+
+    void change(bool value);
     virtual void on_change(bool value) = 0;
 
     // Public static attribute accessor methods
@@ -71,6 +100,8 @@ class Pin {
     // Public attribute accessor methods
 
   private:
+    friend class NetGraph;
+
     // Static Private attributes
 
     // Private attributes
@@ -25,11 +25,24 @@
 
 #include "Gpio.hpp"
 #include "GpioIrq.hpp"
+#include "GpioPort.hpp"
 #include "HwElement.hpp"
 #include "IrqController.hpp"
+#include "SimClock.hpp"
+#include "Workqueue.hpp"
 #ifdef CONFIG_HWMOCK_SPI
+#include "DmaController.hpp"
 #include "SpiDevice.hpp"
 #endif
+#ifdef CONFIG_HWMOCK_UART
+#include "UartDevice.hpp"
+#endif
+#ifdef CONFIG_HWMOCK_I2C
+#include "I2cDevice.hpp"
+#endif
+#ifdef CONFIG_HWMOCK_MAILBOX
+#include "Mailbox.hpp"
+#endif
 
 #include <vector>
 
@@ -62,7 +75,10 @@ class ProcessingUnit : virtual public HwElement {
 
     int load_config(json config);
 
-    Pin *get_pin(unsigned int pin_idx);
+    Pin *get_pin(unsigned int pin_idx) {
+        PinHandle *handle = get_pin_handle(pin_idx);
+        return handle ? handle->pin : nullptr;
+    }
 
     bool is_stopped() { return stopped; }
 
@@ -76,35 +92,140 @@ class ProcessingUnit : virtual public HwElement {
     }
 
     IrqController *get_irq_controller() { return irq_controller; }
+    Workqueue *get_workqueue() { return workqueue; }
+    void set_sim_clock(SimClock *sim_clock) { this->sim_clock = sim_clock; }
+
+    pthread_t get_pthread() { return pthread; }
 
     int set_gpio_irq(unsigned int pin_idx, int (*handler)(void));
+    int set_gpio_irq_trigger(unsigned int pin_idx, unsigned int trigger);
 
     void set_gpio_value(unsigned int pin_idx, bool value);
+    /// @return the gpio level, 0 if pin_idx is not a gpio
+    int get_gpio_value(unsigned int pin_idx) {
+        PinHandle *handle = get_pin_handle(pin_idx);
+        return handle && handle->gpio ? handle->gpio->get_value() : 0;
+    }
+    int wait_gpio_edge(unsigned int pin_idx, unsigned int type, int timeout_us);
+    int wait_gpio_level(unsigned int pin_idx, bool value, int timeout_us);
+
+    /// Interrupt check point of the processing unit thread
+    void poll_irqs() {
+        irq_controller->check_point();
+        workqueue->check_point();
+    }
+
+    /// Wait for an irq and handle it
+    /// @return 0 on success, -ETIMEDOUT on timeout
+    /// @param  timeout_us negative to wait forever
+    int wait_irq(int timeout_us) {
+        int rc = irq_controller->wait(timeout_us);
+        workqueue->check_point();
+        return rc;
+    }
+
+    int set_irq_priority(unsigned int irqn, unsigned int priority) {
+        return irq_controller->set_priority(irqn, priority);
+    }
+
+    int set_irq_coalescing(unsigned int irqn, unsigned int max_events, unsigned int max_delay_us) {
+        return irq_controller->set_coalescing(irqn, max_events, max_delay_us);
+    }
+
+    int set_irq_polling(unsigned int budget, unsigned int interval_us) {
+        return irq_controller->set_polling(budget, interval_us);
+    }
+
+    int set_irq_bottom_half(unsigned int irqn, bool bottom_half) {
+        return irq_controller->set_bottom_half(irqn, bottom_half);
+    }
 
     void set_ready();
     void wait_ready();
 
+    vector<GpioPort *> gpio_ports;
+    GpioPort *get_gpio_port(unsigned int port_idx) {
+        return port_idx < gpio_port_table.size() ? gpio_port_table[port_idx] : nullptr;
+    }
+
 #ifdef CONFIG_HWMOCK_SPI
     vector<SpiDevice *> spi_devs;
     SpiDevice *get_spi_device(unsigned int spi_idx) {
-        for (SpiDevice *spi : spi_devs) {
-            if (spi->get_spi_index() == spi_idx)
-                return spi;
-        }
-        return nullptr;
+        return spi_idx < spi_table.size() ? spi_table[spi_idx] : nullptr;
+    }
+
+    vector<DmaController *> dmas;
+    DmaController *get_dma(unsigned int dma_idx) {
+        return dma_idx < dma_table.size() ? dma_table[dma_idx] : nullptr;
+    }
+
+    int spi_bitbang_xfer(const struct hwmocker_spi_bitbang *bus, const void *txbuf, void *rxbuf,
+                         size_t size);
+#endif
+
+#ifdef CONFIG_HWMOCK_UART
+    vector<UartDevice *> uarts;
+    UartDevice *get_uart(unsigned int uart_idx) {
+        return uart_idx < uart_table.size() ? uart_table[uart_idx] : nullptr;
+    }
+#endif
+
+#ifdef CONFIG_HWMOCK_I2C
+    vector<I2cDevice *> i2c_devs;
+    I2cDevice *get_i2c_device(unsigned int i2c_idx) {
+        return i2c_idx < i2c_table.size() ? i2c_table[i2c_idx] : nullptr;
+    }
+#endif
+
+#ifdef CONFIG_HWMOCK_MAILBOX
+    /// Endpoints of the system mailboxes, not owned
+    Mailbox::Endpoint *get_mailbox(unsigned int mailbox_idx) {
+        return mailbox_idx < mailbox_table.size() ? mailbox_table[mailbox_idx] : nullptr;
+    }
+    void add_mailbox(unsigned int mailbox_idx, Mailbox::Endpoint *endpoint) {
+        if (mailbox_idx >= mailbox_table.size())
+            mailbox_table.resize(mailbox_idx + 1);
+        if (!mailbox_table[mailbox_idx])
+            mailbox_table[mailbox_idx] = endpoint;
     }
 #endif
 
   private:
+    /// Handles of a pin number, gpio is also set for a gpio irq
+    struct PinHandle {
+        Pin *pin = nullptr;
+        Gpio *gpio = nullptr;
+        GpioIrq *gpio_irq = nullptr;
+    };
+
     // Static Private attributes
 
     // Private attributes
     const char *name;
     ProcessingUnit *dest_processing_unit = nullptr;
     IrqController *irq_controller = nullptr;
+    Workqueue *workqueue = nullptr;
+    SimClock *sim_clock = nullptr;
     pthread_t pthread = {0};
     vector<Gpio *> gpios;
     vector<GpioIrq *> gpio_irqs;
+    // Lookup tables indexed by pin number, port index, spi, dma, uart and i2c
+    // index
+    vector<PinHandle> pin_handles;
+    vector<GpioPort *> gpio_port_table;
+#ifdef CONFIG_HWMOCK_SPI
+    vector<SpiDevice *> spi_table;
+    vector<DmaController *> dma_table;
+#endif
+#ifdef CONFIG_HWMOCK_UART
+    vector<UartDevice *> uart_table;
+#endif
+#ifdef CONFIG_HWMOCK_I2C
+    vector<I2cDevice *> i2c_table;
+#endif
+#ifdef CONFIG_HWMOCK_MAILBOX
+    vector<Mailbox::Endpoint *> mailbox_table;
+#endif
     pthread_mutex_t start_mutex;
     pthread_mutex_t ready_mutex;
     bool stopped = true;
@@ -115,6 +236,16 @@ class ProcessingUnit : virtual public HwElement {
 
     // Public attribute accessor methods
     int run_thread();
+
+    PinHandle *get_pin_handle(unsigned int pin_idx) {
+        return pin_idx < pin_handles.size() ? &pin_handles[pin_idx] : nullptr;
+    }
+    PinHandle &add_pin_handle(unsigned int pin_idx) {
+        if (pin_idx >= pin_handles.size())
+            pin_handles.resize(pin_idx + 1);
+        return pin_handles[pin_idx];
+    }
+    void build_lookup_tables();
 };
 } // namespace HWMocker
 
@@ -0,0 +1,70 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_SIMCLOCK_HPP
+#define __HWMOCKER_SIMCLOCK_HPP
+
+#include "Clock.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace HWMocker {
+
+///
+/// class SimClock
+///
+/// Simulation time of a system, in nanoseconds since its creation. The
+/// modeled durations, such as the spi transfers, wait for it: in real time
+/// they sleep, in virtual time the clock jumps to their end so that they cost
+/// no wall clock time. The virtual clock still runs with the real time
+/// between the jumps.
+class SimClock {
+  public:
+    enum class Mode { REAL, VIRTUAL };
+
+    static Mode mode_from_string(const std::string &name);
+
+    SimClock() { start_ns = clock_now_ns(); }
+
+    void set_mode(Mode mode) { this->mode = mode; }
+    Mode get_mode() { return mode; }
+
+    /// @return the simulation time in nanoseconds
+    uint64_t now_ns() { return clock_now_ns() - start_ns + skipped_ns.load(); }
+
+    ///
+    /// Waits until the simulation time reaches deadline_ns
+    /// @param  deadline_ns simulation time
+    void wait_until(uint64_t deadline_ns);
+
+  private:
+    Mode mode = Mode::REAL;
+    uint64_t start_ns;
+    /// time jumped over in virtual time
+    std::atomic<uint64_t> skipped_ns = 0;
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_SIMCLOCK_HPP
@@ -0,0 +1,165 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_SPIBITDECODER_HPP
+#define __HWMOCKER_SPIBITDECODER_HPP
+
+#include "Gpio.hpp"
+#include "HwElement.hpp"
+
+#include <cstdint>
+
+#include <sys/uio.h>
+
+namespace HWMocker {
+
+class SpiDevice;
+
+///
+/// class SpiBitDecoder
+///
+/// Slave side of a spi master bit-banged over gpios: it follows the clock and
+/// chip select edges from the net graph, samples mosi and drives miso, in the
+/// clock mode of its config, most significant bit first by default. A chip
+/// select window transfers the oldest armed transfer of the slave, completed
+/// with the number of whole words clocked, once the chip select is released.
+///
+/// A master clocking whole words with master_xfer() skips the edges: once its
+/// pins lead to a selected decoder of the same mode and bit order, between
+/// two words, the words are handed to the decoder without propagating their
+/// clock edges, and its mosi and miso only take the level of their last bit.
+/// Within contiguous segments, a word is a single store and load. Miso is only
+/// propagated when its level changes.
+class SpiBitDecoder {
+  public:
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    SpiBitDecoder(SpiDevice *spi_dev, Gpio *mosi, Gpio *miso)
+        : spi_dev(spi_dev), mosi(mosi), miso(miso) {}
+
+    ///
+    /// Empty Destructor
+    virtual ~SpiBitDecoder() {}
+
+    ///
+    /// @return 0 on success
+    /// @param  config {"mode": 0..3, "lsb-first"}
+    int load_config(json config);
+
+    ///
+    /// Master bit-banging size words over its gpios, the chip select is up to
+    /// the caller. The words are taken whole by a decoder on the other end,
+    /// their clock edges are driven otherwise.
+    /// @return size, -EINVAL if mode is not in 0..3
+    /// @param  tx the words to shift out, zeros if null
+    /// @param  rx the words shifted in, if not null
+    static int master_xfer(Gpio *clk, Gpio *mosi, Gpio *miso, unsigned int mode, bool lsb_first,
+                           const uint8_t *tx, uint8_t *rx, size_t size);
+
+    void on_clk(bool level);
+    void on_csn(bool level);
+
+  private:
+    SpiDevice *spi_dev;
+    Gpio *mosi;
+    Gpio *miso;
+
+    /// Clock polarity and phase of the spi mode
+    bool cpol = false;
+    bool cpha = false;
+    bool lsb_first = false;
+
+    bool selected = false;
+    bool clk_level = false;
+    bool miso_level = false;
+    uint64_t start_ns = 0;
+
+    /// Transfer of the window, from the slave
+    void *window = nullptr;
+    const struct iovec *tx = nullptr;
+    const struct iovec *rx = nullptr;
+    int tx_count = 0;
+    int rx_count = 0;
+    size_t size = 0;
+    /// Words received and shifted out, the segments positions of the next ones
+    size_t words = 0;
+    size_t out_words = 0;
+    int tx_seg = 0;
+    int rx_seg = 0;
+    size_t tx_off = 0;
+    size_t rx_off = 0;
+
+    uint8_t in_word = 0;
+    uint8_t out_word = 0;
+    unsigned int in_bits = 0;
+    unsigned int out_bits = 0;
+
+    /// Contiguous words left in the current segments
+    uint8_t *rx_ptr = nullptr;
+    const uint8_t *tx_ptr = nullptr;
+    size_t rx_span = 0;
+    size_t tx_span = 0;
+
+    void begin();
+    void end();
+    void drive();
+    void next_out_word();
+    void store_word();
+    void enter_word_path();
+    bool takes_words(Gpio *mosi, Gpio *miso, bool cpol, bool cpha, bool lsb_first);
+    void shift_words(const uint8_t *tx, uint8_t *rx, size_t size);
+    void drive_miso(uint8_t bit);
+};
+
+///
+/// class SpiSensePin
+///
+/// Gpio of a bit-banged slave forwarding its changes to the decoder
+class SpiSensePin : public Gpio {
+  public:
+    SpiSensePin(unsigned int pin_idx, SpiBitDecoder *decoder, bool is_clk)
+        : Gpio(pin_idx), decoder(decoder), is_clk(is_clk) {}
+
+    /// The decoder follows the edges
+    bool wants_changes() { return true; }
+
+    SpiBitDecoder *get_decoder(bool is_clk) { return is_clk == this->is_clk ? decoder : nullptr; }
+
+  protected:
+    void on_change(bool value) {
+        Gpio::on_change(value);
+        if (is_clk)
+            decoder->on_clk(value);
+        else
+            decoder->on_csn(value);
+    }
+
+  private:
+    SpiBitDecoder *decoder;
+    bool is_clk;
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_SPIBITDECODER_HPP
@@ -0,0 +1,92 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_SPICAPTURE_HPP
+#define __HWMOCKER_SPICAPTURE_HPP
+
+#include <hwmocker/spi_capture.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <sys/uio.h>
+
+namespace HWMocker {
+
+///
+/// class SpiCapture
+///
+/// Append-only log of the spi transactions in a memory mapped file of a fixed
+/// capacity. A record reserves its place with an atomic add and is copied in
+/// place, without lock nor system call, and is complete once its magic is
+/// written. The records which do not fit anymore are dropped and counted. The
+/// file is truncated to the records on close.
+class SpiCapture {
+  public:
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    SpiCapture() {}
+
+    ///
+    /// Empty Destructor: unmaps and truncates the file
+    virtual ~SpiCapture();
+
+    ///
+    /// Creates the file and maps it
+    /// @return 0 on success, a negative errno if the file cannot be mapped
+    /// @param  path
+    /// @param  capacity file size in bytes
+    int open(const std::string &path, size_t capacity);
+
+    ///
+    /// Appends a transaction
+    /// @param  timestamp_ns
+    /// @param  master HWMOCKER_SPI_CAPTURE_HOST or HWMOCKER_SPI_CAPTURE_SOC
+    /// @param  cs
+    /// @param  master_index
+    /// @param  target_index
+    /// @param  mosi master tx segments
+    /// @param  miso slave tx segments
+    /// @param  length clocked bytes
+    void record(uint64_t timestamp_ns, uint8_t master, uint8_t cs, uint8_t master_index,
+                uint8_t target_index, const struct iovec *mosi, int mosi_count,
+                const struct iovec *miso, int miso_count, size_t length);
+
+    uint64_t get_dropped() { return dropped.load(); }
+
+  private:
+    int fd = -1;
+    uint8_t *base = nullptr;
+    size_t capacity = 0;
+    /// end of the reserved records
+    std::atomic<uint64_t> tail = 0;
+    /// offset of the first record which did not fit
+    std::atomic<uint64_t> end;
+    std::atomic<uint64_t> dropped = 0;
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_SPICAPTURE_HPP
@@ -23,15 +23,55 @@
 #ifndef __HWMOCKER_SPIDEVICE_HPP
 #define __HWMOCKER_SPIDEVICE_HPP
 
+#include "ByteRing.hpp"
+#include "Futex.hpp"
 #include "Gpio.hpp"
 #include "HwElement.hpp"
 #include "HwIrq.hpp"
 #include "IrqController.hpp"
+#include "SimClock.hpp"
+#include "SpiBitDecoder.hpp"
+#include "SpiCapture.hpp"
+#include "SpiResponder.hpp"
+#include <hwmocker/hwmocker.h>
+
+#include <atomic>
+#include <memory>
+
+#include <sys/uio.h>
 
 namespace HWMocker {
 
 ///
 /// class SpiDevice
+///
+/// A slave queues its transfers, up to the queue depth, and the master
+/// transfers complete them in order. The completion callbacks run from the spi
+/// irq handler of the slave, a transfer waited for by its submitter is
+/// completed by the submitter itself. The queue is lock free so that a
+/// completion callback may submit the next transfer.
+///
+/// The master and the slave meet on the state of the transfer: the master
+/// waits for the slave to arm it, the slave for the master to be done with
+/// it. Both spin for a while, adapted to the recent waits, before parking on a
+/// futex, and the wakers only wake parked waiters.
+///
+/// With a "clk-hz" config, a master transfer lasts the time to clock its words
+/// on the simulation clock, in "word-bits" bit words separated by
+/// "word-gap-ns", during which the bus stays busy.
+///
+/// A master drives a bus of targets, one per chip select of its "csn-pins"
+/// config. It transfers with the selected target and holds its chip select
+/// low meanwhile. The targets are resolved once, from the pins connected to
+/// the chip selects, the data lines and the clock.
+///
+/// In streaming mode, the master keeps the chip select of its target low and
+/// both write into the rx ring of the other one, without handshake. A device
+/// gets a stream irq when its rx ring reaches its watermark, at the start and
+/// at the stop of a stream.
+///
+/// A slave with a "bit-bang" config also decodes a master bit-banged over
+/// gpios connected to its pins, see SpiBitDecoder.
 
 class SpiDevice : virtual public HwElement {
   public:
@@ -59,7 +99,7 @@ class SpiDevice : virtual public HwElement {
 
     ///
     /// @return int
-    /// @param  json_cfg
+    /// @param  config spi device object of the processing unit "spi" config
     int load_config(json config);
 
     ///
@@ -79,6 +119,74 @@ class SpiDevice : virtual public HwElement {
     int async_xfer(const void *txbuf, void *rxbuf, size_t size, int (*callback)(void *ctx),
                    void *ctx);
 
+    ///
+    /// Scatter-gather transfers: the segments are copied directly into the
+    /// remote ones, the iovec arrays are not used after the call returns
+    /// @return the transferred size or a negative errno
+    /// @param  tx_iov
+    /// @param  tx_count
+    /// @param  rx_iov
+    /// @param  rx_count
+    /// @param  size clocked size
+    int sync_xfer(const struct iovec *tx_iov, int tx_count, const struct iovec *rx_iov,
+                  int rx_count, size_t size);
+    int async_xfer(const struct iovec *tx_iov, int tx_count, const struct iovec *rx_iov,
+                   int rx_count, size_t size, int (*callback)(void *ctx), void *ctx);
+
+    ///
+    /// Synchronous transfer without interrupt check point, for the callers
+    /// which are not the processing unit thread such as the dma engines
+    /// @return the transferred size or a negative errno
+    int transfer(const struct iovec *tx_iov, int tx_count, const struct iovec *rx_iov,
+                 int rx_count, size_t size);
+
+    ///
+    /// Asynchronous transfer completed with its status: the transferred size
+    /// @return 0 on success, -EBUSY if the queue is full
+    int submit_xfer(const struct iovec *tx_iov, int tx_count, const struct iovec *rx_iov,
+                    int rx_count, size_t size, int (*callback)(void *ctx, int status),
+                    void *ctx);
+
+    unsigned int get_queue_depth() { return queue_depth; }
+
+    ///
+    /// Fails the armed slave transfers and the next ones with -ECANCELED so
+    /// that their waiters return, to tear down the threads waiting for a
+    /// master which will not come
+    void cancel_xfers();
+
+    ///
+    /// Fails the master transfers waiting for a slave, and the next ones,
+    /// with -ECANCELED to tear down the threads waiting for a slave which
+    /// will not come
+    void cancel_rendezvous();
+
+    void set_sim_clock(SimClock *sim_clock) { this->sim_clock = sim_clock; }
+    /// @return the simulation time, the monotonic time without clock
+    uint64_t now_ns() { return sim_clock ? sim_clock->now_ns() : clock_now_ns(); }
+
+    ///
+    /// @return the modeled duration of a transfer, 0 without clk-hz
+    /// @param  size clocked size
+    uint64_t xfer_duration_ns(size_t size);
+
+    /// Bus statistics of the transfers of this device, since the last reset
+    void get_stats(struct hwmocker_spi_stats *stats);
+    void reset_stats();
+
+    ///
+    /// Slave transfer borrowing the master tx segments instead of copying them:
+    /// the master stays in its transfer until release_borrowed()
+    /// @return the transferred size or a negative errno
+    /// @param  tx_iov
+    /// @param  tx_count
+    /// @param  size
+    /// @param  rx_iov set to the master tx segments
+    /// @param  rx_count
+    int borrow_xfer(const struct iovec *tx_iov, int tx_count, size_t size,
+                    const struct iovec **rx_iov, int *rx_count);
+    int release_borrowed();
+
     static bool config_has_device(json config) { return config.contains("spi"); }
 
     Pin *getPin(unsigned int pin_idx) {
@@ -88,12 +196,72 @@ class SpiDevice : virtual public HwElement {
             return miso;
         if (clk && clk->pin_idx == pin_idx)
             return clk;
-        if (csn && csn->pin_idx == pin_idx)
-            return csn;
+        for (Gpio *cs_pin : csn)
+            if (cs_pin->pin_idx == pin_idx)
+                return cs_pin;
         return nullptr;
     }
 
-    bool set_remote(SpiDevice *remote_spi_dev);
+    std::vector<Pin *> get_pins() {
+        std::vector<Pin *> pins = {mosi, miso, clk};
+        pins.insert(pins.end(), csn.begin(), csn.end());
+        return pins;
+    }
+
+    bool is_master_device() { return is_master; }
+    unsigned int get_chip_selects() { return csn.size(); }
+    Gpio *get_csn(unsigned int cs = 0) { return cs < csn.size() ? csn[cs] : nullptr; }
+    /// @return the register map answering the master inline, if any
+    SpiResponder *get_responder() { return responder; }
+
+    ///
+    /// Connects a slave on a chip select if its pins are connected to the bus
+    /// @return true if connected
+    /// @param  cs chip select index
+    /// @param  target slave device whose csn pin is connected to the chip select
+    bool connect_target(unsigned int cs, SpiDevice *target);
+
+    ///
+    /// Selects the target of the next master transfers
+    /// @return 0 on success, -EINVAL if not a master or beyond its chip
+    /// selects, -ENODEV without target on this chip select
+    int select(unsigned int cs);
+
+    /// Drives the chip selects to their inactive high level
+    void release_chip_selects();
+
+    ///
+    /// Starts streaming with the selected target, the rx rings are emptied
+    /// @return 0 on success, -EINVAL if not a master, -ENODEV without target,
+    /// -EBUSY if already streaming
+    int stream_start();
+    /// @return 0 on success, -ENOTCONN if not streaming
+    int stream_stop();
+
+    ///
+    /// Writes into the rx ring of the peer
+    /// @return the number of bytes written, fewer when the ring is full,
+    /// -ENOTCONN if not streaming
+    ssize_t stream_write(const void *buf, size_t size);
+    /// @return the number of bytes read from the rx ring, until empty
+    ssize_t stream_read(void *buf, size_t size) { return stream_rx.read(buf, size); }
+    size_t stream_level() { return stream_rx.level(); }
+
+    ///
+    /// @return 0 on success, -EINVAL if the watermark exceeds the ring
+    /// @param  watermark rx ring level raising HWMOCKER_SPI_STREAM_RX
+    /// @param  handler called from the spi irq with the stream events
+    int set_stream_handler(size_t watermark, int (*handler)(unsigned int events, void *ctx),
+                           void *ctx);
+
+    ///
+    /// Logs the transactions of this device as slave
+    /// @param  capture
+    /// @param  source HWMOCKER_SPI_CAPTURE_HOST or HWMOCKER_SPI_CAPTURE_SOC
+    void set_capture(SpiCapture *capture, uint8_t source) {
+        this->capture = capture;
+        capture_source = source;
+    }
 
   protected:
     // Static Protected attributes
@@ -111,26 +279,138 @@ class SpiDevice : virtual public HwElement {
     unsigned int spi_index;
     bool is_master;
     HwIrq *irq = nullptr;
+    /// Taken by the master transfers, the bus is busy meanwhile
     pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-    pthread_mutex_t cond_mutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
-    void *current_rx = nullptr;
-    const void *current_tx = nullptr;
-    size_t current_xfer_size = 0;
-    volatile bool is_listening = false;
+
+    enum XferState : uint32_t {
+        XFER_IDLE,
+        XFER_ARMED,
+        XFER_TRANSFERRING,
+        XFER_DONE,
+        /// the submitter sleeps on the state
+        XFER_PARKED = 0x100,
+    };
+
+    /// Slave transfer, a slot of the submission queue
+    struct Transaction {
+        /// slot position, +queue_depth once completed
+        std::atomic<uint32_t> seq;
+        /// enum XferState, the futex word of its submitter
+        std::atomic<uint32_t> state;
+        /// segments copied from the caller
+        struct iovec tx[HWMOCKER_SPI_MAX_SEGMENTS];
+        struct iovec rx[HWMOCKER_SPI_MAX_SEGMENTS];
+        int tx_count;
+        int rx_count;
+        size_t size;
+        int status;
+        bool borrowing;
+        /// completed by its submitter
+        std::atomic<bool> waited;
+        int (*callback)(void *ctx);
+        int (*status_callback)(void *ctx, int status);
+        void *ctx;
+    };
+
+    unsigned int queue_depth = 4;
+    std::unique_ptr<Transaction[]> queue;
+    std::atomic<uint32_t> submitted = 0;
+    std::atomic<uint32_t> transferred = 0;
+    std::atomic<uint32_t> completed = 0;
+    std::atomic<bool> completing = false;
+    std::atomic<bool> cancelled = false;
+    /// number of armed transfers, the futex word of the parked master
+    std::atomic<uint32_t> armed = 0;
+    std::atomic<bool> master_parked = false;
+    /// the masters give up waiting for an armed transfer
+    std::atomic<bool> rendezvous_cancelled = false;
+    /// time the master waits for the slave, negative to wait forever
+    int rendezvous_timeout_us = 1000000;
+
+    /// Bus timing, untimed without clk_hz
+    SimClock *sim_clock = nullptr;
+    uint64_t clk_hz = 0;
+    unsigned int word_bits = 8;
+    uint64_t word_gap_ns = 0;
+
+    std::atomic<uint64_t> stats_xfers = 0;
+    std::atomic<uint64_t> stats_bytes = 0;
+    std::atomic<uint64_t> stats_busy_ns = 0;
+    std::atomic<uint64_t> stats_since_ns = 0;
+
+    /// Streaming: bytes from the peer, the peer while streaming
+    ByteRing stream_rx;
+    size_t stream_ring_size = 4096;
+    std::atomic<SpiDevice *> stream_peer = nullptr;
+    std::atomic<size_t> stream_watermark = 0;
+    std::atomic<unsigned int> stream_events = 0;
+    int (*stream_handler)(unsigned int events, void *ctx) = nullptr;
+    void *stream_ctx = nullptr;
+
+    SpiCapture *capture = nullptr;
+
+    /// Answers the master in its transfer instead of a slave thread
+    SpiResponder *responder = nullptr;
+
+    /// Decodes a master bit-banged over gpios
+    friend class SpiBitDecoder;
+    SpiBitDecoder *bit_decoder = nullptr;
+    uint8_t capture_source = HWMOCKER_SPI_CAPTURE_HOST;
+
+    /// Adaptive spin: doubled when a wait ends while spinning, halved otherwise
+    static constexpr unsigned int min_spins = 64;
+    static constexpr unsigned int max_spins = 8192;
+    std::atomic<unsigned int> spin_limit = min_spins;
+
+    template <typename Condition> bool spin(Condition condition) {
+        unsigned int limit = spin_limit.load(std::memory_order_relaxed);
+        for (unsigned int spins = 0; spins < limit; spins++) {
+            if (condition()) {
+                spin_limit.store(std::min(limit * 2, max_spins), std::memory_order_relaxed);
+                return true;
+            }
+            cpu_relax();
+        }
+        spin_limit.store(std::max(limit / 2, min_spins), std::memory_order_relaxed);
+        return false;
+    }
+
+    /// Master tx segments lent to the slave while the master waits
+    struct iovec borrowed[HWMOCKER_SPI_MAX_SEGMENTS];
+    int borrowed_count = 0;
+    std::atomic<uint32_t> lent = 0;
     Pin *miso = nullptr;
     Pin *mosi = nullptr;
     Pin *clk = nullptr;
-    Gpio *csn = nullptr;
-    SpiDevice *remote_spi_dev;
-    int (*slave_callback)(void *) = nullptr;
-    void *slave_callback_ctx = nullptr;
+    /// chip selects of a master, the csn pin of a slave
+    std::vector<Gpio *> csn;
+    /// targets of a master by chip select
+    std::vector<SpiDevice *> targets;
+    std::atomic<unsigned int> selected = 0;
+    /// master of a slave
+    SpiDevice *remote_spi_dev = nullptr;
     IrqController *irq_controller = nullptr;
 
     static int spi_irq_handler(void *ctx);
 
-    void xmit_locked(const void *txbuf, void *rxbuf, size_t size);
-    void wait_xfer_done();
+    uint64_t clock_xfer(size_t size);
+    void account(size_t size, uint64_t busy_ns);
+    void raise_stream(unsigned int events);
+    void finish_xfer(Transaction *transaction);
+    void *bitbang_begin(const struct iovec **tx_iov, int *tx_count, const struct iovec **rx_iov,
+                        int *rx_count, size_t *size);
+    void bitbang_end(void *window, size_t clocked, uint64_t busy_ns);
+
+    int claim_slot(const struct iovec *tx_iov, int tx_count, const struct iovec *rx_iov,
+                   int rx_count, size_t size, Transaction **claimed, uint32_t *position);
+    void arm(Transaction *transaction);
+    int wait_slot(Transaction *transaction);
+    void complete_xfers();
+    Transaction *pending_xfer();
+    int wait_armed(int timeout_us);
+    void xmit_locked(Transaction *transaction, const struct iovec *tx_iov, int tx_count,
+                     const struct iovec *rx_iov, int rx_count, size_t size);
+    void wait_released();
 
     ///
     /// Set the value of miso
@@ -161,16 +441,6 @@ class SpiDevice : virtual public HwElement {
     /// Get the value of clk
     /// @return the value of clk
     Pin *getClk() { return clk; }
-
-    ///
-    /// Set the value of csn
-    /// @param value the new value of csn
-    void setCsn(Gpio *value) { csn = value; }
-
-    ///
-    /// Get the value of csn
-    /// @return the value of csn
-    Gpio *getCsn() { return csn; }
 };
 } // namespace HWMocker
 
@@ -0,0 +1,95 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_SPIRESPONDER_HPP
+#define __HWMOCKER_SPIRESPONDER_HPP
+
+#include "HwElement.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <sys/uio.h>
+
+namespace HWMocker {
+
+///
+/// class SpiResponder
+///
+/// Register mapped spi chip answering the master inline, in its transfer. The
+/// first byte is a command: a canned command answers its response, otherwise
+/// the command holds the register address and the read bit, and the next
+/// bytes read or write the registers from this address, auto incremented.
+/// The miso byte of the command is the status.
+class SpiResponder {
+  public:
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    SpiResponder() {}
+
+    ///
+    /// Empty Destructor
+    virtual ~SpiResponder() {}
+
+    ///
+    /// @return 0 on success
+    /// @param  config {"read-mask", "address-mask", "status", "auto-increment",
+    /// "registers", "read-only", "commands"}
+    int load_config(json config);
+
+    ///
+    /// Answers a master transfer
+    /// @param  mosi master tx segments, zeros past them
+    /// @param  miso master rx segments
+    /// @param  size clocked size
+    void respond(const struct iovec *mosi, int mosi_count, const struct iovec *miso,
+                 int miso_count, size_t size);
+
+    /// Registers access of the chip side
+    /// @return 0 on success, -EINVAL past the register map
+    int read_registers(unsigned int address, void *buf, size_t size);
+    int write_registers(unsigned int address, const void *buf, size_t size);
+
+  private:
+    static constexpr unsigned int max_command_bytes = 8;
+
+    struct Command {
+        std::vector<uint8_t> match;
+        std::vector<uint8_t> response;
+    };
+
+    uint8_t read_mask = 0x80;
+    uint8_t address_mask = 0x7f;
+    uint8_t status = 0;
+    bool auto_increment = true;
+    std::unique_ptr<std::atomic<uint8_t>[]> registers;
+    std::unique_ptr<bool[]> read_only;
+    std::vector<Command> commands;
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_SPIRESPONDER_HPP
@@ -24,7 +24,10 @@
 #define __HWMOCKER_SYSTEM_HPP
 
 #include "HwElement.hpp"
+#include "NetGraph.hpp"
 #include "ProcessingUnit.hpp"
+#include "SimClock.hpp"
+#include "WaveformRecorder.hpp"
 
 namespace HWMocker {
 
@@ -50,6 +53,9 @@ class System : virtual public HwElement {
     /// @return the value of host
     ProcessingUnit *get_host() { return host; }
 
+    NetGraph *get_net_graph() { return &net_graph; }
+    SimClock *get_sim_clock() { return &sim_clock; }
+
     void set_soc_ready() { soc->set_ready(); }
     void set_host_ready() { host->set_ready(); }
     void wait_soc_ready() { soc->wait_ready(); }
@@ -59,6 +65,29 @@ class System : virtual public HwElement {
     ProcessingUnit *soc = nullptr;
     ProcessingUnit *host = nullptr;
     std::vector<HwElement> hw_elements;
+    NetGraph net_graph;
+    SimClock sim_clock;
+    WaveformRecorder *waveform = nullptr;
+
+    Pin *get_pin(const std::string &name);
+    int setup_waveform(json config);
+#ifdef CONFIG_HWMOCK_SPI
+    SpiCapture *spi_capture = nullptr;
+
+    void connect_spi_devices();
+    int setup_spi_capture(json config);
+#endif
+#ifdef CONFIG_HWMOCK_UART
+    void connect_uarts();
+#endif
+#ifdef CONFIG_HWMOCK_I2C
+    void connect_i2c_devices();
+#endif
+#ifdef CONFIG_HWMOCK_MAILBOX
+    std::vector<Mailbox *> mailboxes;
+
+    int setup_mailboxes(json config);
+#endif
 
     int load_config(json config);
 };
@@ -0,0 +1,169 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_UARTDEVICE_HPP
+#define __HWMOCKER_UARTDEVICE_HPP
+
+#include "ByteRing.hpp"
+#include "Gpio.hpp"
+#include "HwElement.hpp"
+#include "HwIrq.hpp"
+#include "IrqController.hpp"
+#include "SimClock.hpp"
+#include <hwmocker/hwmocker.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace HWMocker {
+
+///
+/// class UartDevice
+///
+/// Uart whose tx pin is connected to the rx pin of its peer. The writer copies
+/// into the rx fifo of its peer, a lock free single producer single consumer
+/// ring of "fifo-depth" bytes, and the reader reads it or consumes it in place.
+/// A write returns fewer bytes when the peer fifo is full.
+///
+/// With a "baud" config, the tx line is busy for the frame time of each byte,
+/// start, data, parity and stop bits, on the simulation clock. The writer runs
+/// ahead of its line by a fifo depth at most: past it, a write waits once for
+/// the line to catch up, so that a stream runs at the baud rate.
+///
+/// The irq latches the events of its irq mask: the rx fifo level reaching the
+/// rx threshold, and the peer emptying the rx fifo this uart wrote, its tx
+/// fifo in this model. The rx event is raised once per crossing: the reader
+/// rearms it when it drains the fifo below the threshold.
+class UartDevice : virtual public HwElement {
+  public:
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    UartDevice(IrqController *irq_controller, HwIrq *irq = new HwIrq());
+
+    ///
+    /// Empty Destructor
+    virtual ~UartDevice();
+
+    ///
+    /// @return 0 on success
+    /// @param  config {"index", "tx-pin", "rx-pin", "baud", "fifo-depth", "irq",
+    /// "data-bits", "parity", "stop-bits"}
+    int load_config(json config);
+
+    unsigned int get_uart_index() { return uart_index; }
+    Pin *get_tx_pin() { return tx; }
+    Pin *get_rx_pin() { return rx; }
+    std::vector<Pin *> get_pins() { return {tx, rx}; }
+
+    ///
+    /// Connects the tx line to a peer if the tx pin drives its rx pin
+    /// @return true if connected
+    bool connect(UartDevice *peer);
+
+    void set_sim_clock(SimClock *sim_clock) { this->sim_clock = sim_clock; }
+    /// @return the simulation time, the monotonic time without clock
+    uint64_t now_ns() { return sim_clock ? sim_clock->now_ns() : clock_now_ns(); }
+
+    ///
+    /// @return the modeled line time of size bytes, 0 without baud
+    uint64_t xfer_duration_ns(size_t size) { return size * frame_ns; }
+
+    ///
+    /// @return the number of bytes written, fewer when the peer rx fifo is
+    /// full, -ENOTCONN without peer
+    ssize_t write(const void *buf, size_t size);
+
+    ///
+    /// @return the number of bytes read, fewer when the rx fifo is empty
+    ssize_t read(void *buf, size_t size);
+
+    ///
+    /// Zero copy read: the span stays valid until consumed
+    /// @return the number of contiguous bytes at the head of the rx fifo
+    /// @param  span set to the first of them
+    size_t read_span(const void **span);
+    /// @return the number of bytes consumed, fewer when the rx fifo is empty
+    size_t consume(size_t size);
+
+    size_t rx_level() { return rx_fifo.level(); }
+
+    ///
+    /// @return 0 on success, -ENOENT if the uart has no irq, -EINVAL if the
+    /// threshold exceeds the fifo
+    /// @param  irq_mask HWMOCKER_UART_IRQ_* events raising the irq
+    /// @param  rx_threshold rx fifo level raising HWMOCKER_UART_IRQ_RX
+    /// @param  handler called with the events since its previous call
+    int set_irq_handler(unsigned int irq_mask, size_t rx_threshold,
+                        int (*handler)(unsigned int status, void *ctx), void *ctx);
+
+    void get_stats(struct hwmocker_uart_stats *stats);
+    void reset_stats();
+
+    static bool config_has_device(json config) { return config.contains("uart"); }
+
+  private:
+    unsigned int uart_index = 0;
+    Gpio *tx = nullptr;
+    Gpio *rx = nullptr;
+    /// writes go to the tx peer, the rx peer writes here
+    UartDevice *tx_peer = nullptr;
+    UartDevice *rx_peer = nullptr;
+
+    ByteRing rx_fifo;
+    size_t fifo_depth = 4096;
+    std::atomic<size_t> rx_threshold = 1;
+    std::atomic<bool> rx_armed = true;
+
+    /// Line model, untimed without baud
+    SimClock *sim_clock = nullptr;
+    uint64_t baud = 0;
+    uint64_t frame_ns = 0;
+    /// end of the line time of the bytes written, only moved by the writer
+    std::atomic<uint64_t> tx_done_ns = 0;
+
+    IrqController *irq_controller = nullptr;
+    HwIrq *irq = nullptr;
+    bool has_irq = false;
+    std::atomic<unsigned int> irq_mask = 0;
+    /// events not handled yet
+    std::atomic<unsigned int> irq_status = 0;
+    int (*handler)(unsigned int status, void *ctx) = nullptr;
+    void *handler_ctx = nullptr;
+
+    std::atomic<uint64_t> stats_tx_bytes = 0;
+    std::atomic<uint64_t> stats_rx_bytes = 0;
+    std::atomic<uint64_t> stats_busy_ns = 0;
+    std::atomic<uint64_t> stats_since_ns = 0;
+
+    static int uart_irq_handler(void *ctx);
+
+    void raise(unsigned int events);
+    void raise_rx();
+    void consumed(size_t before, size_t count);
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_UARTDEVICE_HPP
@@ -0,0 +1,148 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_WAVEFORMRECORDER_HPP
+#define __HWMOCKER_WAVEFORMRECORDER_HPP
+
+#include "SimClock.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+namespace HWMocker {
+
+void *waveform_writer_thread_fn(void *data);
+
+///
+/// class WaveformRecorder
+///
+/// Records the transitions of the traced signals into lock-free rings, one per
+/// recording thread while there are enough rings, and streams them to a VCD
+/// file from a writer thread. Recording never blocks nor allocates: it is safe
+/// in the irq handlers, and a transition is dropped when its ring is full. The
+/// transitions are timed on the simulation clock once set.
+class WaveformRecorder {
+  public:
+    static constexpr unsigned int rings = 16;
+    static constexpr unsigned int ring_size = 4096;
+
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    WaveformRecorder() {}
+
+    ///
+    /// Empty Destructor: stops the writer, flushes and closes the file
+    virtual ~WaveformRecorder();
+
+    /// Declares a 1 bit signal, to be called before start()
+    /// @return the signal id
+    /// @param  scope "host", "soc" or "nets"
+    /// @param  name
+    /// @param  level its level at start()
+    uint32_t add_signal(const std::string &scope, const std::string &name, bool level);
+
+    void set_sim_clock(SimClock *sim_clock) { this->sim_clock = sim_clock; }
+
+    /// Opens the VCD file, writes its header and starts the writer thread
+    /// @return 0 on success, a negative errno if the file cannot be opened
+    int start(const std::string &path);
+
+    void record(uint32_t signal, bool value) {
+        Ring &ring = ring_buffers[thread_ring()];
+        uint64_t pos = ring.tail.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Record &slot = ring.slots[pos % ring_size];
+            int64_t diff = (int64_t)(slot.seq.load(std::memory_order_acquire) - pos);
+            if (!diff) {
+                if (ring.tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = ring.tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        Record &slot = ring.slots[pos % ring_size];
+        slot.time_ns = now_ns();
+        slot.signal = signal;
+        slot.value = value;
+        slot.seq.store(pos + 1, std::memory_order_release);
+    }
+
+    uint64_t get_dropped() { return dropped.load(); }
+
+  private:
+    struct Record {
+        std::atomic<uint64_t> seq;
+        uint64_t time_ns;
+        uint32_t signal;
+        uint32_t value;
+    };
+
+    /// Bounded multi producers ring, single consumer
+    struct Ring {
+        Record slots[ring_size];
+        std::atomic<uint64_t> tail = 0;
+        uint64_t head = 0;
+    };
+
+    struct Signal {
+        std::string scope;
+        std::string name;
+        bool level;
+    };
+
+    Ring *ring_buffers = nullptr;
+    std::atomic<unsigned int> next_ring = 0;
+    std::atomic<uint64_t> dropped = 0;
+    std::vector<Signal> signals;
+
+    SimClock *sim_clock = nullptr;
+    FILE *file = nullptr;
+    uint64_t start_ns = 0;
+    uint64_t last_time_ns = 0;
+    pthread_t writer_pthread = {0};
+    std::atomic<bool> writer_started = false;
+    std::atomic<bool> writer_stopped = false;
+    std::atomic<uint32_t> writer_kick = 0;
+
+    uint64_t now_ns() { return sim_clock ? sim_clock->now_ns() : clock_now_ns(); }
+    unsigned int thread_ring();
+    void write_header();
+    void flush();
+
+    friend void *waveform_writer_thread_fn(void *data);
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_WAVEFORMRECORDER_HPP
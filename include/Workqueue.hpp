@@ -0,0 +1,118 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HWMOCKER_WORKQUEUE_HPP
+#define __HWMOCKER_WORKQUEUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <pthread.h>
+
+namespace HWMocker {
+
+///
+/// struct Work
+///
+/// Deferred work item, embedded in its owner so that queueing it never
+/// allocates.
+struct Work {
+    void (*func)(void *ctx, unsigned int arg) = nullptr;
+    void *ctx = nullptr;
+    unsigned int arg = 0;
+    Work *next = nullptr;
+    std::atomic<bool> queued = false;
+};
+
+void *softirq_thread_fn(void *data);
+
+///
+/// class Workqueue
+///
+/// Bottom halves of a processing unit: the works are queued from the signal
+/// handler on a lock-free list and run either on a dedicated softirq thread or
+/// at the interrupt check points of the processing unit thread.
+class Workqueue {
+  public:
+    /// Where the queued works run
+    enum class Context {
+        /// dedicated "softirq" thread
+        SOFTIRQ,
+        /// processing unit thread, at its interrupt check points
+        PROCESSING_UNIT,
+    };
+
+    // Constructors/Destructors
+
+    ///
+    /// Empty Constructor
+    Workqueue() {}
+
+    ///
+    /// Empty Destructor
+    virtual ~Workqueue();
+
+    /// Records the calling thread as the processing unit thread
+    void start() { owner = pthread_self(); }
+
+    /// Starts the softirq thread with the SOFTIRQ context, does nothing otherwise
+    void start_softirq();
+
+    /// Queue a work, async-signal-safe. A work already queued is not queued twice.
+    /// @return true if the work was queued
+    bool queue(Work *work);
+
+    /// Run the queued works in their queueing order
+    /// @return the number of works run
+    unsigned int drain();
+
+    /// Drains the queue when called from the processing unit thread with the
+    /// PROCESSING_UNIT context
+    void check_point();
+
+    bool is_empty() { return !head.load(); }
+
+    /// To be set before the first bottom half is queued
+    void set_context(Context context) { this->context = context; }
+    Context get_context() { return context; }
+    static Context context_from_string(const std::string &name);
+
+  private:
+    Context context = Context::SOFTIRQ;
+    /// works queued, last queued first
+    std::atomic<Work *> head = nullptr;
+    pthread_t owner = {0};
+
+    pthread_t softirq_pthread = {0};
+    std::atomic<bool> softirq_started = false;
+    std::atomic<bool> softirq_stopped = false;
+    std::atomic<uint32_t> softirq_kick = 0;
+
+    void wake_softirq();
+
+    friend void *softirq_thread_fn(void *data);
+};
+} // namespace HWMocker
+
+#endif // __HWMOCKER_WORKQUEUE_HPP
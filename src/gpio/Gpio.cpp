@@ -1,5 +1,63 @@
 #include "Gpio.hpp"
 
+#include <hwmocker/irq.h>
+
+using namespace HWMocker;
+
 HWMocker::Gpio::Gpio(unsigned int pin_idx) : Pin(pin_idx), input(true), level(false) {}
 
 HWMocker::Gpio::~Gpio() {}
+
+void Gpio::watch() {
+    if (!graph || watched.exchange(true))
+        return;
+
+    graph->watch(net_node);
+    level = graph->get_level(net_node);
+}
+
+int Gpio::wait_edge(unsigned int type, int timeout_us) {
+    struct timespec ts;
+    const struct timespec *deadline = futex_deadline(timeout_us, &ts);
+    int rc = 0;
+
+    watch();
+    uint32_t rising_start = rising.load();
+    uint32_t falling_start = falling.load();
+
+    waiters.fetch_add(1);
+    for (;;) {
+        uint32_t seq = edges.load();
+        if (((type & HWMOCKER_IRQ_RISING_EDGE) && rising.load() != rising_start) ||
+            ((type & HWMOCKER_IRQ_FALLING_EDGE) && falling.load() != falling_start))
+            break;
+
+        rc = futex_wait(&edges, seq, deadline);
+        if (rc == -ETIMEDOUT)
+            break;
+        rc = 0;
+    }
+    waiters.fetch_sub(1);
+    return rc;
+}
+
+int Gpio::wait_level(bool value, int timeout_us) {
+    struct timespec ts;
+    const struct timespec *deadline = futex_deadline(timeout_us, &ts);
+    int rc = 0;
+
+    watch();
+    waiters.fetch_add(1);
+    for (;;) {
+        uint32_t seq = edges.load();
+        if (get_value() == value)
+            break;
+
+        rc = futex_wait(&edges, seq, deadline);
+        if (rc == -ETIMEDOUT)
+            break;
+        rc = 0;
+    }
+    waiters.fetch_sub(1);
+    return rc;
+}
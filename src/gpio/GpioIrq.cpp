@@ -12,6 +12,13 @@ GpioIrq::GpioIrq(IrqController *irq_controller, unsigned int pin_idx) : Gpio(pin
 
 GpioIrq::GpioIrq(IrqController *irq_controller, Gpio *gpio) : Gpio(gpio->pin_idx) {
     this->irq_controller = irq_controller;
+    level = gpio->get_value();
+    copy_traces(gpio);
+    if (gpio->get_net_graph()) {
+        gpio->get_net_graph()->replace_pin(gpio, this);
+        return;
+    }
+
     for (Pin *pin : gpio->get_connected_pins()) {
         auto it = find(pin->get_connected_pins().begin(), pin->get_connected_pins().end(), gpio);
         int old_idx = it - pin->get_connected_pins().begin();
@@ -20,10 +27,38 @@ GpioIrq::GpioIrq(IrqController *irq_controller, Gpio *gpio) : Gpio(gpio->pin_idx
     }
 }
 
-GpioIrq::~GpioIrq() {}
+GpioIrq::~GpioIrq() { irq_controller->unregister_irq(this); }
 
 // Methods
 
+void GpioIrq::on_change(bool value) {
+    bool previous = level;
+    level = value;
+
+    bool raise = (!previous && value && (trigger & HWMOCKER_IRQ_RISING_EDGE)) ||
+                 (previous && !value && (trigger & HWMOCKER_IRQ_FALLING_EDGE));
+    if (is_active(value)) {
+        asserted.fetch_add(1);
+        if (!is_active(previous))
+            raise = true;
+    }
+
+    if (raise)
+        irq_controller->local_raise(this);
+    // Raised first: the edge waiters find the irq pending
+    count_edge(previous, value);
+}
+
+int GpioIrq::handle() {
+    uint32_t asserted_before = asserted.load();
+    int rc = handler ? handler() : 0;
+
+    // EOI: re-assert a level irq written active while it was handled
+    if (is_active(level) && asserted.load() != asserted_before)
+        irq_controller->local_raise(this);
+    return rc;
+}
+
 // Accessor methods
 
 // Other methods
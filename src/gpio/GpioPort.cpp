@@ -0,0 +1,108 @@
+#include "GpioPort.hpp"
+
+#include <hwmocker_internal.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace HWMocker;
+
+// Constructors/Destructors
+GpioPort::GpioPort(IrqController *irq_controller, HwIrq *irq) {
+    if (!irq) {
+        stringstream reason;
+        reason << "Cannot allocate with a null hw irq" << endl << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+
+    this->irq = irq;
+    this->irq_controller = irq_controller;
+    irq->set_handler(port_irq_handler, this);
+}
+
+GpioPort::~GpioPort() {
+    if (irq_controller)
+        irq_controller->unregister_irq(irq);
+    delete irq;
+}
+
+int GpioPort::port_irq_handler(void *ctx) {
+    GpioPort *port = (GpioPort *)ctx;
+    uint64_t changed = port->irq_status.exchange(0);
+
+    if (changed && port->handler)
+        return port->handler(changed);
+    return 0;
+}
+
+int GpioPort::load_config(json config) {
+    port_index = config["index"];
+    width = config["width"];
+    if (!width || width > 64)
+        return -EINVAL;
+
+    if (config.contains("irq")) {
+        irq->set_irqn(config["irq"]);
+        has_irq = true;
+        if (irq_controller)
+            return irq_controller->register_irq(irq, config["irq"]);
+    }
+    return 0;
+}
+
+int GpioPort::connect(GpioPort *remote_port) {
+    if (remote_port->width != width)
+        return -EINVAL;
+
+    this->remote_port = remote_port;
+    remote_port->remote_port = this;
+    remote_port->levels = levels;
+    return 0;
+}
+
+void GpioPort::set_mask(uint64_t mask) {
+    mask &= get_pins_mask();
+    uint64_t old_levels = levels->fetch_or(mask, memory_order_acq_rel);
+    propagate(~old_levels & mask);
+}
+
+void GpioPort::clear_mask(uint64_t mask) {
+    mask &= get_pins_mask();
+    uint64_t old_levels = levels->fetch_and(~mask, memory_order_acq_rel);
+    propagate(old_levels & mask);
+}
+
+void GpioPort::toggle_mask(uint64_t mask) {
+    mask &= get_pins_mask();
+    levels->fetch_xor(mask, memory_order_acq_rel);
+    propagate(mask);
+}
+
+void GpioPort::propagate(uint64_t changed) {
+    if (changed && remote_port)
+        remote_port->receive(changed);
+}
+
+/// Latches the pins changed by the remote port in the shared levels
+void GpioPort::receive(uint64_t changed) {
+    uint64_t latched = changed & irq_mask.load(memory_order_relaxed);
+    if (latched && irq_controller) {
+        irq_status.fetch_or(latched);
+        irq_controller->local_raise(irq);
+    }
+}
+
+int GpioPort::set_irq_handler(uint64_t irq_mask, int (*handler)(uint64_t changed)) {
+    if (!has_irq)
+        return -ENOENT;
+
+    this->handler = handler;
+    this->irq_mask.store(irq_mask & get_pins_mask());
+    if (handler && irq_mask)
+        irq->enable();
+    else
+        irq->disable();
+    return 0;
+}
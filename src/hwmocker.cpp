@@ -26,12 +26,23 @@
 #include <hwmocker_internal.h>
 
 #ifdef CONFIG_HWMOCK_SPI
+#include <DmaController.hpp>
 #include <SpiDevice.hpp>
 #endif
+#ifdef CONFIG_HWMOCK_UART
+#include <UartDevice.hpp>
+#endif
+#ifdef CONFIG_HWMOCK_I2C
+#include <I2cDevice.hpp>
+#endif
+#ifdef CONFIG_HWMOCK_MAILBOX
+#include <Mailbox.hpp>
+#endif
 
 #include <signal.h>
 #include <stdlib.h>
 
+#include <cinttypes>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -157,6 +168,11 @@ int hwmocker_set_gpio_irq_handler(void *hw_element, unsigned int pin_idx, int (*
     return processing_unit->set_gpio_irq(pin_idx, handler);
 }
 
+int hwmocker_set_gpio_irq_trigger(void *hw_element, unsigned int pin_idx, unsigned int trigger) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->set_gpio_irq_trigger(pin_idx, trigger);
+}
+
 void *hwmocker_get_soc(struct hwmocker *mocker) { return (void *)mocker->system->get_soc(); }
 
 void *hwmocker_get_host(struct hwmocker *mocker) { return (void *)mocker->system->get_host(); }
@@ -169,17 +185,185 @@ void hwmocker_wait_soc_ready(struct hwmocker *mocker) { mocker->system->wait_soc
 
 void hwmocker_wait_host_ready(struct hwmocker *mocker) { mocker->system->wait_host_ready(); }
 
+unsigned long long hwmocker_get_time_ns(struct hwmocker *mocker) {
+    return mocker->system->get_sim_clock()->now_ns();
+}
+
 void hwmocker_set_gpio_level(void *hw_element, unsigned int pin_idx, bool level) {
     ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
     processing_unit->set_gpio_value(pin_idx, level);
 }
 
+bool hwmocker_get_gpio_level(void *hw_element, unsigned int pin_idx) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->get_gpio_value(pin_idx);
+}
+
+int hwmocker_gpio_wait_edge(void *hw_element, unsigned int pin_idx, unsigned int type,
+                            int timeout_us) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->wait_gpio_edge(pin_idx, type, timeout_us);
+}
+
+int hwmocker_gpio_wait_level(void *hw_element, unsigned int pin_idx, bool level, int timeout_us) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->wait_gpio_level(pin_idx, level, timeout_us);
+}
+
+void *hwmocker_get_gpio_port(void *hw_element, unsigned int port_idx) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->get_gpio_port(port_idx);
+}
+
+void hwmocker_gpio_port_set_mask(void *_port, uint64_t mask) {
+    GpioPort *port = (GpioPort *)_port;
+    port->set_mask(mask);
+}
+
+void hwmocker_gpio_port_clear_mask(void *_port, uint64_t mask) {
+    GpioPort *port = (GpioPort *)_port;
+    port->clear_mask(mask);
+}
+
+void hwmocker_gpio_port_toggle_mask(void *_port, uint64_t mask) {
+    GpioPort *port = (GpioPort *)_port;
+    port->toggle_mask(mask);
+}
+
+uint64_t hwmocker_gpio_port_read(void *_port) {
+    GpioPort *port = (GpioPort *)_port;
+    return port->read();
+}
+
+int hwmocker_gpio_port_set_irq_handler(void *_port, uint64_t irq_mask,
+                                       int (*handler)(uint64_t changed)) {
+    GpioPort *port = (GpioPort *)_port;
+    return port->set_irq_handler(irq_mask, handler);
+}
+
+void hwmocker_poll_irqs(void *hw_element) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    processing_unit->poll_irqs();
+}
+
+int hwmocker_wait_irq(void *hw_element, int timeout_us) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->wait_irq(timeout_us);
+}
+
+int hwmocker_set_irq_priority(void *hw_element, unsigned int irqn, unsigned int priority) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->set_irq_priority(irqn, priority);
+}
+
+int hwmocker_set_irq_priority_grouping(void *hw_element, unsigned int subpriority_bits) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->get_irq_controller()->set_priority_grouping(subpriority_bits);
+}
+
+int hwmocker_set_irq_basepri(void *hw_element, unsigned int basepri) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->get_irq_controller()->set_basepri(basepri);
+}
+
+unsigned int hwmocker_get_irq_basepri(void *hw_element) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->get_irq_controller()->get_basepri();
+}
+
+unsigned int hwmocker_get_irq_running_priority(void *hw_element) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->get_irq_controller()->get_running_priority();
+}
+
+int hwmocker_set_irq_coalescing(void *hw_element, unsigned int irqn, unsigned int max_events,
+                                unsigned int max_delay_us) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->set_irq_coalescing(irqn, max_events, max_delay_us);
+}
+
+int hwmocker_set_irq_polling(void *hw_element, unsigned int budget, unsigned int interval_us) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->set_irq_polling(budget, interval_us);
+}
+
+void hwmocker_set_irq_latency_tracking(void *hw_element, bool enable) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    processing_unit->get_irq_controller()->set_latency_tracking(enable);
+}
+
+int hwmocker_get_irq_latency(void *hw_element, unsigned int irqn,
+                             struct hwmocker_irq_latency *latency) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    LatencySnapshot snapshot;
+    int rc = processing_unit->get_irq_controller()->get_latency(irqn, &snapshot);
+    if (rc)
+        return rc;
+
+    latency->count = snapshot.count;
+    latency->min = snapshot.min_ns;
+    latency->max = snapshot.max_ns;
+    latency->mean = snapshot.mean_ns;
+    latency->p50 = snapshot.p50_ns;
+    latency->p90 = snapshot.p90_ns;
+    latency->p99 = snapshot.p99_ns;
+    latency->p999 = snapshot.p999_ns;
+    return 0;
+}
+
+void hwmocker_reset_irq_latencies(void *hw_element) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    processing_unit->get_irq_controller()->reset_latencies();
+}
+
+void hwmocker_dump_irq_latencies(void *hw_element, FILE *stream) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    IrqController *irq_controller = processing_unit->get_irq_controller();
+    LatencySnapshot snapshot;
+
+    fprintf(stream, "%5s %10s %10s %10s %10s %10s %10s %10s %10s\n", "irq", "count", "min",
+            "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (unsigned int irqn = 0; irqn < HWMOCK_IRQ_LINES; irqn++) {
+        if (irq_controller->get_latency(irqn, &snapshot) || !snapshot.count)
+            continue;
+        fprintf(stream,
+                "%5u %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+                " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+                irqn, snapshot.count, snapshot.min_ns, snapshot.mean_ns, snapshot.p50_ns,
+                snapshot.p90_ns, snapshot.p99_ns, snapshot.p999_ns, snapshot.max_ns);
+    }
+}
+
+int hwmocker_set_irq_bottom_half(void *hw_element, unsigned int irqn, bool bottom_half) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->set_irq_bottom_half(irqn, bottom_half);
+}
+
+int hwmocker_get_irq_stats(void *hw_element, unsigned int irqn, struct hwmocker_irq_stats *stats) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    IrqLineStats line_stats;
+    int rc = processing_unit->get_irq_controller()->get_stats(irqn, &line_stats);
+    if (rc)
+        return rc;
+
+    stats->raised = line_stats.raised;
+    stats->delivered = line_stats.delivered;
+    stats->merged = line_stats.merged;
+    stats->polled = line_stats.polled;
+    return 0;
+}
+
 #ifdef CONFIG_HWMOCK_SPI
 void *hwmocker_get_spi_device(void *hw_element, unsigned int spi_idx) {
     ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
     return processing_unit->get_spi_device(spi_idx);
 }
 
+int hwmocker_spi_select(void *_spi_dev, unsigned int cs) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    return spi_dev->select(cs);
+}
+
 int hwmocker_spi_xfer(void *_spi_dev, const void *txbuf, void *rxbuf, size_t size) {
     SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
     return spi_dev->sync_xfer(txbuf, rxbuf, size);
@@ -191,6 +375,127 @@ int hwmocker_spi_xfer_async(void *_spi_dev, const void *txbuf, void *rxbuf, size
     return spi_dev->async_xfer(txbuf, rxbuf, size, callback, ctx);
 }
 
+static size_t iov_size(const struct iovec *iov, int count) {
+    size_t size = 0;
+    for (int idx = 0; idx < count; idx++)
+        size += iov[idx].iov_len;
+    return size;
+}
+
+int hwmocker_spi_xfer_iov(void *_spi_dev, const struct iovec *tx_iov, int tx_count,
+                          const struct iovec *rx_iov, int rx_count) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    if (tx_count < 0 || rx_count < 0)
+        return -EINVAL;
+
+    size_t size = max(iov_size(tx_iov, tx_count), iov_size(rx_iov, rx_count));
+    return spi_dev->sync_xfer(tx_iov, tx_count, rx_iov, rx_count, size);
+}
+
+int hwmocker_spi_xfer_iov_async(void *_spi_dev, const struct iovec *tx_iov, int tx_count,
+                                const struct iovec *rx_iov, int rx_count,
+                                int (*callback)(void *ctx), void *ctx) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    if (tx_count < 0 || rx_count < 0)
+        return -EINVAL;
+
+    size_t size = max(iov_size(tx_iov, tx_count), iov_size(rx_iov, rx_count));
+    return spi_dev->async_xfer(tx_iov, tx_count, rx_iov, rx_count, size, callback, ctx);
+}
+
+int hwmocker_spi_xfer_borrow(void *_spi_dev, const struct iovec *tx_iov, int tx_count,
+                             size_t size, const struct iovec **rx_iov, int *rx_count) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    if (tx_count < 0)
+        return -EINVAL;
+    return spi_dev->borrow_xfer(tx_iov, tx_count, size, rx_iov, rx_count);
+}
+
+int hwmocker_spi_release_borrowed(void *_spi_dev) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    return spi_dev->release_borrowed();
+}
+
+unsigned long long hwmocker_spi_xfer_duration_ns(void *_spi_dev, size_t size) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    return spi_dev->xfer_duration_ns(size);
+}
+
+void hwmocker_spi_get_stats(void *_spi_dev, struct hwmocker_spi_stats *stats) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    spi_dev->get_stats(stats);
+}
+
+void hwmocker_spi_reset_stats(void *_spi_dev) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    spi_dev->reset_stats();
+}
+
+int hwmocker_spi_stream_start(void *_spi_dev) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    return spi_dev->stream_start();
+}
+
+int hwmocker_spi_stream_stop(void *_spi_dev) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    return spi_dev->stream_stop();
+}
+
+ssize_t hwmocker_spi_stream_write(void *_spi_dev, const void *buf, size_t size) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    return spi_dev->stream_write(buf, size);
+}
+
+ssize_t hwmocker_spi_stream_read(void *_spi_dev, void *buf, size_t size) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    return spi_dev->stream_read(buf, size);
+}
+
+size_t hwmocker_spi_stream_level(void *_spi_dev) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    return spi_dev->stream_level();
+}
+
+int hwmocker_spi_stream_set_handler(void *_spi_dev, size_t watermark,
+                                    int (*handler)(unsigned int events, void *ctx), void *ctx) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    return spi_dev->set_stream_handler(watermark, handler, ctx);
+}
+
+int hwmocker_spi_bitbang_xfer(void *hw_element, const struct hwmocker_spi_bitbang *bus,
+                              const void *txbuf, void *rxbuf, size_t size) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->spi_bitbang_xfer(bus, txbuf, rxbuf, size);
+}
+
+int hwmocker_spi_responder_read(void *_spi_dev, unsigned int address, void *buf, size_t size) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    SpiResponder *responder = spi_dev->get_responder();
+    if (!responder)
+        return -ENODEV;
+    return responder->read_registers(address, buf, size);
+}
+
+int hwmocker_spi_responder_write(void *_spi_dev, unsigned int address, const void *buf,
+                                 size_t size) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    SpiResponder *responder = spi_dev->get_responder();
+    if (!responder)
+        return -ENODEV;
+    return responder->write_registers(address, buf, size);
+}
+
+int hwmocker_spi_submit(void *_spi_dev, const struct iovec *tx_iov, int tx_count,
+                        const struct iovec *rx_iov, int rx_count,
+                        int (*callback)(void *ctx, int status), void *ctx) {
+    SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
+    if (tx_count < 0 || rx_count < 0)
+        return -EINVAL;
+
+    size_t size = max(iov_size(tx_iov, tx_count), iov_size(rx_iov, rx_count));
+    return spi_dev->submit_xfer(tx_iov, tx_count, rx_iov, rx_count, size, callback, ctx);
+}
+
 void hwmocker_spi_enable_irq(void *_spi_dev) {
     SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
     return spi_dev->enable_interrupt();
@@ -199,4 +504,170 @@ void hwmocker_spi_disable_irq(void *_spi_dev) {
     SpiDevice *spi_dev = (SpiDevice *)_spi_dev;
     return spi_dev->disable_interrupt();
 }
+
+void *hwmocker_get_dma(void *hw_element, unsigned int dma_idx) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->get_dma(dma_idx);
+}
+
+int hwmocker_dma_set_ring(void *_dma, struct hwmocker_dma_desc *ring, unsigned int count) {
+    DmaController *dma = (DmaController *)_dma;
+    return dma->set_ring(ring, count);
+}
+
+int hwmocker_dma_kick(void *_dma) {
+    DmaController *dma = (DmaController *)_dma;
+    return dma->kick();
+}
+
+int hwmocker_dma_set_irq_handler(void *_dma, unsigned int irq_mask,
+                                 int (*handler)(unsigned int status, void *ctx), void *ctx) {
+    DmaController *dma = (DmaController *)_dma;
+    return dma->set_irq_handler(irq_mask, handler, ctx);
+}
+
+void hwmocker_dma_get_stats(void *_dma, struct hwmocker_dma_stats *stats) {
+    DmaController *dma = (DmaController *)_dma;
+    dma->get_stats(stats);
+}
+#endif
+
+#ifdef CONFIG_HWMOCK_UART
+void *hwmocker_get_uart(void *hw_element, unsigned int uart_idx) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->get_uart(uart_idx);
+}
+
+ssize_t hwmocker_uart_write(void *_uart, const void *buf, size_t size) {
+    UartDevice *uart = (UartDevice *)_uart;
+    return uart->write(buf, size);
+}
+
+ssize_t hwmocker_uart_read(void *_uart, void *buf, size_t size) {
+    UartDevice *uart = (UartDevice *)_uart;
+    return uart->read(buf, size);
+}
+
+size_t hwmocker_uart_read_span(void *_uart, const void **span) {
+    UartDevice *uart = (UartDevice *)_uart;
+    return uart->read_span(span);
+}
+
+size_t hwmocker_uart_consume(void *_uart, size_t size) {
+    UartDevice *uart = (UartDevice *)_uart;
+    return uart->consume(size);
+}
+
+size_t hwmocker_uart_rx_level(void *_uart) {
+    UartDevice *uart = (UartDevice *)_uart;
+    return uart->rx_level();
+}
+
+unsigned long long hwmocker_uart_xfer_duration_ns(void *_uart, size_t size) {
+    UartDevice *uart = (UartDevice *)_uart;
+    return uart->xfer_duration_ns(size);
+}
+
+int hwmocker_uart_set_irq_handler(void *_uart, unsigned int irq_mask, size_t rx_threshold,
+                                  int (*handler)(unsigned int status, void *ctx), void *ctx) {
+    UartDevice *uart = (UartDevice *)_uart;
+    return uart->set_irq_handler(irq_mask, rx_threshold, handler, ctx);
+}
+
+void hwmocker_uart_get_stats(void *_uart, struct hwmocker_uart_stats *stats) {
+    UartDevice *uart = (UartDevice *)_uart;
+    uart->get_stats(stats);
+}
+
+void hwmocker_uart_reset_stats(void *_uart) {
+    UartDevice *uart = (UartDevice *)_uart;
+    uart->reset_stats();
+}
+#endif
+
+#ifdef CONFIG_HWMOCK_I2C
+void *hwmocker_get_i2c_device(void *hw_element, unsigned int i2c_idx) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->get_i2c_device(i2c_idx);
+}
+
+int hwmocker_i2c_transfer(void *_i2c_dev, struct hwmocker_i2c_msg *msgs, int count) {
+    I2cDevice *i2c_dev = (I2cDevice *)_i2c_dev;
+    return i2c_dev->transfer(msgs, count);
+}
+
+unsigned long long hwmocker_i2c_xfer_duration_ns(void *_i2c_dev,
+                                                 const struct hwmocker_i2c_msg *msgs, int count) {
+    I2cDevice *i2c_dev = (I2cDevice *)_i2c_dev;
+    return i2c_dev->xfer_duration_ns(msgs, count);
+}
+
+int hwmocker_i2c_set_target(void *_i2c_dev, unsigned int address,
+                            const struct hwmocker_i2c_target_ops *ops, void *ctx) {
+    I2cDevice *i2c_dev = (I2cDevice *)_i2c_dev;
+    return i2c_dev->set_target(address, ops, ctx);
+}
+
+void hwmocker_i2c_stretch(void *_i2c_dev, unsigned long long ns) {
+    I2cDevice *i2c_dev = (I2cDevice *)_i2c_dev;
+    i2c_dev->stretch(ns);
+}
+
+int hwmocker_i2c_get_stats(void *_i2c_dev, struct hwmocker_i2c_stats *stats) {
+    I2cDevice *i2c_dev = (I2cDevice *)_i2c_dev;
+    return i2c_dev->get_stats(stats);
+}
+
+void hwmocker_i2c_reset_stats(void *_i2c_dev) {
+    I2cDevice *i2c_dev = (I2cDevice *)_i2c_dev;
+    i2c_dev->reset_stats();
+}
+#endif
+
+#ifdef CONFIG_HWMOCK_MAILBOX
+void *hwmocker_get_mailbox(void *hw_element, unsigned int mailbox_idx) {
+    ProcessingUnit *processing_unit = (ProcessingUnit *)hw_element;
+    return processing_unit->get_mailbox(mailbox_idx);
+}
+
+ssize_t hwmocker_mailbox_write(void *_mailbox, const void *buf, size_t size) {
+    Mailbox::Endpoint *mailbox = (Mailbox::Endpoint *)_mailbox;
+    return mailbox->write(buf, size);
+}
+
+ssize_t hwmocker_mailbox_read(void *_mailbox, void *buf, size_t size) {
+    Mailbox::Endpoint *mailbox = (Mailbox::Endpoint *)_mailbox;
+    return mailbox->read(buf, size);
+}
+
+size_t hwmocker_mailbox_read_span(void *_mailbox, const void **span) {
+    Mailbox::Endpoint *mailbox = (Mailbox::Endpoint *)_mailbox;
+    return mailbox->read_span(span);
+}
+
+size_t hwmocker_mailbox_consume(void *_mailbox, size_t size) {
+    Mailbox::Endpoint *mailbox = (Mailbox::Endpoint *)_mailbox;
+    return mailbox->consume(size);
+}
+
+size_t hwmocker_mailbox_rx_level(void *_mailbox) {
+    Mailbox::Endpoint *mailbox = (Mailbox::Endpoint *)_mailbox;
+    return mailbox->rx_level();
+}
+
+int hwmocker_mailbox_set_irq_handler(void *_mailbox, unsigned int irq_mask,
+                                     int (*handler)(unsigned int status, void *ctx), void *ctx) {
+    Mailbox::Endpoint *mailbox = (Mailbox::Endpoint *)_mailbox;
+    return mailbox->set_irq_handler(irq_mask, handler, ctx);
+}
+
+void hwmocker_mailbox_get_stats(void *_mailbox, struct hwmocker_mailbox_stats *stats) {
+    Mailbox::Endpoint *mailbox = (Mailbox::Endpoint *)_mailbox;
+    mailbox->get_stats(stats);
+}
+
+void hwmocker_mailbox_reset_stats(void *_mailbox) {
+    Mailbox::Endpoint *mailbox = (Mailbox::Endpoint *)_mailbox;
+    mailbox->reset_stats();
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "I2cBus.hpp"
+#include "I2cDevice.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <errno.h>
+
+using namespace std;
+using namespace HWMocker;
+
+int I2cBus::attach(unsigned int address, I2cDevice *target) {
+    if (address >= targets.size())
+        return -EINVAL;
+    if (targets[address])
+        return -EBUSY;
+
+    targets[address] = target;
+    return 0;
+}
+
+int I2cBus::transfer(struct hwmocker_i2c_msg *msgs, int count) {
+    // Addresses of the targets to tell about the stop
+    uint64_t addressed[HWMOCKER_I2C_ADDRESSES / 64] = {};
+    uint64_t bits = 0, stretched_ns = 0, bytes = 0;
+    int done = 0;
+    int rc = 0;
+
+    for (int idx = 0; idx < count; idx++) {
+        struct hwmocker_i2c_msg &msg = msgs[idx];
+        if (msg.addr >= targets.size() || (msg.len && !msg.buf)) {
+            rc = -EINVAL;
+            break;
+        }
+
+        // (Repeated) start, address and read bit, acknowledge
+        bits += 1 + 9;
+        I2cDevice *target = targets[msg.addr];
+        void *ctx = nullptr;
+        const struct hwmocker_i2c_target_ops *ops =
+            target ? target->get_target(msg.addr, &ctx) : nullptr;
+        if (!ops) {
+            stats_nacks.fetch_add(1, memory_order_relaxed);
+            rc = -ENXIO;
+            break;
+        }
+        addressed[msg.addr / 64] |= 1ULL << (msg.addr % 64);
+
+        bool read = msg.flags & HWMOCKER_I2C_M_RD;
+        if (ops->start)
+            ops->start(ctx, read);
+
+        if (read) {
+            int provided = ops->read ? ops->read(ctx, msg.buf, msg.len) : 0;
+            if (provided >= 0) {
+                // The released data line reads ones
+                size_t size = min((size_t)provided, msg.len);
+                memset(msg.buf + size, 0xff, msg.len - size);
+                bits += 9 * msg.len;
+                bytes += msg.len;
+            } else {
+                rc = provided;
+            }
+        } else {
+            int acked = ops->write ? ops->write(ctx, msg.buf, msg.len) : 0;
+            if (acked >= 0) {
+                // The byte not acknowledged is clocked too
+                size_t size = min((size_t)acked, msg.len);
+                bits += 9 * min(size + 1, msg.len);
+                bytes += size;
+                if (size < msg.len) {
+                    stats_nacks.fetch_add(1, memory_order_relaxed);
+                    rc = -EIO;
+                }
+            } else {
+                rc = acked;
+            }
+        }
+        stretched_ns += target->take_stretch_ns();
+        if (rc)
+            break;
+        done++;
+    }
+    bits += 1;
+
+    for (unsigned int word = 0; word < HWMOCKER_I2C_ADDRESSES / 64; word++) {
+        for (uint64_t set = addressed[word]; set; set &= set - 1) {
+            unsigned int address = word * 64 + __builtin_ctzll(set);
+            I2cDevice *target = targets[address];
+            void *ctx;
+            const struct hwmocker_i2c_target_ops *ops = target->get_target(address, &ctx);
+            if (ops && ops->stop)
+                ops->stop(ctx);
+            stretched_ns += target->take_stretch_ns();
+        }
+    }
+
+    uint64_t busy_ns = bits_duration_ns(bits) + stretched_ns;
+    if (busy_ns && sim_clock)
+        sim_clock->wait_until(sim_clock->now_ns() + busy_ns);
+
+    stats_transfers.fetch_add(1, memory_order_relaxed);
+    stats_messages.fetch_add(done, memory_order_relaxed);
+    stats_bytes.fetch_add(bytes, memory_order_relaxed);
+    stats_busy_ns.fetch_add(busy_ns, memory_order_relaxed);
+    return rc ? rc : done;
+}
+
+uint64_t I2cBus::bits_duration_ns(uint64_t bits) {
+    if (!clk_hz)
+        return 0;
+    // Split so that the bits do not overflow once in ns
+    return bits / clk_hz * 1000000000ULL + bits % clk_hz * 1000000000ULL / clk_hz;
+}
+
+uint64_t I2cBus::xfer_duration_ns(const struct hwmocker_i2c_msg *msgs, int count) {
+    uint64_t bits = 1;
+    for (int idx = 0; idx < count; idx++)
+        bits += 1 + 9 + 9 * msgs[idx].len;
+    return bits_duration_ns(bits);
+}
+
+void I2cBus::get_stats(struct hwmocker_i2c_stats *stats) {
+    stats->transfers = stats_transfers.load();
+    stats->messages = stats_messages.load();
+    stats->bytes = stats_bytes.load();
+    stats->nacks = stats_nacks.load();
+    stats->busy_ns = stats_busy_ns.load();
+    stats->elapsed_ns = now_ns() - stats_since_ns.load();
+}
+
+void I2cBus::reset_stats() {
+    stats_transfers.store(0);
+    stats_messages.store(0);
+    stats_bytes.store(0);
+    stats_nacks.store(0);
+    stats_busy_ns.store(0);
+    stats_since_ns.store(now_ns());
+}
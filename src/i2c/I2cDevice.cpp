@@ -0,0 +1,120 @@
+#include "I2cDevice.hpp"
+
+#include <hwmocker_internal.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <errno.h>
+
+using namespace std;
+using namespace HWMocker;
+
+// Constructors/Destructors
+I2cDevice::I2cDevice() {}
+
+I2cDevice::~I2cDevice() {
+    if (scl)
+        delete scl;
+    if (sda)
+        delete sda;
+    if (bus)
+        delete bus;
+}
+
+int I2cDevice::load_config(json config) {
+    i2c_index = config["index"];
+    is_controller = config.value("controller", false);
+    scl = new Gpio(config["scl-pin"]);
+    sda = new Gpio(config["sda-pin"]);
+
+    if (is_controller) {
+        // 100kHz standard mode by default, untimed with 0
+        bus = new I2cBus(config.value("clk-hz", 100000ULL));
+        return 0;
+    }
+
+    for (unsigned int address : config.value("addresses", json::array())) {
+        if (address >= HWMOCKER_I2C_ADDRESSES || slots[address].declared) {
+            stringstream reason;
+            reason << "i2c target address " << address << " is not a 7 bit address or is repeated"
+                   << endl
+                   << get_stacktrace_str(64) << endl;
+            throw new runtime_error(reason.str());
+        }
+        slots[address].declared = true;
+        addresses.push_back(address);
+    }
+    return 0;
+}
+
+void I2cDevice::set_sim_clock(SimClock *sim_clock) {
+    if (bus)
+        bus->set_sim_clock(sim_clock);
+}
+
+bool I2cDevice::is_connected(Gpio *pin, Gpio *peer_pin) {
+    vector<Pin *> &pins = pin->get_connected_pins();
+    vector<Pin *> &peer_pins = peer_pin->get_connected_pins();
+    return find(pins.begin(), pins.end(), peer_pin) != pins.end() ||
+           find(peer_pins.begin(), peer_pins.end(), pin) != peer_pins.end();
+}
+
+int I2cDevice::attach(I2cDevice *target) {
+    if (!bus || target->is_controller || target->attached || !is_connected(scl, target->scl) ||
+        !is_connected(sda, target->sda))
+        return -EINVAL;
+
+    int attached_addresses = 0;
+    for (unsigned int address : target->addresses) {
+        if (bus->attach(address, target)) {
+            printf("I2c %u: address 0x%02x already on the bus\n", i2c_index, address);
+            continue;
+        }
+        attached_addresses++;
+    }
+    target->attached = true;
+    return attached_addresses;
+}
+
+int I2cDevice::transfer(struct hwmocker_i2c_msg *msgs, int count) {
+    if (!bus)
+        return -ENOTCONN;
+    return bus->transfer(msgs, count);
+}
+
+uint64_t I2cDevice::xfer_duration_ns(const struct hwmocker_i2c_msg *msgs, int count) {
+    return bus ? bus->xfer_duration_ns(msgs, count) : 0;
+}
+
+int I2cDevice::set_target(unsigned int address, const struct hwmocker_i2c_target_ops *ops,
+                          void *ctx) {
+    if (address >= HWMOCKER_I2C_ADDRESSES || !slots[address].declared)
+        return -ENOENT;
+
+    TargetSlot &slot = slots[address];
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    do {
+        while (seq & 1)
+            seq = slot.seq.load(std::memory_order_relaxed);
+    } while (!slot.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.ctx.store(ctx, std::memory_order_relaxed);
+    slot.ops.store(ops, std::memory_order_relaxed);
+    slot.seq.store(seq + 2, std::memory_order_release);
+    return 0;
+}
+
+int I2cDevice::get_stats(struct hwmocker_i2c_stats *stats) {
+    if (!bus)
+        return -ENOTCONN;
+    bus->get_stats(stats);
+    return 0;
+}
+
+void I2cDevice::reset_stats() {
+    if (bus)
+        bus->reset_stats();
+}
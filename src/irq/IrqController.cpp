@@ -1,8 +1,9 @@
 #include "IrqController.hpp"
+#include "Clock.hpp"
+#include "Futex.hpp"
 #include <hwmocker/config.h>
 #include <hwmocker_internal.h>
 
-#include <map>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -12,16 +13,29 @@ using namespace std;
 
 string get_stacktrace_str(unsigned int max_frames);
 
-std::map<pthread_t, IrqController *> signal_handlers_map;
-pthread_mutex_t signal_handlers_map_mutex;
+/// Irq controller of the calling thread, used by the signal handler
+static thread_local IrqController *local_irq_controller = nullptr;
 
 static void signal_handler(int signo, siginfo_t *info, void *extra);
 
 // Constructors/Destructors
 
-IrqController::IrqController() {}
+IrqController::IrqController() {
+    for (unsigned int irqn = 0; irqn < HWMOCK_IRQ_LINES; irqn++) {
+        lines[irqn].work.func = run_bottom_half;
+        lines[irqn].work.ctx = this;
+        lines[irqn].work.arg = irqn;
+    }
+}
 
-IrqController::~IrqController() {}
+IrqController::~IrqController() {
+    if (timer_started.load()) {
+        timer_stopped.store(true);
+        wake_timer();
+        pthread_join(timer_pthread, NULL);
+    }
+    delete[] latency_histograms;
+}
 
 void IrqController::set_dest_irq_controller(IrqController *dest_controller) {
     if (this->dest_controller) {
@@ -33,13 +47,23 @@ void IrqController::set_dest_irq_controller(IrqController *dest_controller) {
     this->dest_controller = dest_controller;
 }
 
-void IrqController::start() {
-    int rc;
+IrqController::Delivery IrqController::delivery_from_string(const string &name) {
+    if (name == "signal")
+        return Delivery::SIGNAL;
+    if (name == "doorbell")
+        return Delivery::DOORBELL;
 
-    action.sa_flags = SA_SIGINFO;
+    stringstream reason;
+    reason << "Unknown irq delivery " << name << endl << get_stacktrace_str(64) << endl;
+    throw new runtime_error(reason.str());
+}
+
+void IrqController::start() {
+    // Nested interrupts: a higher priority irq is handled in the running handler
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
     action.sa_sigaction = signal_handler;
+    sigemptyset(&action.sa_mask);
     pthread = pthread_self();
-    dest_controller = NULL;
 
     if (sigaction(HWMOCK_IRQ_SIGNUM, &action, NULL)) {
         stringstream reason;
@@ -48,23 +72,173 @@ void IrqController::start() {
         throw new runtime_error(reason.str());
     }
 
-    rc = pthread_mutex_lock(&signal_handlers_map_mutex);
-    if (rc) {
+    if (local_irq_controller) {
         stringstream reason;
-        reason << "sigaction pthread_mutex_lock with " << strerror(rc) << endl
+        reason << "Irq signal handler already registered" << endl
                << get_stacktrace_str(64) << endl;
         throw new runtime_error(reason.str());
     }
+    local_irq_controller = this;
+}
 
-    if (signal_handlers_map.count(pthread_self())) {
-        pthread_mutex_unlock(&signal_handlers_map_mutex);
-        stringstream reason;
-        reason << "Irq signal handler already registered" << endl
-               << get_stacktrace_str(64) << endl;
-        throw new runtime_error(reason.str());
+int IrqController::register_irq(GenericIrq *irq, unsigned int irqn) {
+    GenericIrq *expected = nullptr;
+
+    if (irqn >= HWMOCK_IRQ_LINES || irq->irq_line >= 0)
+        return -EINVAL;
+
+    if (!lines[irqn].irq.compare_exchange_strong(expected, irq))
+        return -EBUSY;
+
+    irq->irq_line = irqn;
+    return 0;
+}
+
+void IrqController::unregister_irq(GenericIrq *irq) {
+    if (irq->irq_line < 0)
+        return;
+
+    GenericIrq *expected = irq;
+    lines[irq->irq_line].irq.compare_exchange_strong(expected, nullptr);
+    irq->irq_line = -1;
+}
+
+int IrqController::set_priority(unsigned int irqn, unsigned int priority) {
+    if (irqn >= HWMOCK_IRQ_LINES || priority >= HWMOCK_IRQ_PRIORITIES)
+        return -EINVAL;
+
+    unsigned int old_priority = lines[irqn].priority.exchange(priority);
+    uint64_t mask = 1ULL << (irqn % 64);
+
+    // Move a pending irq to its new level
+    if (old_priority != priority &&
+        (pending[old_priority][irqn / 64].fetch_and(~mask) & mask))
+        set_pending(irqn, priority);
+    return 0;
+}
+
+int IrqController::set_priority_grouping(unsigned int subpriority_bits) {
+    if (subpriority_bits >= 32 || (1U << subpriority_bits) > HWMOCK_IRQ_PRIORITIES)
+        return -EINVAL;
+
+    priority_grouping.store(subpriority_bits);
+    return 0;
+}
+
+int IrqController::set_basepri(unsigned int basepri) {
+    if (basepri >= HWMOCK_IRQ_PRIORITIES)
+        return -EINVAL;
+
+    unsigned int old_basepri = this->basepri.exchange(basepri);
+    // Deliver the lines unmasked
+    if (old_basepri && (!basepri || basepri > old_basepri) && allirqs_enabled &&
+        (pending_levels.load() & preemption_levels(HWMOCK_IRQ_PRIORITIES)))
+        interrupt();
+    return 0;
+}
+
+bool IrqController::is_pending(unsigned int irqn) {
+    if (irqn >= HWMOCK_IRQ_LINES)
+        return false;
+    return pending[lines[irqn].priority.load()][irqn / 64].load() & (1ULL << (irqn % 64));
+}
+
+bool IrqController::is_active(unsigned int irqn) {
+    if (irqn >= HWMOCK_IRQ_LINES)
+        return false;
+    return active[irqn / 64].load() & (1ULL << (irqn % 64));
+}
+
+int IrqController::set_coalescing(unsigned int irqn, unsigned int max_events,
+                                  unsigned int max_delay_us) {
+    if (irqn >= HWMOCK_IRQ_LINES || (max_events > 1 && !max_delay_us))
+        return -EINVAL;
+
+    uint64_t mask = 1ULL << (irqn % 64);
+    lines[irqn].max_delay_us.store(max_delay_us);
+    lines[irqn].max_events.store(max_events);
+    if (max_events > 1) {
+        coalesced[irqn / 64].fetch_or(mask);
+        start_timer();
+    } else {
+        coalesced[irqn / 64].fetch_and(~mask);
+        // Flush the raises batched so far
+        if (lines[irqn].batched.load())
+            deliver(irqn);
+    }
+    return 0;
+}
+
+int IrqController::set_polling(unsigned int budget, unsigned int interval_us) {
+    if (budget && !interval_us)
+        return -EINVAL;
+
+    poll_interval_us.store(interval_us);
+    poll_budget.store(budget);
+    if (budget)
+        start_timer();
+    return 0;
+}
+
+int IrqController::set_bottom_half(unsigned int irqn, bool bottom_half) {
+    Workqueue *workqueue = this->workqueue.load();
+
+    if (irqn >= HWMOCK_IRQ_LINES || (bottom_half && !workqueue))
+        return -EINVAL;
+
+    if (bottom_half)
+        workqueue->start_softirq();
+    lines[irqn].bottom_half.store(bottom_half);
+    return 0;
+}
+
+int IrqController::get_stats(unsigned int irqn, IrqLineStats *stats) {
+    if (irqn >= HWMOCK_IRQ_LINES)
+        return -EINVAL;
+
+    stats->raised = lines[irqn].raised.load();
+    stats->delivered = lines[irqn].delivered.load();
+    stats->merged = lines[irqn].merged.load();
+    stats->polled = lines[irqn].polled.load();
+    return 0;
+}
+
+void IrqController::set_latency_tracking(bool enable) {
+    if (!enable) {
+        latencies.store(nullptr);
+        return;
     }
-    signal_handlers_map[pthread_self()] = this;
-    pthread_mutex_unlock(&signal_handlers_map_mutex);
+
+    if (!latency_histograms)
+        latency_histograms = new LatencyHistogram[HWMOCK_IRQ_LINES];
+    // Ignore the raises timestamped before
+    latency_since_ns.store(clock_now_ns());
+    latencies.store(latency_histograms);
+}
+
+int IrqController::get_latency(unsigned int irqn, LatencySnapshot *snapshot) {
+    if (irqn >= HWMOCK_IRQ_LINES)
+        return -EINVAL;
+    if (!latency_histograms)
+        return -ENODATA;
+
+    latency_histograms[irqn].snapshot(snapshot);
+    return 0;
+}
+
+void IrqController::reset_latencies() {
+    if (!latency_histograms)
+        return;
+
+    for (unsigned int irqn = 0; irqn < HWMOCK_IRQ_LINES; irqn++)
+        latency_histograms[irqn].reset();
+}
+
+void IrqController::record_latency(unsigned int irqn, uint64_t raise_ns) {
+    LatencyHistogram *histograms = latencies.load(memory_order_relaxed);
+
+    if (histograms && raise_ns >= latency_since_ns.load(memory_order_relaxed))
+        histograms[irqn].record(clock_now_ns() - raise_ns);
 }
 
 void IrqController::disableIrq(GenericIrq *irq) { irq->disable(); }
@@ -79,54 +253,356 @@ void IrqController::enableIrqs() {
 
     allirqs_enabled = true;
 
-    if (pending_irqs.size())
-        interrupt_self();
+    if (pending_levels.load())
+        interrupt();
+}
+
+/// Priority levels allowed to preempt a handler of priority running and not
+/// masked by basepri
+/// @return bitmask of the priority levels
+uint32_t IrqController::preemption_levels(uint32_t running) {
+    uint32_t grouping = priority_grouping.load(memory_order_relaxed);
+    uint32_t mask_priority = basepri.load(memory_order_relaxed);
+    // First priority of the running group
+    uint32_t limit = (running >> grouping) << grouping;
+
+    if (mask_priority)
+        limit = min(limit, (mask_priority >> grouping) << grouping);
+    return limit >= 32 ? UINT32_MAX : (1U << limit) - 1;
+}
+
+void IrqController::ring_doorbell() {
+    doorbell.fetch_add(1, memory_order_release);
+    if (doorbell_waiters.load())
+        futex_wake(&doorbell);
+}
+
+/// Rings the doorbell and, with the signal delivery, interrupts the controller thread
+void IrqController::interrupt() {
+    ring_doorbell();
+
+    if (delivery == Delivery::SIGNAL)
+        pthread_kill(pthread, HWMOCK_IRQ_SIGNUM);
+}
+
+/// Notifies the controller thread of a new pending line, unless the controller
+/// is polling. Switches to polling when notified more than poll_budget times
+/// within the poll interval.
+void IrqController::notify() {
+    if (!allirqs_enabled || polling.load(memory_order_relaxed))
+        return;
+
+    uint32_t budget = poll_budget.load(memory_order_relaxed);
+    if (budget) {
+        uint64_t now = clock_now_ns();
+        if (now - notify_window_ns.load(memory_order_relaxed) >
+            poll_interval_us.load(memory_order_relaxed) * 1000ULL) {
+            notify_window_ns.store(now, memory_order_relaxed);
+            notify_count.store(1, memory_order_relaxed);
+        } else if (notify_count.fetch_add(1, memory_order_relaxed) >= budget) {
+            polling.store(true);
+            wake_timer();
+            return;
+        }
+    }
+    interrupt();
+}
+
+/// Sets the line pending, the line bit is set before its level bit so that
+/// claim_pending() never misses it.
+/// @return true if the line was not pending yet
+bool IrqController::set_pending(unsigned int irqn, unsigned int priority) {
+    uint64_t mask = 1ULL << (irqn % 64);
+    bool newly_pending = !(pending[priority][irqn / 64].fetch_or(mask) & mask);
+    pending_levels.fetch_or(1U << priority);
+    return newly_pending;
+}
+
+void IrqController::deliver(unsigned int irqn) {
+    if (set_pending(irqn, lines[irqn].priority.load(memory_order_relaxed)))
+        notify();
 }
 
-void IrqController::interrupt_self() { pthread_kill(pthread, HWMOCK_IRQ_SIGNUM); }
+/// Claims the highest priority pending line
+/// @return the line number or -1 if nothing is pending
+/// @param  levels_mask priority levels to claim from
+int IrqController::claim_pending(uint32_t levels_mask) {
+    uint32_t levels;
+
+    while ((levels = pending_levels.load(memory_order_acquire) & levels_mask)) {
+        unsigned int level = __builtin_ctz(levels);
+
+        for (unsigned int word = 0; word < words; word++) {
+            uint64_t bits = pending[level][word].load(memory_order_acquire);
+            while (bits) {
+                uint64_t mask = 1ULL << __builtin_ctzll(bits);
+                if (pending[level][word].fetch_and(~mask, memory_order_acq_rel) & mask)
+                    return word * 64 + __builtin_ctzll(mask);
+                bits &= ~mask;
+            }
+        }
 
-void IrqController::interrupt_dest() {
+        // Level empty, clear it unless a line was raised meanwhile
+        pending_levels.fetch_and(~(1U << level), memory_order_acq_rel);
+        for (unsigned int word = 0; word < words; word++) {
+            if (pending[level][word].load(memory_order_acquire)) {
+                pending_levels.fetch_or(1U << level, memory_order_release);
+                break;
+            }
+        }
+    }
+    return -1;
+}
+
+/// Sets the irq line pending. A line already pending is not notified twice and
+/// a coalescing line waits for its max_events raises or its max_delay_us.
+void IrqController::raise(GenericIrq *irq) {
+    if (!irq->enabled() || irq->irq_line < 0)
+        return;
+
+    unsigned int irqn = irq->irq_line;
+    IrqLine &line = lines[irqn];
+
+    line.raised.fetch_add(1, memory_order_relaxed);
+    uint32_t batched = line.batched.fetch_add(1) + 1;
+    uint32_t max_events = line.max_events.load(memory_order_relaxed);
+    if (batched == 1 && (max_events > 1 || latencies.load(memory_order_relaxed)))
+        line.first_raise_ns.store(clock_now_ns());
+
+    if (max_events > 1 && batched < max_events) {
+        // The timer thread delivers the line after max_delay_us
+        if (batched == 1)
+            wake_timer();
+        return;
+    }
+
+    deliver(irqn);
+}
+
+/// Raise an irq on the destination Hw element
+void IrqController::local_raise(GenericIrq *irq) { raise(irq); }
+
+void IrqController::dest_raise(GenericIrq *irq) {
     if (!dest_controller) {
         std::stringstream reason;
-        reason << "interrupt_dest failed: No destination irq controller" << std::endl;
+        reason << "dest_raise failed: No destination irq controller" << std::endl;
         reason << get_stacktrace_str(64) << std::endl;
         throw new std::runtime_error(reason.str());
     }
-    pthread_kill(dest_controller->pthread, HWMOCK_IRQ_SIGNUM);
+    dest_controller->raise(irq);
 }
 
-/// Raise an irq on the destination Hw element
-void IrqController::local_raise(GenericIrq *irq) {
-    if (!irq->enabled())
-        return;
+/// Handle the pending irqs which preempt the running handler, if any
+/// @return int
+int IrqController::handle() {
+    uint32_t running = running_priority.load(memory_order_relaxed);
+    int rc = 0;
+    int irqn;
+    bool handled = false;
+
+    if (!allirqs_enabled)
+        return 0;
+
+    // Interrupted while claiming: the interrupted frame handles it once its
+    // line priority is running
+    if (claiming.load()) {
+        claim_preempted.store(true);
+        return 0;
+    }
+
+    for (;;) {
+        claiming.store(true);
+        irqn = claim_pending(preemption_levels(running));
+        if (irqn >= 0)
+            running_priority.store(lines[irqn].priority.load(memory_order_relaxed));
+        claiming.store(false);
+        if (irqn < 0) {
+            if (claim_preempted.exchange(false))
+                continue;
+            break;
+        }
 
-    pending_irqs.insert(irq);
-    interrupt_self();
+        // Preempted by a higher priority line before running this one
+        if (claim_preempted.exchange(false))
+            rc |= handle();
+
+        IrqLine &line = lines[irqn];
+        GenericIrq *irq = line.irq.load(memory_order_acquire);
+        uint64_t mask = 1ULL << (irqn % 64);
+
+        // Stored by the first raise, before the line was set pending
+        uint64_t raise_ns = line.first_raise_ns.load(memory_order_relaxed);
+        uint32_t events = line.batched.exchange(0);
+        // Set pending again by a raise the previous run already took: that
+        // run started after the raise, nothing is left to handle
+        if (!events) {
+            running_priority.store(running);
+            continue;
+        }
+        line.delivered.fetch_add(1, memory_order_relaxed);
+        if (events > 1)
+            line.merged.fetch_add(events - 1, memory_order_relaxed);
+        if (polling.load(memory_order_relaxed))
+            line.polled.fetch_add(1, memory_order_relaxed);
+
+        active[irqn / 64].fetch_or(mask);
+        handled = true;
+        // The line stays active until its bottom half ran
+        Workqueue *workqueue = this->workqueue.load(memory_order_relaxed);
+        if (workqueue && line.bottom_half.load(memory_order_relaxed)) {
+            line.handled_raise_ns.store(raise_ns, memory_order_relaxed);
+            workqueue->queue(&line.work);
+        } else {
+            record_latency(irqn, raise_ns);
+            if (irq)
+                rc |= irq->handle();
+            active[irqn / 64].fetch_and(~mask);
+        }
+        running_priority.store(running);
+    }
+
+    // Let wait() return for the irqs handled in the signal handler
+    if (handled)
+        doorbell.fetch_add(1, memory_order_release);
+    return rc;
 }
 
-void IrqController::dest_raise(GenericIrq *irq) {
-    if (!irq->enabled())
+void IrqController::check_point() {
+    if (delivery != Delivery::DOORBELL || !pthread_equal(pthread, pthread_self()))
         return;
 
-    dest_controller->pending_irqs.insert(irq);
-    interrupt_dest();
+    if (pending_levels.load(memory_order_relaxed) &
+        preemption_levels(running_priority.load(memory_order_relaxed)))
+        handle();
 }
 
-/// Handle a new irq or the pending irqs
-/// @return int
-int IrqController::handle() {
-    int rc;
-    // no priority, simply handle the pending one by one
+int IrqController::wait(int timeout_us) {
+    struct timespec ts;
+    const struct timespec *deadline = futex_deadline(timeout_us, &ts);
+    uint32_t seq = doorbell_seen;
+    int rc = 0;
 
-    for (GenericIrq *irq : pending_irqs) {
-        rc |= irq->handle();
+    doorbell_waiters.fetch_add(1);
+    while (!(pending_levels.load() & preemption_levels(running_priority.load())) &&
+           doorbell.load(memory_order_acquire) == seq) {
+        if (futex_wait(&doorbell, seq, deadline) == -ETIMEDOUT) {
+            rc = -ETIMEDOUT;
+            break;
+        }
     }
+    doorbell_waiters.fetch_sub(1);
+
+    // With the signal delivery, the raising thread may not have signaled the
+    // line it set pending yet: handle it rather than returning to a caller
+    // which would wait again and spin until the signal comes
+    if (delivery == Delivery::SIGNAL && pthread_equal(pthread, pthread_self()) &&
+        (pending_levels.load() & preemption_levels(running_priority.load())))
+        handle();
+    check_point();
+    doorbell_seen = doorbell.load(memory_order_acquire);
     return rc;
 }
 
+void IrqController::run_bottom_half(void *ctx, unsigned int irqn) {
+    IrqController *controller = (IrqController *)ctx;
+    GenericIrq *irq = controller->lines[irqn].irq.load(memory_order_acquire);
+
+    controller->record_latency(irqn,
+                               controller->lines[irqn].handled_raise_ns.load(memory_order_relaxed));
+
+    if (irq)
+        irq->handle();
+    controller->active[irqn / 64].fetch_and(~(1ULL << (irqn % 64)));
+    // Let wait() return once the handler ran
+    controller->ring_doorbell();
+}
+
+void IrqController::wake_timer() {
+    timer_kick.fetch_add(1);
+    futex_wake(&timer_kick);
+}
+
+void IrqController::start_timer() {
+    bool expected = false;
+    if (!timer_started.compare_exchange_strong(expected, true))
+        return;
+
+    int rc = pthread_create(&timer_pthread, NULL, irq_timer_thread_fn, this);
+    if (rc) {
+        timer_started.store(false);
+        stringstream reason;
+        reason << "pthread_create(irq timer) failed with " << strerror(rc) << endl
+               << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+    pthread_setname_np(timer_pthread, "irqtimer");
+}
+
+/// Delivers the coalesced lines which reached their delay and polls the
+/// pending lines when polling
+/// @return the time of the next timer event, UINT64_MAX if none
+uint64_t IrqController::run_timer(uint64_t now_ns, uint64_t &next_poll_ns) {
+    uint64_t next_ns = UINT64_MAX;
+
+    for (unsigned int word = 0; word < words; word++) {
+        uint64_t bits = coalesced[word].load();
+        while (bits) {
+            unsigned int irqn = word * 64 + __builtin_ctzll(bits);
+            IrqLine &line = lines[irqn];
+            bits &= bits - 1;
+
+            if (!line.batched.load())
+                continue;
+            uint64_t due_ns = line.first_raise_ns.load() + line.max_delay_us.load() * 1000ULL;
+            if (due_ns <= now_ns)
+                deliver(irqn);
+            else if (due_ns < next_ns)
+                next_ns = due_ns;
+        }
+    }
+
+    if (!polling.load()) {
+        next_poll_ns = 0;
+        return next_ns;
+    }
+
+    uint64_t interval_ns = poll_interval_us.load() * 1000ULL;
+    if (!next_poll_ns) {
+        next_poll_ns = now_ns + interval_ns;
+    } else if (next_poll_ns <= now_ns) {
+        if (pending_levels.load() & preemption_levels(HWMOCK_IRQ_PRIORITIES)) {
+            // One notification per poll interval whatever the raise rate
+            if (allirqs_enabled)
+                interrupt();
+        } else {
+            // Nothing raised during the whole interval, back to interrupts
+            notify_window_ns.store(now_ns);
+            notify_count.store(0);
+            polling.store(false);
+            if (pending_levels.load() && allirqs_enabled)
+                interrupt();
+        }
+        next_poll_ns = now_ns + interval_ns;
+    }
+    return min(next_ns, next_poll_ns);
+}
+
+void *HWMocker::irq_timer_thread_fn(void *data) {
+    IrqController *controller = (IrqController *)data;
+    uint64_t next_poll_ns = 0;
+    struct timespec ts;
+
+    while (!controller->timer_stopped.load()) {
+        uint32_t kick = controller->timer_kick.load();
+        uint64_t next_ns = controller->run_timer(clock_now_ns(), next_poll_ns);
+        futex_wait(&controller->timer_kick, kick,
+                   next_ns == UINT64_MAX ? nullptr : clock_timespec(next_ns, &ts));
+    }
+    return NULL;
+}
+
 void signal_handler([[maybe_unused]] int signo, [[maybe_unused]] siginfo_t *info,
                     [[maybe_unused]] void *extra) {
-
-    IrqController *controller = signal_handlers_map[pthread_self()];
-    controller->handle();
-}
\ No newline at end of file
+    if (local_irq_controller)
+        local_irq_controller->handle();
+}
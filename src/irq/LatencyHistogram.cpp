@@ -0,0 +1,58 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+
+using namespace HWMocker;
+using namespace std;
+
+void LatencyHistogram::reset() {
+    for (atomic<uint64_t> &count : counts)
+        count.store(0, memory_order_relaxed);
+    total_count.store(0, memory_order_relaxed);
+    total_ns.store(0, memory_order_relaxed);
+    min_ns.store(UINT64_MAX, memory_order_relaxed);
+    max_ns.store(0, memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::bucket_value(unsigned int index) {
+    if (index < sub_buckets)
+        return index;
+
+    unsigned int magnitude = index / sub_buckets + sub_bits - 1;
+    uint64_t lowest = (uint64_t)(sub_buckets + index % sub_buckets) << (magnitude - sub_bits);
+    return lowest + (1ULL << (magnitude - sub_bits)) - 1;
+}
+
+/// Concurrent records may be missing from the snapshot, or only partly in it
+void LatencyHistogram::snapshot(LatencySnapshot *snapshot) {
+    static const unsigned int per_mille[] = {500, 900, 990, 999};
+    uint64_t *percentiles[] = {&snapshot->p50_ns, &snapshot->p90_ns, &snapshot->p99_ns,
+                               &snapshot->p999_ns};
+    uint64_t copy[buckets];
+    uint64_t count = 0;
+
+    for (unsigned int index = 0; index < buckets; index++) {
+        copy[index] = counts[index].load(memory_order_relaxed);
+        count += copy[index];
+    }
+
+    *snapshot = {};
+    snapshot->count = count;
+    if (!count)
+        return;
+
+    snapshot->min_ns = min_ns.load(memory_order_relaxed);
+    snapshot->max_ns = max_ns.load(memory_order_relaxed);
+    snapshot->mean_ns = total_ns.load(memory_order_relaxed) / max(total_count.load(), (uint64_t)1);
+
+    uint64_t seen = 0;
+    unsigned int percentile = 0;
+    for (unsigned int index = 0; index < buckets && percentile < 4; index++) {
+        seen += copy[index];
+        while (percentile < 4 && seen * 1000 >= count * per_mille[percentile]) {
+            // Bucket precision, within the recorded range
+            *percentiles[percentile] = min(bucket_value(index), snapshot->max_ns);
+            percentile++;
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#include "Workqueue.hpp"
+#include "Futex.hpp"
+#include <hwmocker_internal.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace HWMocker;
+using namespace std;
+
+string get_stacktrace_str(unsigned int max_frames);
+
+// Constructors/Destructors
+
+Workqueue::~Workqueue() {
+    if (softirq_started.load()) {
+        softirq_stopped.store(true);
+        wake_softirq();
+        pthread_join(softirq_pthread, NULL);
+    }
+}
+
+Workqueue::Context Workqueue::context_from_string(const string &name) {
+    if (name == "softirq")
+        return Context::SOFTIRQ;
+    if (name == "processing-unit")
+        return Context::PROCESSING_UNIT;
+
+    stringstream reason;
+    reason << "Unknown bottom half context " << name << endl << get_stacktrace_str(64) << endl;
+    throw new runtime_error(reason.str());
+}
+
+void Workqueue::start_softirq() {
+    bool expected = false;
+    if (context != Context::SOFTIRQ || !softirq_started.compare_exchange_strong(expected, true))
+        return;
+
+    int rc = pthread_create(&softirq_pthread, NULL, softirq_thread_fn, this);
+    if (rc) {
+        softirq_started.store(false);
+        stringstream reason;
+        reason << "pthread_create(softirq) failed with " << strerror(rc) << endl
+               << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+    pthread_setname_np(softirq_pthread, "softirq");
+}
+
+void Workqueue::wake_softirq() {
+    softirq_kick.fetch_add(1);
+    futex_wake(&softirq_kick);
+}
+
+bool Workqueue::queue(Work *work) {
+    if (work->queued.exchange(true))
+        return false;
+
+    Work *next = head.load(memory_order_relaxed);
+    do {
+        work->next = next;
+    } while (!head.compare_exchange_weak(next, work, memory_order_release,
+                                         memory_order_relaxed));
+
+    if (context == Context::SOFTIRQ)
+        wake_softirq();
+    return true;
+}
+
+unsigned int Workqueue::drain() {
+    unsigned int count = 0;
+    Work *works;
+
+    while ((works = head.exchange(nullptr, memory_order_acquire))) {
+        // Reverse the list to run the works in their queueing order
+        Work *ordered = nullptr;
+        while (works) {
+            Work *next = works->next;
+            works->next = ordered;
+            ordered = works;
+            works = next;
+        }
+
+        while (ordered) {
+            Work *work = ordered;
+            ordered = work->next;
+            // Cleared first: a work queued again while it runs runs again
+            work->queued.store(false);
+            work->func(work->ctx, work->arg);
+            count++;
+        }
+    }
+    return count;
+}
+
+void Workqueue::check_point() {
+    if (context != Context::PROCESSING_UNIT || !pthread_equal(owner, pthread_self()))
+        return;
+
+    if (head.load(memory_order_relaxed))
+        drain();
+}
+
+void *HWMocker::softirq_thread_fn(void *data) {
+    Workqueue *workqueue = (Workqueue *)data;
+
+    while (!workqueue->softirq_stopped.load()) {
+        uint32_t kick = workqueue->softirq_kick.load();
+        workqueue->drain();
+        futex_wait(&workqueue->softirq_kick, kick);
+    }
+    return NULL;
+}
@@ -23,143 +23,257 @@
 #include <hwmocker/irq.h>
 #include <hwmocker_internal.h>
 
-#include <list>
-#include <map>
+#include <atomic>
+#include <new>
 
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
-#include <stdlib.h>
-
-#define SIGNUM_BASE (SIGRTMIN + 3)
 
 using namespace std;
 
-list<struct hwmocker_irq_desc *> pending_descs;
-pthread_mutex_t pending_descs_mutex;
-#define APPEND_PENDING_DESC(d)                                                                    \
-    ({                                                                                            \
-        int rc;                                                                                   \
-        rc = pthread_mutex_lock(&pending_descs_mutex);                                            \
-        if (!rc) {                                                                                \
-            pending_descs.push_back(d);                                                           \
-            rc = pthread_mutex_unlock(&pending_descs_mutex);                                      \
-        }                                                                                         \
-        rc;                                                                                       \
-    })
-#define GET_PENDING_DESC()                                                                        \
-    ({                                                                                            \
-        int rc;                                                                                   \
-        struct hwmocker_irq_desc *desc = NULL;                                                    \
-        rc = pthread_mutex_lock(&pending_descs_mutex);                                            \
-        if (!rc) {                                                                                \
-            desc = pending_descs.front();                                                         \
-            pending_descs.pop_front();                                                            \
-            rc = pthread_mutex_unlock(&pending_descs_mutex);                                      \
-        }                                                                                         \
-        desc;                                                                                     \
-    })
+/*
+ * The irq handlers share HWMOCK_IRQ_CHANNELS realtime signals, following the
+ * irq controller one. The slot of the triggered handler travels in the signal
+ * value so the signal handler finds it in one load, and a handler has at most
+ * one signal queued at a time whatever the number of its irqs triggered
+ * meanwhile.
+ */
+#define CHANNEL_SIGNUM(channel) (HWMOCK_IRQ_SIGNUM + 1 + (channel))
+#define MAX_SHARED_HANDLERS 8
+#define MAX_IRQ_HANDLERS 64
 
 struct irq_handler_data {
+    atomic<irq_handler_t> handler;
     void *data;
     enum hwmocker_irq_type irq_type;
-    irq_handler_t handler;
 };
 
 struct hwmocker_irq_desc {
-    list<struct irq_handler_data *> handlers_data;
+    struct irq_handler_data handlers_data[MAX_SHARED_HANDLERS];
     struct hwmocker_irq_handler *irqh;
     int irq_number;
     bool is_exclusive;
-    bool masked;
+    atomic<bool> masked;
+    /* line level and number of writes of an active level */
+    atomic<bool> level;
+    atomic<unsigned int> asserted;
+    /* enum hwmocker_irq_type events to handle */
+    atomic<int> events;
+    /* queued in the pending ring of irqh */
+    atomic<bool> queued;
+    /* triggered while masked */
+    atomic<bool> postponed;
+};
+
+/*
+ * Bounded multi producers, single consumer ring. A desc is queued at most once
+ * so the ring never holds more than HWMOCK_IRQ_LINES entries.
+ */
+struct pending_ring {
+    atomic<struct hwmocker_irq_desc *> slots[HWMOCK_IRQ_LINES];
+    atomic<unsigned int> tail;
+    unsigned int head;
 };
 
 struct hwmocker_irq_handler {
-    map<int, struct hwmocker_irq_desc *> irq_descs;
+    struct hwmocker_irq_desc *irq_descs[HWMOCK_IRQ_LINES];
+    struct pending_ring pending;
     pthread_t dest_thread;
     int signum;
+    /* slot and generation carried by its signals */
+    unsigned int cookie;
+    /* a signal is queued for this handler */
+    atomic<bool> signaled;
+};
+
+/*
+ * Live handlers. A signal carries the slot and the generation of its handler
+ * rather than its address: a signal still queued when its handler is
+ * destroyed finds another generation, or no handler, and is ignored.
+ */
+struct handler_slot {
+    atomic<struct hwmocker_irq_handler *> irqh;
+    unsigned int generation;
+    /* signal handlers running on irqh */
+    atomic<unsigned int> handling;
 };
 
-void handler(int signo, siginfo_t *info, void *extra) {
-    list<struct irq_handler_data *>::iterator it;
-    struct irq_handler_data *data = NULL;
-    list<struct hwmocker_irq_desc *> postponed_descs;
+static struct handler_slot handler_slots[MAX_IRQ_HANDLERS];
+static pthread_mutex_t handler_slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic<unsigned int> next_channel;
+static pthread_once_t channels_once = PTHREAD_ONCE_INIT;
+static int channels_rc;
+
+static void pending_push(struct pending_ring *ring, struct hwmocker_irq_desc *desc) {
+    unsigned int slot = ring->tail.fetch_add(1) % HWMOCK_IRQ_LINES;
+    ring->slots[slot].store(desc, memory_order_release);
+}
+
+/* Returns NULL when empty or when the next producer did not publish its desc yet */
+static struct hwmocker_irq_desc *pending_pop(struct pending_ring *ring) {
+    unsigned int slot = ring->head % HWMOCK_IRQ_LINES;
+    struct hwmocker_irq_desc *desc = ring->slots[slot].exchange(NULL, memory_order_acquire);
+    if (desc)
+        ring->head++;
+    return desc;
+}
+
+/* Mask of the irq types handled on desc */
+static int desc_types(struct hwmocker_irq_desc *desc) {
+    int types = 0;
+    for (struct irq_handler_data &data : desc->handlers_data)
+        if (data.handler.load(memory_order_acquire))
+            types |= data.irq_type;
+    return types;
+}
+
+/* Level event of an active level, 0 if level is not active */
+static int level_event(int types, bool level) {
+    if (level && (types & HWMOCKER_IRQ_HIGH_LEVEL))
+        return HWMOCKER_IRQ_HIGH_LEVEL;
+    if (!level && (types & HWMOCKER_IRQ_LOW_LEVEL))
+        return HWMOCKER_IRQ_LOW_LEVEL;
+    return 0;
+}
+
+static int queue_desc(struct hwmocker_irq_desc *desc);
+
+/*
+ * Leaves desc postponed and returns true while it is masked. masked is loaded
+ * again once postponed is set: an unmask in between found postponed still
+ * clear, so the irq runs here unless the unmask took postponed back first.
+ */
+static bool postpone_masked(struct hwmocker_irq_desc *desc) {
+    if (!desc->masked.load())
+        return false;
+
+    desc->postponed.store(true);
+    return desc->masked.load() || !desc->postponed.exchange(false);
+}
+
+static void handle_desc(struct hwmocker_irq_desc *desc) {
+    unsigned int asserted_before = desc->asserted.load();
+    int events = desc->events.exchange(0);
+
+    for (struct irq_handler_data &data : desc->handlers_data) {
+        irq_handler_t handler = data.handler.load(memory_order_acquire);
+        if (handler && (data.irq_type & events))
+            handler(desc->irq_number, data.data);
+    }
+
+    /* EOI: re-assert a level written active while it was handled */
+    int event = level_event(desc_types(desc), desc->level.load());
+    if (event && desc->asserted.load() != asserted_before) {
+        desc->events.fetch_or(event);
+        queue_desc(desc);
+    }
+}
+
+static void drain_pending(struct hwmocker_irq_handler *irqh) {
     struct hwmocker_irq_desc *desc;
 
-    while ((desc = GET_PENDING_DESC()) != NULL) {
-        if (desc->masked) {
-            postponed_descs.push_back(desc);
+    /* Cleared first: a desc queued after the drain signals again */
+    irqh->signaled.store(false);
+    while ((desc = pending_pop(&irqh->pending)) != NULL) {
+        desc->queued.store(false);
+        if (postpone_masked(desc))
             continue;
-        }
-        for (it = desc->handlers_data.begin(); it != desc->handlers_data.end(); it++) {
-            data = *it;
-            if (data->irq_type == HWMOCKER_IRQ_RISING_EDGE ||
-                data->irq_type == HWMOCKER_IRQ_HIGH_LEVEL)
-                data->handler(desc->irq_number, data->data);
-        }
-    }
-    while (!postponed_descs.empty()) {
-        desc = postponed_descs.front();
-        postponed_descs.pop_front();
-        APPEND_PENDING_DESC(desc);
+        handle_desc(desc);
     }
 }
 
-static int hwmocker_irq_handler_register_sig_handlers(struct hwmocker_irq_handler *irqh) {
-    struct sigaction action;
-    static int signum = SIGNUM_BASE;
-    int rc;
+static void handler([[maybe_unused]] int signo, siginfo_t *info, [[maybe_unused]] void *extra) {
+    if (info->si_code != SI_QUEUE)
+        return;
+
+    unsigned int cookie = (unsigned int)info->si_value.sival_int;
+    struct handler_slot *slot = &handler_slots[cookie % MAX_IRQ_HANDLERS];
+
+    /* Counted before the lookup: destroy either unpublished it first or waits for us */
+    slot->handling.fetch_add(1);
+    struct hwmocker_irq_handler *irqh = slot->irqh.load();
+    if (irqh && irqh->cookie == cookie)
+        drain_pending(irqh);
+    slot->handling.fetch_sub(1);
+}
+
+static void register_sig_handlers() {
+    struct sigaction action = {};
 
     action.sa_flags = SA_SIGINFO;
     action.sa_sigaction = handler;
+    sigemptyset(&action.sa_mask);
 
-    rc = sigaction(signum++, &action, NULL);
-    return rc;
-}
+    if (CHANNEL_SIGNUM(HWMOCK_IRQ_CHANNELS - 1) > SIGRTMAX) {
+        channels_rc = -ERANGE;
+        return;
+    }
 
-#include <cstdio>
+    for (int channel = 0; channel < HWMOCK_IRQ_CHANNELS; channel++) {
+        if (sigaction(CHANNEL_SIGNUM(channel), &action, NULL)) {
+            channels_rc = -errno;
+            return;
+        }
+    }
+}
 
 struct hwmocker_irq_handler *hwmocker_irq_handler_create(struct hwmocker *mocker, int is_device) {
-    int rc;
-    struct hwmocker_irq_handler *irqh =
-        (struct hwmocker_irq_handler *)calloc(1, sizeof(struct hwmocker_irq_handler));
+    pthread_once(&channels_once, register_sig_handlers);
+    if (channels_rc)
+        return NULL;
+
+    struct hwmocker_irq_handler *irqh = new (nothrow) hwmocker_irq_handler();
     if (!irqh)
         return irqh;
 
-    new (&irqh->irq_descs) map<int, struct hwmocker_irq_desc *>;
+    ProcessingUnit *processing_unit =
+        is_device ? mocker->system->get_soc() : mocker->system->get_host();
+    irqh->dest_thread = processing_unit->get_pthread();
+    irqh->signum = CHANNEL_SIGNUM(next_channel.fetch_add(1) % HWMOCK_IRQ_CHANNELS);
 
-    rc = hwmocker_irq_handler_register_sig_handlers(irqh);
-    if (rc) {
-        free(irqh);
-        irqh = NULL;
-    } else {
-        irqh->dest_thread = is_device ? mocker->device_thread : mocker->host_thread;
+    pthread_mutex_lock(&handler_slots_lock);
+    for (unsigned int idx = 0; idx < MAX_IRQ_HANDLERS; idx++) {
+        struct handler_slot *slot = &handler_slots[idx];
+        if (slot->irqh.load())
+            continue;
+
+        slot->generation++;
+        irqh->cookie = slot->generation * MAX_IRQ_HANDLERS + idx;
+        slot->irqh.store(irqh);
+        pthread_mutex_unlock(&handler_slots_lock);
+        return irqh;
     }
-    return irqh;
+    pthread_mutex_unlock(&handler_slots_lock);
+
+    delete irqh;
+    return NULL;
 }
 
 void hwmocker_irq_handler_destroy(struct hwmocker_irq_handler *irqh) {
-    map<int, struct hwmocker_irq_desc *>::iterator it;
-    for (it = irqh->irq_descs.begin(); it != irqh->irq_descs.end(); ++it) {
-        struct hwmocker_irq_desc *desc = it->second;
-        while (desc->handlers_data.empty()) {
-            struct irq_handler_data *data = desc->handlers_data.back();
-            desc->handlers_data.pop_back();
-            free(data);
-        }
-        desc->handlers_data.clear();
-        free(desc);
-    }
-    irqh->irq_descs.clear();
-    free(irqh);
+    struct handler_slot *slot = &handler_slots[irqh->cookie % MAX_IRQ_HANDLERS];
+
+    /* The signals still queued for it are ignored from now on */
+    pthread_mutex_lock(&handler_slots_lock);
+    slot->irqh.store(NULL);
+    while (slot->handling.load())
+        sched_yield();
+    pthread_mutex_unlock(&handler_slots_lock);
+
+    for (struct hwmocker_irq_desc *desc : irqh->irq_descs)
+        delete desc;
+    delete irqh;
 }
 
 int hwmocker_irq_handler_declare_irq(struct hwmocker_irq_handler *irqh, int irq_number) {
-    if (irqh->irq_descs.count(irq_number))
+    if (irq_number < 0 || irq_number >= HWMOCK_IRQ_LINES)
+        return -EINVAL;
+
+    if (irqh->irq_descs[irq_number])
         return -EEXIST;
 
-    struct hwmocker_irq_desc *desc =
-        (struct hwmocker_irq_desc *)calloc(1, sizeof(struct hwmocker_irq_desc));
+    struct hwmocker_irq_desc *desc = new (nothrow) hwmocker_irq_desc();
     if (!desc)
         return -ENOMEM;
 
@@ -172,67 +286,120 @@ int hwmocker_irq_handler_declare_irq(struct hwmocker_irq_handler *irqh, int irq_
 int hwmocker_irq_handler_register_handler(struct hwmocker_irq_handler *irqh, int irq_number,
                                           irq_handler_t handler, void *irq_data,
                                           enum hwmocker_irq_type irq_type, int is_exclusive) {
-    struct irq_handler_data *data;
-    struct hwmocker_irq_desc *desc;
+    struct hwmocker_irq_desc *desc = hwmocker_irq_handler_get_irq_desc(irqh, irq_number);
+    struct irq_handler_data *free_data = NULL;
+    bool has_handlers = false;
 
-    if (!irqh->irq_descs.count(irq_number))
+    if (!desc)
         return -ENOENT;
 
-    desc = irqh->irq_descs[irq_number];
-    if (is_exclusive && !desc->handlers_data.empty())
-        return -EINVAL;
+    for (struct irq_handler_data &data : desc->handlers_data) {
+        if (data.handler.load())
+            has_handlers = true;
+        else if (!free_data)
+            free_data = &data;
+    }
 
-    if (desc->is_exclusive)
+    if (desc->is_exclusive || (is_exclusive && has_handlers))
         return -EINVAL;
 
-    data = (struct irq_handler_data *)malloc(sizeof(struct irq_handler_data));
-    if (!data)
-        return -ENOMEM;
+    if (!free_data)
+        return -ENOSPC;
 
     desc->is_exclusive = is_exclusive;
-    data->irq_type = irq_type;
-    desc->handlers_data.push_back(data);
+    free_data->data = irq_data;
+    free_data->irq_type = irq_type;
+    free_data->handler.store(handler, memory_order_release);
     return 0;
 }
 
 int hwmocker_irq_handler_unregister_handler(struct hwmocker_irq_handler *irqh, int irq_number,
                                             irq_handler_t handler) {
-    list<struct irq_handler_data *>::iterator it;
-    struct irq_handler_data *data = NULL;
-    struct hwmocker_irq_desc *desc;
+    struct hwmocker_irq_desc *desc = hwmocker_irq_handler_get_irq_desc(irqh, irq_number);
+    bool has_handlers = false;
+    int rc = -ENOENT;
 
-    if (!irqh->irq_descs.count(irq_number))
+    if (!desc)
         return -ENOENT;
 
-    desc = irqh->irq_descs[irq_number];
-    if (!desc->handlers_data.empty())
-        return -EINVAL;
-
-    for (it = desc->handlers_data.begin(); it != desc->handlers_data.end(); it++)
-        if ((*it)->handler == handler)
-            data = *it;
-
-    if (!data)
-        return -ENOENT;
+    for (struct irq_handler_data &data : desc->handlers_data) {
+        irq_handler_t expected = handler;
+        if (rc && data.handler.compare_exchange_strong(expected, NULL))
+            rc = 0;
+        else if (data.handler.load())
+            has_handlers = true;
+    }
 
-    desc->handlers_data.remove(data);
-    return 0;
+    if (!has_handlers)
+        desc->is_exclusive = false;
+    return rc;
 }
 
 struct hwmocker_irq_desc *hwmocker_irq_handler_get_irq_desc(struct hwmocker_irq_handler *irqh,
                                                             int irq_number) {
-    if (!irqh->irq_descs.count(irq_number))
+    if (irq_number < 0 || irq_number >= HWMOCK_IRQ_LINES)
         return NULL;
 
     return irqh->irq_descs[irq_number];
 }
 
+static int queue_desc(struct hwmocker_irq_desc *desc) {
+    struct hwmocker_irq_handler *irqh = desc->irqh;
+    union sigval value;
+
+    if (postpone_masked(desc))
+        return 0;
+
+    if (desc->queued.exchange(true))
+        return 0;
+
+    pending_push(&irqh->pending, desc);
+    if (irqh->signaled.exchange(true))
+        return 0;
+
+    value.sival_int = (int)irqh->cookie;
+    return pthread_sigqueue(irqh->dest_thread, irqh->signum, value);
+}
+
 int hwmocker_irq_handler_trigger_irq(struct hwmocker_irq_desc *desc) {
+    desc->events.fetch_or(HWMOCKER_IRQ_RISING_EDGE | HWMOCKER_IRQ_HIGH_LEVEL);
+    return queue_desc(desc);
+}
 
-    int rc = 0;
+int hwmocker_irq_handler_set_irq_level(struct hwmocker_irq_desc *desc, int level) {
+    bool previous = desc->level.exchange(level);
+    int types = desc_types(desc);
+    int events = 0;
+
+    if (!previous && level)
+        events |= HWMOCKER_IRQ_RISING_EDGE;
+    else if (previous && !level)
+        events |= HWMOCKER_IRQ_FALLING_EDGE;
+
+    /* A held level is only signaled once */
+    int event = level_event(types, level);
+    if (event) {
+        desc->asserted.fetch_add(1);
+        if (!level_event(types, previous))
+            events |= event;
+    }
 
-    rc = APPEND_PENDING_DESC(desc);
-    if (!rc && !desc->masked)
-        rc = pthread_kill(desc->irqh->dest_thread, desc->irqh->signum);
-    return rc;
+    events &= types;
+    if (!events)
+        return 0;
+
+    desc->events.fetch_or(events);
+    return queue_desc(desc);
+}
+
+int hwmocker_irq_handler_mask_irq(struct hwmocker_irq_desc *desc) {
+    desc->masked.store(true);
+    return 0;
+}
+
+int hwmocker_irq_handler_unmask_irq(struct hwmocker_irq_desc *desc) {
+    desc->masked.store(false);
+    if (desc->postponed.exchange(false))
+        return queue_desc(desc);
+    return 0;
 }
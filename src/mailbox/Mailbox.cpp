@@ -0,0 +1,174 @@
+#include "Mailbox.hpp"
+
+#include <hwmocker_internal.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <errno.h>
+
+using namespace std;
+using namespace HWMocker;
+
+// Constructors/Destructors
+Mailbox::Mailbox(IrqController *host_irq_controller, IrqController *soc_irq_controller) {
+    host.rx = &host_rx;
+    host.peer = &soc;
+    host.irq_controller = host_irq_controller;
+    soc.rx = &soc_rx;
+    soc.peer = &host;
+    soc.irq_controller = soc_irq_controller;
+
+    for (Endpoint *endpoint : {&host, &soc}) {
+        endpoint->irq = new HwIrq();
+        endpoint->irq->set_handler(Endpoint::irq_handler, endpoint);
+    }
+}
+
+Mailbox::~Mailbox() {
+    for (Endpoint *endpoint : {&host, &soc}) {
+        if (endpoint->has_irq && endpoint->irq_controller)
+            endpoint->irq_controller->unregister_irq(endpoint->irq);
+        delete endpoint->irq;
+    }
+}
+
+int Mailbox::load_config(json config) {
+    mailbox_index = config["index"];
+
+    size_t ring_size = config.value("ring-size", 1 << 20);
+    if (!ring_size || (ring_size & (ring_size - 1))) {
+        stringstream reason;
+        reason << "mailbox ring-size " << ring_size << " is not a power of 2" << endl
+               << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+    host_rx.resize(ring_size);
+    soc_rx.resize(ring_size);
+
+    int rc = load_endpoint_irq(&host, config, "host-irq");
+    if (rc)
+        return rc;
+    return load_endpoint_irq(&soc, config, "soc-irq");
+}
+
+int Mailbox::load_endpoint_irq(Endpoint *endpoint, json config, const char *name) {
+    if (!config.contains(name))
+        return 0;
+
+    endpoint->irq->set_irqn(config[name]);
+    endpoint->has_irq = true;
+    if (endpoint->irq_controller)
+        return endpoint->irq_controller->register_irq(endpoint->irq, config[name]);
+    return 0;
+}
+
+ssize_t Mailbox::Endpoint::write(const void *buf, size_t size) {
+    size_t written = peer->rx->write(buf, size);
+    stats_tx_bytes.fetch_add(written, memory_order_relaxed);
+    peer->stats_rx_bytes.fetch_add(written, memory_order_relaxed);
+
+    if (written < size) {
+        tx_waiting.store(true);
+        // The peer may have read meanwhile, before seeing the flag
+        atomic_thread_fence(memory_order_seq_cst);
+        if (peer->rx->level() < peer->rx->capacity() && tx_waiting.exchange(false))
+            raise(HWMOCKER_MAILBOX_IRQ_TX);
+    }
+    if (!written)
+        return 0;
+
+    // Pairs with the fence of the peer handler once it cleared draining
+    atomic_thread_fence(memory_order_seq_cst);
+    if (peer->draining.load(memory_order_relaxed)) {
+        stats_suppressed.fetch_add(1, memory_order_relaxed);
+    } else {
+        stats_doorbells.fetch_add(1, memory_order_relaxed);
+        peer->raise(HWMOCKER_MAILBOX_IRQ_RX);
+    }
+    return written;
+}
+
+ssize_t Mailbox::Endpoint::read(void *buf, size_t size) {
+    size_t count = rx->read(buf, size);
+    if (count)
+        consumed();
+    return count;
+}
+
+size_t Mailbox::Endpoint::consume(size_t size) {
+    size_t count = rx->consume(size);
+    if (count)
+        consumed();
+    return count;
+}
+
+/// Tells the peer blocked on a full ring that there is space
+void Mailbox::Endpoint::consumed() {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (peer->tx_waiting.load(memory_order_relaxed) && peer->tx_waiting.exchange(false))
+        peer->raise(HWMOCKER_MAILBOX_IRQ_TX);
+}
+
+int Mailbox::Endpoint::set_irq_handler(unsigned int irq_mask,
+                                       int (*handler)(unsigned int status, void *ctx),
+                                       void *ctx) {
+    if (!has_irq)
+        return -ENOENT;
+
+    this->handler_ctx = ctx;
+    this->handler = handler;
+    this->irq_mask.store(irq_mask);
+    if (handler && irq_mask)
+        irq->enable();
+    else
+        irq->disable();
+    // The ring may hold bytes already
+    if (rx->level())
+        raise(HWMOCKER_MAILBOX_IRQ_RX);
+    return 0;
+}
+
+void Mailbox::Endpoint::raise(unsigned int events) {
+    events &= irq_mask.load(memory_order_relaxed);
+    if (events && irq_controller) {
+        irq_status.fetch_or(events);
+        irq_controller->local_raise(irq);
+    }
+}
+
+int Mailbox::Endpoint::irq_handler(void *ctx) {
+    Endpoint *endpoint = (Endpoint *)ctx;
+    unsigned int status = endpoint->irq_status.exchange(0);
+    if (!status || !endpoint->handler)
+        return 0;
+
+    // The writes seen by the handler do not ring the doorbell
+    endpoint->draining.store(true);
+    atomic_thread_fence(memory_order_seq_cst);
+    size_t produced = endpoint->rx->produced();
+
+    int rc = endpoint->handler(status, endpoint->handler_ctx);
+
+    endpoint->draining.store(false);
+    atomic_thread_fence(memory_order_seq_cst);
+    // Written while draining, maybe after the handler looked
+    if (endpoint->rx->produced() != produced)
+        endpoint->raise(HWMOCKER_MAILBOX_IRQ_RX);
+    return rc;
+}
+
+void Mailbox::Endpoint::get_stats(struct hwmocker_mailbox_stats *stats) {
+    stats->tx_bytes = stats_tx_bytes.load();
+    stats->rx_bytes = stats_rx_bytes.load();
+    stats->doorbells = stats_doorbells.load();
+    stats->suppressed = stats_suppressed.load();
+}
+
+void Mailbox::Endpoint::reset_stats() {
+    stats_tx_bytes.store(0);
+    stats_rx_bytes.store(0);
+    stats_doorbells.store(0);
+    stats_suppressed.store(0);
+}
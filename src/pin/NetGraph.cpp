@@ -0,0 +1,105 @@
+#include "NetGraph.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include <errno.h>
+
+using namespace HWMocker;
+using namespace std;
+
+// Methods
+int NetGraph::add_net(const string &name, const vector<Pin *> &drivers,
+                      const vector<Pin *> &receivers) {
+    if (compiled)
+        return -EBUSY;
+
+    nets.push_back({name, drivers, receivers});
+    return 0;
+}
+
+const NetGraph::Net *NetGraph::find_net(const string &name) {
+    for (Net &net : nets) {
+        if (net.name == name)
+            return &net;
+    }
+    return nullptr;
+}
+
+void NetGraph::compile() {
+    unordered_map<Pin *, uint32_t> ids;
+    vector<Pin *> node_pins;
+    vector<pair<uint32_t, uint32_t>> edges;
+
+    auto node_of = [&](Pin *pin) {
+        auto [it, inserted] = ids.try_emplace(pin, node_pins.size());
+        if (inserted)
+            node_pins.push_back(pin);
+        return it->second;
+    };
+
+    for (Net &net : nets) {
+        for (Pin *driver : net.drivers) {
+            uint32_t from = node_of(driver);
+            for (Pin *receiver : net.receivers) {
+                uint32_t to = node_of(receiver);
+                if (from != to)
+                    edges.push_back({from, to});
+            }
+        }
+        for (Pin *receiver : net.receivers)
+            node_of(receiver);
+    }
+    sort(edges.begin(), edges.end());
+    edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+    nodes = node_pins.size();
+    offsets = make_unique<uint32_t[]>(nodes + 1);
+    targets = make_unique<uint32_t[]>(edges.size());
+    pins = make_unique<atomic<Pin *>[]>(nodes);
+    dispatch = make_unique<atomic<bool>[]>(nodes);
+    levels = make_unique<atomic<bool>[]>(nodes);
+
+    // Edges are sorted by source node
+    uint32_t edge = 0;
+    for (uint32_t node = 0; node < nodes; node++) {
+        offsets[node] = edge;
+        while (edge < edges.size() && edges[edge].first == node) {
+            targets[edge] = edges[edge].second;
+            edge++;
+        }
+    }
+    offsets[nodes] = edge;
+
+    for (uint32_t node = 0; node < nodes; node++) {
+        Pin *pin = node_pins[node];
+        pins[node].store(pin);
+        dispatch[node].store(pin->wants_changes());
+        levels[node].store(false);
+        pin->graph = this;
+        pin->net_node = node;
+        pin->connected_pins.clear();
+    }
+    compiled = true;
+}
+
+vector<Pin *> NetGraph::get_receivers(unsigned int node) {
+    vector<Pin *> receivers;
+    for (uint32_t edge = offsets[node]; edge < offsets[node + 1]; edge++)
+        receivers.push_back(pins[targets[edge]].load(memory_order_acquire));
+    return receivers;
+}
+
+void NetGraph::replace_pin(Pin *old_pin, Pin *new_pin) {
+    if (old_pin->graph != this)
+        return;
+
+    unsigned int node = old_pin->net_node;
+    new_pin->graph = this;
+    new_pin->net_node = node;
+    // Published before the dispatch flag, a pin not dispatched is never dereferenced
+    pins[node].store(new_pin, memory_order_release);
+    dispatch[node].store(new_pin->wants_changes(), memory_order_release);
+    old_pin->graph = nullptr;
+}
@@ -1,4 +1,6 @@
 #include "Pin.hpp"
+#include "NetGraph.hpp"
+#include "WaveformRecorder.hpp"
 
 using namespace HWMocker;
 
@@ -19,6 +21,27 @@ void Pin::connect(Pin *pin) {
     connected_pins.push_back(pin);
 }
 
+std::vector<Pin *> Pin::get_receivers() {
+    return graph ? graph->get_receivers(net_node) : connected_pins;
+}
+
+bool Pin::get_level() { return graph ? graph->get_level(net_node) : false; }
+
+void Pin::change(bool value) {
+    if (recorder) {
+        for (uint32_t signal : trace_signals)
+            recorder->record(signal, value);
+    }
+
+    if (graph) {
+        graph->propagate(net_node, value);
+        return;
+    }
+
+    for (Pin *pin : connected_pins)
+        pin->on_change(value);
+}
+
 // Accessor methods
 
 // Other methods
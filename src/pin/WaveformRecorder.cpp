@@ -0,0 +1,159 @@
+#include "WaveformRecorder.hpp"
+#include "Futex.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+using namespace HWMocker;
+using namespace std;
+
+/// Ring of the calling thread, claimed on its first record
+static thread_local int local_ring = -1;
+
+/// Writer period, the rings must not fill up meanwhile
+#define WRITER_PERIOD_US 10000
+
+// Constructors/Destructors
+
+WaveformRecorder::~WaveformRecorder() {
+    if (writer_started.load()) {
+        writer_stopped.store(true);
+        writer_kick.fetch_add(1);
+        futex_wake(&writer_kick);
+        pthread_join(writer_pthread, NULL);
+    }
+
+    if (file) {
+        flush();
+        fclose(file);
+    }
+    delete[] ring_buffers;
+}
+
+// Methods
+
+uint32_t WaveformRecorder::add_signal(const string &scope, const string &name, bool level) {
+    signals.push_back({scope, name, level});
+    return signals.size() - 1;
+}
+
+/// The first threads get a ring each, the next ones share them
+unsigned int WaveformRecorder::thread_ring() {
+    if (local_ring < 0)
+        local_ring = next_ring.fetch_add(1) % rings;
+    return local_ring;
+}
+
+/// VCD identifier of a signal: base 94 number in the printable characters
+static string vcd_id(uint32_t signal) {
+    string id;
+    do {
+        id += (char)('!' + signal % 94);
+        signal /= 94;
+    } while (signal);
+    return id;
+}
+
+void WaveformRecorder::write_header() {
+    time_t now = time(nullptr);
+    char date[64];
+
+    strftime(date, sizeof(date), "%c", localtime(&now));
+    fprintf(file, "$date %s $end\n", date);
+    fprintf(file, "$version hwmocker $end\n");
+    fprintf(file, "$timescale 1ns $end\n");
+
+    vector<string> scopes;
+    for (Signal &signal : signals)
+        if (find(scopes.begin(), scopes.end(), signal.scope) == scopes.end())
+            scopes.push_back(signal.scope);
+
+    for (string &scope : scopes) {
+        fprintf(file, "$scope module %s $end\n", scope.c_str());
+        for (uint32_t id = 0; id < signals.size(); id++) {
+            if (signals[id].scope == scope)
+                fprintf(file, "$var wire 1 %s %s $end\n", vcd_id(id).c_str(),
+                        signals[id].name.c_str());
+        }
+        fprintf(file, "$upscope $end\n");
+    }
+    fprintf(file, "$enddefinitions $end\n");
+
+    // The levels at start, the chip selects are released high already
+    fprintf(file, "#0\n$dumpvars\n");
+    for (uint32_t id = 0; id < signals.size(); id++)
+        fprintf(file, "%d%s\n", signals[id].level, vcd_id(id).c_str());
+    fprintf(file, "$end\n");
+}
+
+int WaveformRecorder::start(const string &path) {
+    file = fopen(path.c_str(), "w");
+    if (!file)
+        return -errno;
+
+    ring_buffers = new Ring[rings];
+    for (unsigned int ring = 0; ring < rings; ring++)
+        for (uint64_t pos = 0; pos < ring_size; pos++)
+            ring_buffers[ring].slots[pos].seq.store(pos);
+
+    start_ns = now_ns();
+    write_header();
+
+    int rc = pthread_create(&writer_pthread, NULL, waveform_writer_thread_fn, this);
+    if (rc)
+        return -rc;
+    writer_started.store(true);
+    pthread_setname_np(writer_pthread, "vcdwriter");
+    return 0;
+}
+
+/// Drains the rings and writes their records in time order
+void WaveformRecorder::flush() {
+    struct Transition {
+        uint64_t time_ns;
+        uint32_t signal;
+        uint32_t value;
+    };
+    vector<Transition> transitions;
+
+    for (unsigned int index = 0; index < rings; index++) {
+        Ring &ring = ring_buffers[index];
+        for (;;) {
+            Record &slot = ring.slots[ring.head % ring_size];
+            if (slot.seq.load(memory_order_acquire) != ring.head + 1)
+                break;
+            transitions.push_back({slot.time_ns, slot.signal, slot.value});
+            slot.seq.store(ring.head + ring_size, memory_order_release);
+            ring.head++;
+        }
+    }
+
+    stable_sort(transitions.begin(), transitions.end(),
+                [](const Transition &a, const Transition &b) { return a.time_ns < b.time_ns; });
+
+    for (Transition &transition : transitions) {
+        uint64_t time_ns = transition.time_ns > start_ns ? transition.time_ns - start_ns : 0;
+        // Records published late are written at the current time
+        time_ns = max(time_ns, last_time_ns);
+        if (time_ns != last_time_ns) {
+            fprintf(file, "#%lu\n", (unsigned long)time_ns);
+            last_time_ns = time_ns;
+        }
+        fprintf(file, "%u%s\n", transition.value, vcd_id(transition.signal).c_str());
+    }
+    fflush(file);
+}
+
+void *HWMocker::waveform_writer_thread_fn(void *data) {
+    WaveformRecorder *recorder = (WaveformRecorder *)data;
+    struct timespec ts;
+
+    while (!recorder->writer_stopped.load()) {
+        uint32_t kick = recorder->writer_kick.load();
+        recorder->flush();
+        futex_wait(&recorder->writer_kick, kick, futex_deadline(WRITER_PERIOD_US, &ts));
+    }
+    return NULL;
+}
@@ -2,6 +2,7 @@
 
 #include <hwmocker_internal.h>
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
@@ -21,6 +22,9 @@ ProcessingUnit::ProcessingUnit(const char *name) : name(name) {
         throw new runtime_error(reason.str());
     }
 
+    workqueue = new Workqueue();
+    irq_controller->set_workqueue(workqueue);
+
     memset(&ready_mutex, 0, sizeof(ready_mutex));
     /* Lock the ready mutex since not ready yet */
     rc = pthread_mutex_lock(&ready_mutex);
@@ -63,17 +67,38 @@ ProcessingUnit::ProcessingUnit(const char *name) : name(name) {
 }
 
 ProcessingUnit::~ProcessingUnit() {
+    // No more bottom halves from here
+    irq_controller->set_workqueue(nullptr);
+    delete workqueue;
+
     for (Gpio *gpio : gpios)
         delete gpio;
 
     for (GpioIrq *gpio_irq : gpio_irqs)
         delete gpio_irq;
 
+    for (GpioPort *port : gpio_ports)
+        delete port;
+
 #ifdef CONFIG_HWMOCK_SPI
+    // The engines transfer on the spi devices until they are stopped
+    for (DmaController *dma : dmas)
+        delete dma;
+
     for (SpiDevice *spi_dev : spi_devs)
         delete spi_dev;
 #endif
 
+#ifdef CONFIG_HWMOCK_UART
+    for (UartDevice *uart : uarts)
+        delete uart;
+#endif
+
+#ifdef CONFIG_HWMOCK_I2C
+    for (I2cDevice *i2c_dev : i2c_devs)
+        delete i2c_dev;
+#endif
+
     if (irq_controller)
         delete irq_controller;
 }
@@ -89,71 +114,338 @@ int ProcessingUnit::load_config(json config) {
         gpios.push_back(new Gpio(pin_idx));
     }
 
+    if (GpioPort::config_has_ports(config)) {
+        for (json port_config : config["gpio-ports"]) {
+            GpioPort *port = new GpioPort(irq_controller);
+            int rc = port->load_config(port_config);
+            if (rc) {
+                printf("%s: invalid gpio port %s\n", name, port_config.dump().c_str());
+                delete port;
+                return rc;
+            }
+            gpio_ports.push_back(port);
+        }
+    }
+
 #ifdef CONFIG_HWMOCK_SPI
+    // "spi" is a device object or an array of them
     if (SpiDevice::config_has_device(config)) {
-        SpiDevice *spi = new SpiDevice(irq_controller);
-        if (!spi)
-            return -ENOMEM;
-        int rc = spi->load_config(config);
-        if (!rc)
+        json spi_configs = config["spi"];
+        if (!spi_configs.is_array())
+            spi_configs = json::array({spi_configs});
+        for (json spi_config : spi_configs) {
+            SpiDevice *spi = new SpiDevice(irq_controller);
+            spi->set_sim_clock(sim_clock);
+            int rc = spi->load_config(spi_config);
+            if (rc) {
+                printf("%s: invalid spi device %s\n", name, spi_config.dump().c_str());
+                delete spi;
+                return rc;
+            }
             spi_devs.push_back(spi);
+        }
     }
 #endif
 
-    return 0;
-}
+#ifdef CONFIG_HWMOCK_UART
+    // "uart" is a device object or an array of them
+    if (UartDevice::config_has_device(config)) {
+        json uart_configs = config["uart"];
+        if (!uart_configs.is_array())
+            uart_configs = json::array({uart_configs});
+        for (json uart_config : uart_configs) {
+            UartDevice *uart = new UartDevice(irq_controller);
+            uart->set_sim_clock(sim_clock);
+            int rc = uart->load_config(uart_config);
+            if (rc) {
+                printf("%s: invalid uart %s\n", name, uart_config.dump().c_str());
+                delete uart;
+                return rc;
+            }
+            uarts.push_back(uart);
+        }
+    }
+#endif
 
-Pin *ProcessingUnit::get_pin(unsigned int pin_idx) {
-    for (Gpio *gpio : gpios) {
-        if (gpio->pin_idx == pin_idx)
-            return gpio;
+#ifdef CONFIG_HWMOCK_I2C
+    // "i2c" is a device object or an array of them
+    if (I2cDevice::config_has_device(config)) {
+        json i2c_configs = config["i2c"];
+        if (!i2c_configs.is_array())
+            i2c_configs = json::array({i2c_configs});
+        for (json i2c_config : i2c_configs) {
+            I2cDevice *i2c_dev = new I2cDevice();
+            int rc = i2c_dev->load_config(i2c_config);
+            if (rc) {
+                printf("%s: invalid i2c device %s\n", name, i2c_config.dump().c_str());
+                delete i2c_dev;
+                return rc;
+            }
+            i2c_dev->set_sim_clock(sim_clock);
+            i2c_devs.push_back(i2c_dev);
+        }
     }
-    for (GpioIrq *gpio : gpio_irqs) {
-        if (gpio->pin_idx == pin_idx)
-            return gpio;
+#endif
+
+    build_lookup_tables();
+
+#ifdef CONFIG_HWMOCK_SPI
+    if (DmaController::config_has_dmas(config)) {
+        for (json dma_config : config["dma"]) {
+            DmaController *dma = new DmaController(irq_controller);
+            int rc = dma->load_config(dma_config);
+            SpiDevice *spi_dev = get_spi_device(dma->get_spi_index());
+            if (rc || !spi_dev) {
+                printf("%s: invalid dma %s\n", name, dma_config.dump().c_str());
+                delete dma;
+                return rc ? rc : -ENODEV;
+            }
+            dma->set_spi_device(spi_dev);
+            dmas.push_back(dma);
+        }
+        build_lookup_tables();
     }
-    // Not found, checks the devices pins
+#endif
+
+    if (config.contains("irq-priorities")) {
+        for (auto &[irqn, priority] : config["irq-priorities"].items()) {
+            int rc = irq_controller->set_priority(stoul(irqn), priority);
+            if (rc) {
+                printf("%s: invalid priority %s for irq %s\n", name, priority.dump().c_str(),
+                       irqn.c_str());
+                return rc;
+            }
+        }
+    }
+
+    if (config.contains("irq-priority-grouping")) {
+        int rc = irq_controller->set_priority_grouping(config["irq-priority-grouping"]);
+        if (rc) {
+            printf("%s: invalid irq priority grouping %s\n", name,
+                   config["irq-priority-grouping"].dump().c_str());
+            return rc;
+        }
+    }
+
+    if (config.contains("irq-coalescing")) {
+        for (auto &[irqn, policy] : config["irq-coalescing"].items()) {
+            int rc = irq_controller->set_coalescing(stoul(irqn), policy.value("max-events", 0),
+                                                    policy.value("max-delay-us", 0));
+            if (rc) {
+                printf("%s: invalid coalescing %s for irq %s\n", name, policy.dump().c_str(),
+                       irqn.c_str());
+                return rc;
+            }
+        }
+    }
+
+    if (config.value("irq-latency", false))
+        irq_controller->set_latency_tracking(true);
+
+    if (config.contains("irq-bottom-halves")) {
+        for (unsigned int irqn : config["irq-bottom-halves"]) {
+            int rc = irq_controller->set_bottom_half(irqn, true);
+            if (rc) {
+                printf("%s: invalid bottom half irq %u\n", name, irqn);
+                return rc;
+            }
+        }
+    }
+
+    if (config.contains("irq-polling")) {
+        json polling = config["irq-polling"];
+        int rc = irq_controller->set_polling(polling.value("budget", 0),
+                                             polling.value("interval-us", 0));
+        if (rc) {
+            printf("%s: invalid irq polling %s\n", name, polling.dump().c_str());
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+/// Indexes the pins by number, the gpios taking precedence over the devices
+/// pins, and the devices by index
+void ProcessingUnit::build_lookup_tables() {
+    pin_handles.clear();
+    gpio_port_table.clear();
+
 #ifdef CONFIG_HWMOCK_SPI
+    spi_table.clear();
     for (SpiDevice *spi_dev : spi_devs) {
-        Pin *pin = spi_dev->getPin(pin_idx);
-        if (pin)
-            return pin;
+        for (Pin *pin : spi_dev->get_pins()) {
+            if (pin)
+                add_pin_handle(pin->pin_idx).pin = pin;
+        }
+        // The chip selects are read and waited for as gpios
+        for (unsigned int cs = 0; cs < spi_dev->get_chip_selects(); cs++) {
+            Gpio *csn = spi_dev->get_csn(cs);
+            add_pin_handle(csn->pin_idx).gpio = csn;
+        }
+        unsigned int spi_idx = spi_dev->get_spi_index();
+        if (spi_idx >= spi_table.size())
+            spi_table.resize(spi_idx + 1);
+        if (!spi_table[spi_idx])
+            spi_table[spi_idx] = spi_dev;
+    }
+
+    dma_table.clear();
+    for (DmaController *dma : dmas) {
+        unsigned int dma_idx = dma->get_dma_index();
+        if (dma_idx >= dma_table.size())
+            dma_table.resize(dma_idx + 1);
+        if (!dma_table[dma_idx])
+            dma_table[dma_idx] = dma;
+    }
+#endif
+
+#ifdef CONFIG_HWMOCK_UART
+    uart_table.clear();
+    for (UartDevice *uart : uarts) {
+        for (Pin *pin : uart->get_pins())
+            add_pin_handle(pin->pin_idx).pin = pin;
+        unsigned int uart_idx = uart->get_uart_index();
+        if (uart_idx >= uart_table.size())
+            uart_table.resize(uart_idx + 1);
+        if (!uart_table[uart_idx])
+            uart_table[uart_idx] = uart;
     }
 #endif
-    return nullptr;
+
+#ifdef CONFIG_HWMOCK_I2C
+    i2c_table.clear();
+    for (I2cDevice *i2c_dev : i2c_devs) {
+        for (Pin *pin : i2c_dev->get_pins())
+            add_pin_handle(pin->pin_idx).pin = pin;
+        unsigned int i2c_idx = i2c_dev->get_i2c_index();
+        if (i2c_idx >= i2c_table.size())
+            i2c_table.resize(i2c_idx + 1);
+        if (!i2c_table[i2c_idx])
+            i2c_table[i2c_idx] = i2c_dev;
+    }
+#endif
+
+    for (GpioIrq *gpio_irq : gpio_irqs)
+        add_pin_handle(gpio_irq->pin_idx) = {gpio_irq, gpio_irq, gpio_irq};
+    for (Gpio *gpio : gpios)
+        add_pin_handle(gpio->pin_idx) = {gpio, gpio, nullptr};
+
+    for (GpioPort *port : gpio_ports) {
+        unsigned int port_idx = port->get_port_index();
+        if (port_idx >= gpio_port_table.size())
+            gpio_port_table.resize(port_idx + 1);
+        if (!gpio_port_table[port_idx])
+            gpio_port_table[port_idx] = port;
+    }
 }
 
 int ProcessingUnit::set_gpio_irq(unsigned int pin_idx, int (*handler)(void)) {
-    vector<Gpio *>::iterator it;
-
-    for (it = gpios.begin(); it != gpios.end(); it++) {
-        if ((*it)->pin_idx == pin_idx)
-            break;
-    }
-    if (it != gpios.end()) {
-        Gpio *gpio = *it;
-        GpioIrq *gpio_irq = new GpioIrq(irq_controller, gpio);
-        if (!gpio_irq)
-            return -ENOMEM;
-        gpio_irq->set_handler(handler);
-        gpio_irqs.push_back(gpio_irq);
-        gpios.erase(it);
-        delete gpio;
-    } else {
+    PinHandle *handle = get_pin_handle(pin_idx);
+
+    if (!handle || !handle->gpio || handle->gpio_irq)
+        return -EINVAL;
+    // Only the plain gpios are replaced, the spi chip selects belong to their device
+    auto gpio_it = find(gpios.begin(), gpios.end(), handle->gpio);
+    if (gpio_it == gpios.end())
         return -EINVAL;
+
+    // The gpio irq line is the pin number, shared with the device irqs
+    if (pin_idx >= HWMOCK_IRQ_LINES)
+        return -EINVAL;
+    if (!irq_controller->is_line_free(pin_idx))
+        return -EBUSY;
+
+    Gpio *gpio = handle->gpio;
+    GpioIrq *gpio_irq = new GpioIrq(irq_controller, gpio);
+    if (!gpio_irq)
+        return -ENOMEM;
+    gpio_irq->set_handler(handler);
+    int rc = irq_controller->register_irq(gpio_irq, pin_idx);
+    if (rc) {
+        // Line taken meanwhile, give the pin back to the gpio
+        if (gpio_irq->get_net_graph())
+            gpio_irq->get_net_graph()->replace_pin(gpio_irq, gpio);
+        for (Pin *pin : gpio_irq->get_connected_pins())
+            replace(pin->get_connected_pins().begin(), pin->get_connected_pins().end(),
+                    (Pin *)gpio_irq, (Pin *)gpio);
+        delete gpio_irq;
+        return rc;
     }
+    gpio_irqs.push_back(gpio_irq);
+    gpios.erase(gpio_it);
+    delete gpio;
+    *handle = {gpio_irq, gpio_irq, gpio_irq};
+    return 0;
+}
+
+int ProcessingUnit::set_gpio_irq_trigger(unsigned int pin_idx, unsigned int trigger) {
+    if (!trigger || trigger & ~(HWMOCKER_IRQ_RISING_EDGE | HWMOCKER_IRQ_FALLING_EDGE |
+                                HWMOCKER_IRQ_HIGH_LEVEL | HWMOCKER_IRQ_LOW_LEVEL))
+        return -EINVAL;
+
+    PinHandle *handle = get_pin_handle(pin_idx);
+    if (!handle || !handle->gpio_irq)
+        return -EINVAL;
+
+    handle->gpio_irq->set_trigger(trigger);
     return 0;
 }
 
 void ProcessingUnit::set_gpio_value(unsigned int pin_idx, bool value) {
-    for (Gpio *gpio : gpios) {
-        if (gpio->pin_idx == pin_idx)
-            return gpio->set_value(value);
-    }
-    for (GpioIrq *gpio_irq : gpio_irqs) {
-        if (gpio_irq->pin_idx == pin_idx)
-            return gpio_irq->set_value(value);
-    }
+    PinHandle *handle = get_pin_handle(pin_idx);
+    if (handle && handle->gpio)
+        handle->gpio->set_value(value);
+    poll_irqs();
+}
+
+#ifdef CONFIG_HWMOCK_SPI
+/// @brief Bit-bang a spi master over gpios and handle the irqs it raised
+/// @return size, -EINVAL if a pin is not a gpio or the mode is not in 0..3
+int ProcessingUnit::spi_bitbang_xfer(const struct hwmocker_spi_bitbang *bus, const void *txbuf,
+                                     void *rxbuf, size_t size) {
+    PinHandle *clk = get_pin_handle(bus->clk_pin);
+    PinHandle *mosi = get_pin_handle(bus->mosi_pin);
+    PinHandle *miso = get_pin_handle(bus->miso_pin);
+    if (!clk || !clk->gpio || !mosi || !mosi->gpio || !miso || !miso->gpio)
+        return -EINVAL;
+
+    int rc = SpiBitDecoder::master_xfer(clk->gpio, mosi->gpio, miso->gpio, bus->mode,
+                                        bus->lsb_first, (const uint8_t *)txbuf,
+                                        (uint8_t *)rxbuf, size);
+    poll_irqs();
+    return rc;
+}
+#endif
+
+/// @brief Wait for an edge of a gpio and handle the irqs it raised
+/// @return 0 on success, -ETIMEDOUT on timeout, -EINVAL if pin_idx is not a gpio
+/// @param  type mask of HWMOCKER_IRQ_RISING_EDGE and HWMOCKER_IRQ_FALLING_EDGE
+/// @param  timeout_us negative to wait forever
+int ProcessingUnit::wait_gpio_edge(unsigned int pin_idx, unsigned int type, int timeout_us) {
+    if (!type || type & ~(HWMOCKER_IRQ_RISING_EDGE | HWMOCKER_IRQ_FALLING_EDGE))
+        return -EINVAL;
+
+    PinHandle *handle = get_pin_handle(pin_idx);
+    if (!handle || !handle->gpio)
+        return -EINVAL;
+
+    int rc = handle->gpio->wait_edge(type, timeout_us);
+    poll_irqs();
+    return rc;
+}
+
+/// @brief Wait for a gpio level and handle the irqs it raised
+/// @return 0 on success, -ETIMEDOUT on timeout, -EINVAL if pin_idx is not a gpio
+/// @param  timeout_us negative to wait forever
+int ProcessingUnit::wait_gpio_level(unsigned int pin_idx, bool value, int timeout_us) {
+    PinHandle *handle = get_pin_handle(pin_idx);
+    if (!handle || !handle->gpio)
+        return -EINVAL;
+
+    int rc = handle->gpio->wait_level(value, timeout_us);
+    poll_irqs();
+    return rc;
 }
 
 void ProcessingUnit::start() {
@@ -171,6 +463,7 @@ void ProcessingUnit::stop() {
 int ProcessingUnit::run_thread() {
     printf("%s(%s) called\n", __func__, name);
     irq_controller->start();
+    workqueue->start();
 
     // Wait for the start to be called
     int rc = pthread_mutex_lock(&start_mutex);
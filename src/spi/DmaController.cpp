@@ -0,0 +1,204 @@
+#include "DmaController.hpp"
+#include "Futex.hpp"
+
+#include <hwmocker_internal.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace HWMocker;
+
+// Constructors/Destructors
+DmaController::DmaController(IrqController *irq_controller, HwIrq *irq) {
+    if (!irq) {
+        stringstream reason;
+        reason << "Cannot allocate with a null hw irq" << endl << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+
+    this->irq = irq;
+    this->irq_controller = irq_controller;
+    irq->set_handler(dma_irq_handler, this);
+}
+
+DmaController::~DmaController() {
+    stop();
+
+    if (irq_controller)
+        irq_controller->unregister_irq(irq);
+    delete irq;
+}
+
+int DmaController::dma_irq_handler(void *ctx) {
+    DmaController *dma = (DmaController *)ctx;
+    unsigned int status = dma->irq_status.exchange(0);
+
+    if (status && dma->handler)
+        return dma->handler(status, dma->handler_ctx);
+    return 0;
+}
+
+int DmaController::load_config(json config) {
+    dma_index = config["index"];
+    spi_index = config["spi"];
+
+    if (config.contains("irq")) {
+        irq->set_irqn(config["irq"]);
+        has_irq = true;
+        if (irq_controller)
+            return irq_controller->register_irq(irq, config["irq"]);
+    }
+    return 0;
+}
+
+void DmaController::start() {
+    bool expected = false;
+    if (!engine_started.compare_exchange_strong(expected, true))
+        return;
+
+    engine_kick_seen = engine_kick.load();
+    int rc = pthread_create(&engine_pthread, NULL, dma_thread_fn, this);
+    if (rc) {
+        engine_started.store(false);
+        stringstream reason;
+        reason << "pthread_create(dma) failed with " << strerror(rc) << endl
+               << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+    pthread_setname_np(engine_pthread, "dma");
+}
+
+int DmaController::set_ring(struct hwmocker_dma_desc *ring, unsigned int count) {
+    if (!ring || !count)
+        return -EINVAL;
+    if (pthread_mutex_trylock(&ring_lock))
+        return -EBUSY;
+
+    this->ring.store(ring);
+    ring_size = count;
+    position.store(0);
+    pthread_mutex_unlock(&ring_lock);
+    start();
+    return 0;
+}
+
+int DmaController::kick() {
+    if (!ring.load())
+        return -EINVAL;
+
+    engine_kick.fetch_add(1);
+    futex_wake(&engine_kick);
+    return 0;
+}
+
+void DmaController::stop() {
+    if (!engine_started.load() || engine_stopped.exchange(true))
+        return;
+
+    engine_kick.fetch_add(1);
+    futex_wake(&engine_kick);
+    // A slave engine waits for its master without timeout, a master one for
+    // its slave up to the rendezvous timeout
+    if (spi_dev && !spi_dev->is_master_device())
+        spi_dev->cancel_xfers();
+    else if (spi_dev)
+        spi_dev->cancel_rendezvous();
+    pthread_join(engine_pthread, NULL);
+}
+
+int DmaController::set_irq_handler(unsigned int irq_mask,
+                                   int (*handler)(unsigned int status, void *ctx), void *ctx) {
+    if (!has_irq)
+        return -ENOENT;
+
+    this->handler_ctx = ctx;
+    this->handler = handler;
+    this->irq_mask.store(irq_mask);
+    if (handler && irq_mask)
+        irq->enable();
+    else
+        irq->disable();
+    return 0;
+}
+
+void DmaController::get_stats(struct hwmocker_dma_stats *stats) {
+    stats->descriptors = descriptors.load();
+    stats->bytes = bytes.load();
+    stats->errors = errors.load();
+    stats->busy_ns = busy_ns.load();
+}
+
+void DmaController::raise(unsigned int events) {
+    events &= irq_mask.load(memory_order_relaxed);
+    if (events && irq_controller) {
+        irq_status.fetch_or(events);
+        irq_controller->local_raise(irq);
+    }
+}
+
+/// Runs the owned descriptors until the end of a chain or an error
+void DmaController::run_descriptors() {
+    pthread_mutex_lock(&ring_lock);
+    struct hwmocker_dma_desc *ring = this->ring.load();
+    while (!engine_stopped.load()) {
+        unsigned int index = position.load();
+        struct hwmocker_dma_desc *desc = &ring[index];
+        uint32_t flags = __atomic_load_n(&desc->flags, __ATOMIC_ACQUIRE);
+        if (!(flags & HWMOCKER_DMA_DESC_OWN))
+            break;
+
+        struct iovec tx_iov = {(void *)desc->src, desc->len};
+        struct iovec rx_iov = {desc->dst, desc->len};
+        uint64_t start_ns = spi_dev ? spi_dev->now_ns() : 0;
+        int rc = spi_dev ? spi_dev->transfer(&tx_iov, desc->src ? 1 : 0, &rx_iov,
+                                             desc->dst ? 1 : 0, desc->len)
+                         : -ENODEV;
+        if (spi_dev)
+            busy_ns.fetch_add(spi_dev->now_ns() - start_ns);
+
+        // Given back to the driver with its status
+        desc->status = rc;
+        __atomic_store_n(&desc->flags, flags & ~HWMOCKER_DMA_DESC_OWN, __ATOMIC_RELEASE);
+        position.store((index + 1) % ring_size);
+
+        if (rc < 0) {
+            errors.fetch_add(1);
+            // Cancelled by the teardown, nobody handles its irq anymore
+            if (rc != -ECANCELED)
+                raise(HWMOCKER_DMA_IRQ_ERROR);
+            break;
+        }
+        descriptors.fetch_add(1);
+        bytes.fetch_add(rc);
+
+        unsigned int events = flags & HWMOCKER_DMA_DESC_IRQ ? HWMOCKER_DMA_IRQ_DESC : 0;
+        if (ring_size > 1 && index + 1 == ring_size / 2)
+            events |= HWMOCKER_DMA_IRQ_HALF;
+        if (index + 1 == ring_size)
+            events |= HWMOCKER_DMA_IRQ_FULL;
+        raise(events);
+
+        if (!(flags & HWMOCKER_DMA_DESC_CHAIN))
+            break;
+    }
+    pthread_mutex_unlock(&ring_lock);
+}
+
+void *HWMocker::dma_thread_fn(void *data) {
+    DmaController *dma = (DmaController *)data;
+    uint32_t seen = dma->engine_kick_seen;
+
+    // Runs once for the kicks since its previous run
+    while (!dma->engine_stopped.load()) {
+        uint32_t kick = dma->engine_kick.load();
+        if (kick == seen) {
+            futex_wait(&dma->engine_kick, kick);
+            continue;
+        }
+        seen = kick;
+        dma->run_descriptors();
+    }
+    return NULL;
+}
@@ -0,0 +1,250 @@
+#include "SpiBitDecoder.hpp"
+#include "SpiDevice.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <errno.h>
+
+using namespace std;
+using namespace HWMocker;
+
+int SpiBitDecoder::load_config(json config) {
+    unsigned int mode = config.value("mode", 0);
+    if (mode > 3) {
+        printf("spi bit-bang mode %u is not in 0..3\n", mode);
+        return -EINVAL;
+    }
+    cpol = mode & 2;
+    cpha = mode & 1;
+    // The clock idles at its polarity: the first edge of the modes 2 and 3 is falling
+    clk_level = cpol;
+    lsb_first = config.value("lsb-first", lsb_first);
+    return 0;
+}
+
+int SpiBitDecoder::master_xfer(Gpio *clk, Gpio *mosi, Gpio *miso, unsigned int mode,
+                               bool lsb_first, const uint8_t *tx, uint8_t *rx, size_t size) {
+    if (mode > 3)
+        return -EINVAL;
+    bool cpol = mode & 2, cpha = mode & 1;
+
+    if (clk->get_value() != cpol)
+        clk->set_value(cpol);
+
+    // Only collapsed when the decoder is all the clock drives
+    vector<Pin *> receivers = clk->get_receivers();
+    SpiSensePin *sense =
+        receivers.size() == 1 ? dynamic_cast<SpiSensePin *>(receivers[0]) : nullptr;
+    SpiBitDecoder *decoder = sense ? sense->get_decoder(true) : nullptr;
+    if (decoder && decoder->takes_words(mosi, miso, cpol, cpha, lsb_first)) {
+        decoder->shift_words(tx, rx, size);
+        if (size) {
+            uint8_t last = tx ? tx[size - 1] : 0;
+            mosi->set_value((lsb_first ? last >> 7 : last) & 1);
+        }
+        return size;
+    }
+
+    for (size_t idx = 0; idx < size; idx++) {
+        uint8_t out = tx ? tx[idx] : 0, in = 0;
+        for (int shift = 0; shift < 8; shift++) {
+            int bit = lsb_first ? shift : 7 - shift;
+            if (cpha)
+                clk->set_value(!cpol);
+            mosi->set_value((out >> bit) & 1);
+            clk->set_value(cpha ? cpol : !cpol);
+            in |= miso->get_value() << bit;
+            if (!cpha)
+                clk->set_value(cpol);
+        }
+        if (rx)
+            rx[idx] = in;
+    }
+    return size;
+}
+
+/// A selected decoder of the master pins, mode and bit order, between two words
+bool SpiBitDecoder::takes_words(Gpio *mosi, Gpio *miso, bool cpol, bool cpha, bool lsb_first) {
+    if (!selected || in_bits || clk_level != cpol || cpol != this->cpol ||
+        cpha != this->cpha || lsb_first != this->lsb_first)
+        return false;
+
+    vector<Pin *> mosi_receivers = mosi->get_receivers();
+    vector<Pin *> miso_receivers = this->miso->get_receivers();
+    return find(mosi_receivers.begin(), mosi_receivers.end(), this->mosi) !=
+               mosi_receivers.end() &&
+           find(miso_receivers.begin(), miso_receivers.end(), miso) != miso_receivers.end();
+}
+
+/// Transfers whole words as their edges would, miso left at the level of its
+/// last bit
+void SpiBitDecoder::shift_words(const uint8_t *tx, uint8_t *rx, size_t size) {
+    for (size_t idx = 0; idx < size; idx++) {
+        // The leading edges of the modes 1 and 3 load the word, the other
+        // modes load the next one after the last sample
+        if (cpha)
+            next_out_word();
+        uint8_t word = out_word;
+        in_word = tx ? tx[idx] : 0;
+        store_word();
+        if (!cpha)
+            next_out_word();
+        if (rx)
+            rx[idx] = word;
+    }
+    if (!size)
+        return;
+
+    // The last bit shifted out in the modes 1 and 3, the first bit of the next word otherwise
+    out_bits = cpha ? 8 : 1;
+    unsigned int bit = cpha == lsb_first ? 7 : 0;
+    drive_miso((out_word >> bit) & 1);
+}
+
+void SpiBitDecoder::on_csn(bool level) {
+    if (!level && !selected)
+        begin();
+    else if (level && selected)
+        end();
+}
+
+void SpiBitDecoder::on_clk(bool level) {
+    if (level == clk_level)
+        return;
+    clk_level = level;
+    if (!selected)
+        return;
+
+    // Sampled on the leading edge in the modes 0 and 2, shifted out on the other one
+    bool leading = level != cpol;
+    if (leading == cpha) {
+        drive();
+        return;
+    }
+
+    uint8_t bit = mosi->get_value();
+    in_word = lsb_first ? (in_word >> 1) | (bit << 7) : (in_word << 1) | bit;
+    if (++in_bits < 8)
+        return;
+    in_bits = 0;
+    store_word();
+}
+
+void SpiBitDecoder::begin() {
+    selected = true;
+    start_ns = spi_dev->now_ns();
+    window = spi_dev->bitbang_begin(&tx, &tx_count, &rx, &rx_count, &size);
+    words = 0;
+    out_words = 0;
+    tx_seg = rx_seg = 0;
+    tx_off = rx_off = 0;
+    tx_span = rx_span = 0;
+    enter_word_path();
+    in_bits = 0;
+    // The first drive loads the first word
+    out_bits = 8;
+    miso_level = miso->get_value();
+    // The first bit is out before the first edge in the modes 0 and 2
+    if (!cpha)
+        drive();
+}
+
+void SpiBitDecoder::end() {
+    selected = false;
+    // The partial word is dropped
+    spi_dev->bitbang_end(window, words, spi_dev->now_ns() - start_ns);
+    window = nullptr;
+}
+
+void SpiBitDecoder::drive() {
+    if (out_bits == 8) {
+        next_out_word();
+        out_bits = 0;
+    }
+    bool bit = (lsb_first ? out_word >> out_bits : out_word >> (7 - out_bits)) & 1;
+    out_bits++;
+    drive_miso(bit);
+}
+
+void SpiBitDecoder::drive_miso(uint8_t bit) {
+    if (bit != miso_level) {
+        miso_level = bit;
+        miso->set_value(bit);
+    }
+}
+
+/// Loads the next word to shift out: a single load within a segment, 0 past
+/// the transfer
+void SpiBitDecoder::next_out_word() {
+    if (tx_span) {
+        out_word = *tx_ptr++;
+        out_words++;
+        if (!--tx_span) {
+            tx_seg++;
+            tx_off = 0;
+        }
+        return;
+    }
+
+    out_word = 0;
+    if (out_words < size) {
+        while (tx_seg < tx_count && tx_off == tx[tx_seg].iov_len) {
+            tx_seg++;
+            tx_off = 0;
+        }
+        if (tx_seg < tx_count)
+            out_word = ((const uint8_t *)tx[tx_seg].iov_base)[tx_off++];
+    }
+    out_words++;
+    enter_word_path();
+}
+
+/// Stores a received word: a single store within a segment, dropped past the
+/// transfer
+void SpiBitDecoder::store_word() {
+    if (rx_span) {
+        *rx_ptr++ = in_word;
+        words++;
+        if (!--rx_span) {
+            rx_seg++;
+            rx_off = 0;
+        }
+        return;
+    }
+
+    if (words < size) {
+        while (rx_seg < rx_count && rx_off == rx[rx_seg].iov_len) {
+            rx_seg++;
+            rx_off = 0;
+        }
+        if (rx_seg < rx_count)
+            ((uint8_t *)rx[rx_seg].iov_base)[rx_off++] = in_word;
+    }
+    words++;
+    enter_word_path();
+}
+
+/// Spans the rest of the current segments, up to the transfer size
+void SpiBitDecoder::enter_word_path() {
+    if (!rx_span && words < size) {
+        while (rx_seg < rx_count && rx_off == rx[rx_seg].iov_len) {
+            rx_seg++;
+            rx_off = 0;
+        }
+        if (rx_seg < rx_count) {
+            rx_ptr = (uint8_t *)rx[rx_seg].iov_base + rx_off;
+            rx_span = min(rx[rx_seg].iov_len - rx_off, size - words);
+        }
+    }
+    if (!tx_span && out_words < size) {
+        while (tx_seg < tx_count && tx_off == tx[tx_seg].iov_len) {
+            tx_seg++;
+            tx_off = 0;
+        }
+        if (tx_seg < tx_count) {
+            tx_ptr = (const uint8_t *)tx[tx_seg].iov_base + tx_off;
+            tx_span = min(tx[tx_seg].iov_len - tx_off, size - out_words);
+        }
+    }
+}
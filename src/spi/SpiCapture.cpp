@@ -0,0 +1,119 @@
+#include "SpiCapture.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace HWMocker;
+
+/// Records and payloads are 8 bytes aligned
+static inline uint64_t align8(uint64_t size) { return (size + 7) & ~7ULL; }
+
+/// Copies size bytes at most from the segments
+/// @return the number of bytes copied
+static size_t gather_iov(uint8_t *dst, const struct iovec *iov, int count, size_t size) {
+    size_t copied = 0;
+    for (int idx = 0; idx < count && copied < size; idx++) {
+        size_t len = min(size - copied, iov[idx].iov_len);
+        memcpy(dst + copied, iov[idx].iov_base, len);
+        copied += len;
+    }
+    return copied;
+}
+
+static size_t iov_length(const struct iovec *iov, int count, size_t size) {
+    size_t length = 0;
+    for (int idx = 0; idx < count; idx++)
+        length += iov[idx].iov_len;
+    return min(length, size);
+}
+
+SpiCapture::~SpiCapture() {
+    if (!base)
+        return;
+
+    uint64_t used = min(tail.load(), end.load());
+    munmap(base, capacity);
+    if (ftruncate(fd, used))
+        printf("Spi capture: cannot truncate to %lu bytes: %s\n", (unsigned long)used,
+               strerror(errno));
+    close(fd);
+    if (dropped.load())
+        printf("Spi capture: %lu records dropped\n", (unsigned long)dropped.load());
+}
+
+int SpiCapture::open(const string &path, size_t capacity) {
+    struct hwmocker_spi_capture_header header = {};
+
+    if (capacity < align8(sizeof(header)))
+        return -EINVAL;
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -errno;
+
+    // Sparse until the records reach it
+    if (ftruncate(fd, capacity)) {
+        int rc = -errno;
+        close(fd);
+        return rc;
+    }
+
+    void *map = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        int rc = -errno;
+        close(fd);
+        return rc;
+    }
+
+    base = (uint8_t *)map;
+    this->capacity = capacity;
+    memcpy(header.magic, HWMOCKER_SPI_CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = HWMOCKER_SPI_CAPTURE_VERSION;
+    header.header_size = sizeof(header);
+    memcpy(base, &header, sizeof(header));
+    tail.store(align8(sizeof(header)));
+    end.store(capacity);
+    return 0;
+}
+
+void SpiCapture::record(uint64_t timestamp_ns, uint8_t master, uint8_t cs, uint8_t master_index,
+                        uint8_t target_index, const struct iovec *mosi, int mosi_count,
+                        const struct iovec *miso, int miso_count, size_t length) {
+    size_t mosi_length = iov_length(mosi, mosi_count, length);
+    size_t miso_length = iov_length(miso, miso_count, length);
+    uint64_t size = sizeof(struct hwmocker_spi_capture_record) + align8(mosi_length) +
+                    align8(miso_length);
+
+    uint64_t offset = tail.fetch_add(size, memory_order_relaxed);
+    if (offset + size > capacity) {
+        // Nothing fits past the first record dropped
+        uint64_t first = end.load();
+        while (offset < first && !end.compare_exchange_weak(first, offset))
+            ;
+        dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    struct hwmocker_spi_capture_record *record =
+        (struct hwmocker_spi_capture_record *)(base + offset);
+    uint8_t *payload = (uint8_t *)(record + 1);
+    record->size = size;
+    record->timestamp_ns = timestamp_ns;
+    record->master = master;
+    record->cs = cs;
+    record->master_index = master_index;
+    record->target_index = target_index;
+    record->length = length;
+    record->mosi_length = gather_iov(payload, mosi, mosi_count, mosi_length);
+    record->miso_length =
+        gather_iov(payload + align8(mosi_length), miso, miso_count, miso_length);
+    // Complete once the magic is visible
+    __atomic_store_n(&record->magic, HWMOCKER_SPI_CAPTURE_RECORD_MAGIC, __ATOMIC_RELEASE);
+}
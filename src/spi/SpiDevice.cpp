@@ -2,6 +2,7 @@
 
 #include <hwmocker_internal.h>
 
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 
@@ -28,70 +29,188 @@ SpiDevice::~SpiDevice() {
         delete miso;
     if (clk)
         delete clk;
-    if (csn)
-        delete csn;
+    for (Gpio *cs_pin : csn)
+        delete cs_pin;
+    if (responder)
+        delete responder;
+    if (bit_decoder)
+        delete bit_decoder;
+    if (irq_controller)
+        irq_controller->unregister_irq(irq);
     delete irq;
 }
 
 int SpiDevice::spi_irq_handler(void *ctx) {
     SpiDevice *spi_dev = (SpiDevice *)ctx;
-    if (spi_dev->slave_callback) {
-        int (*slave_callback)(void *) = spi_dev->slave_callback;
-        void *slave_callback_ctx = spi_dev->slave_callback_ctx;
-        spi_dev->slave_callback = nullptr;
-        spi_dev->slave_callback_ctx = nullptr;
-        slave_callback(slave_callback_ctx);
-    }
+    spi_dev->complete_xfers();
+
+    unsigned int events = spi_dev->stream_events.exchange(0);
+    if (events && spi_dev->stream_handler)
+        return spi_dev->stream_handler(events, spi_dev->stream_ctx);
     return 0;
 }
 
-int SpiDevice::load_config(json config) {
-    json spi_config = config["spi"];
+int SpiDevice::load_config(json spi_config) {
     spi_index = spi_config["index"];
     is_master = spi_config["master"];
-    mosi = new Gpio(spi_config["mosi-pin"]);
-    miso = new Gpio(spi_config["miso-pin"]);
-    clk = new Gpio(spi_config["clk-pin"]);
-    csn = new Gpio(spi_config["csn-pin"]);
+    queue_depth = spi_config.value("queue-depth", queue_depth);
+    rendezvous_timeout_us = spi_config.value("rendezvous-timeout-us", rendezvous_timeout_us);
+    clk_hz = spi_config.value("clk-hz", clk_hz);
+    word_bits = spi_config.value("word-bits", word_bits);
+    word_gap_ns = spi_config.value("word-gap-ns", word_gap_ns);
+    if (!word_bits || word_bits > 32) {
+        stringstream reason;
+        reason << "spi word-bits " << word_bits << " is not in 1..32" << endl
+               << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+    stats_since_ns.store(now_ns());
+    stream_ring_size = spi_config.value("stream-ring-size", stream_ring_size);
+    if (!stream_ring_size || (stream_ring_size & (stream_ring_size - 1))) {
+        stringstream reason;
+        reason << "spi stream-ring-size " << stream_ring_size << " is not a power of 2" << endl
+               << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+    stream_rx.resize(stream_ring_size);
+    if (!queue_depth || (queue_depth & (queue_depth - 1))) {
+        stringstream reason;
+        reason << "spi queue-depth " << queue_depth << " is not a power of 2" << endl
+               << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+    queue.reset(new Transaction[queue_depth]);
+    for (uint32_t pos = 0; pos < queue_depth; pos++) {
+        queue[pos].seq.store(pos);
+        queue[pos].state.store(XFER_IDLE);
+    }
+
+    Gpio *mosi_pin = new Gpio(spi_config["mosi-pin"]);
+    Gpio *miso_pin = new Gpio(spi_config["miso-pin"]);
+    mosi = mosi_pin;
+    miso = miso_pin;
+    // A bit-banged slave follows the edges of its clock and chip select
+    if (spi_config.contains("bit-bang")) {
+        if (is_master || spi_config.contains("responder")) {
+            stringstream reason;
+            reason << "spi " << spi_index << " bit-bang is for the slaves without responder"
+                   << endl
+                   << get_stacktrace_str(64) << endl;
+            throw new runtime_error(reason.str());
+        }
+        bit_decoder = new SpiBitDecoder(this, mosi_pin, miso_pin);
+        int rc = bit_decoder->load_config(spi_config["bit-bang"]);
+        if (rc)
+            return rc;
+        clk = new SpiSensePin(spi_config["clk-pin"], bit_decoder, true);
+        csn.push_back(new SpiSensePin(spi_config["csn-pin"], bit_decoder, false));
+    } else {
+        clk = new Gpio(spi_config["clk-pin"]);
+        // A master drives one chip select per target
+        if (is_master && spi_config.contains("csn-pins")) {
+            for (unsigned int pin_idx : spi_config["csn-pins"])
+                csn.push_back(new Gpio(pin_idx));
+        } else {
+            csn.push_back(new Gpio(spi_config["csn-pin"]));
+        }
+    }
+    if (is_master)
+        targets.resize(csn.size());
+    if (spi_config.contains("responder")) {
+        if (is_master) {
+            stringstream reason;
+            reason << "spi master " << spi_index << " cannot have a responder" << endl
+                   << get_stacktrace_str(64) << endl;
+            throw new runtime_error(reason.str());
+        }
+        responder = new SpiResponder();
+        int rc = responder->load_config(spi_config["responder"]);
+        if (rc)
+            return rc;
+    }
     irq->set_irqn(spi_config["irq"]);
+    if (irq_controller)
+        return irq_controller->register_irq(irq, spi_config["irq"]);
     return 0;
 }
 
-bool SpiDevice::set_remote(SpiDevice *remote_spi_dev) {
-    // Checks that both devices are connected
-    bool found = false;
-    for (Pin *connected_pin : mosi->get_connected_pins()) {
-        if (connected_pin == remote_spi_dev->mosi) {
-            found = true;
-            break;
-        }
-    }
-    if (!found)
+/// @return true if a pin drives the other one, either way on the multi-drop nets
+static bool pins_connected(Pin *pin, Pin *other) {
+    vector<Pin *> &pins = pin->get_connected_pins();
+    vector<Pin *> &other_pins = other->get_connected_pins();
+    return find(pins.begin(), pins.end(), other) != pins.end() ||
+           find(other_pins.begin(), other_pins.end(), pin) != other_pins.end();
+}
+
+bool SpiDevice::connect_target(unsigned int cs, SpiDevice *target) {
+    if (!is_master || target->is_master || cs >= targets.size() || targets[cs])
         return false;
 
-    found = false;
-    for (Pin *connected_pin : miso->get_connected_pins()) {
-        if (connected_pin == remote_spi_dev->miso) {
-            found = true;
-            break;
-        }
-    }
-    if (!found)
+    // Checks that both devices are on the same bus
+    if (!pins_connected(mosi, target->mosi) || !pins_connected(miso, target->miso) ||
+        !pins_connected(clk, target->clk))
         return false;
 
-    found = false;
-    for (Pin *connected_pin : clk->get_connected_pins()) {
-        if (connected_pin == remote_spi_dev->clk) {
-            found = true;
-            break;
+    targets[cs] = target;
+    target->remote_spi_dev = this;
+    // The first target is selected by default
+    if (!targets[selected.load()])
+        selected.store(cs);
+    return true;
+}
+
+int SpiDevice::select(unsigned int cs) {
+    if (!is_master || cs >= targets.size())
+        return -EINVAL;
+    if (!targets[cs])
+        return -ENODEV;
+
+    selected.store(cs);
+    return 0;
+}
+
+void SpiDevice::release_chip_selects() {
+    if (!is_master)
+        return;
+
+    for (Gpio *cs_pin : csn)
+        cs_pin->set_value(true);
+}
+
+/// Copies size bytes at most from the src segments into the dst ones
+static void copy_iov(const struct iovec *dst, int dst_count, const struct iovec *src,
+                     int src_count, size_t size) {
+    size_t dst_off = 0, src_off = 0;
+
+    while (size && dst_count && src_count) {
+        size_t chunk = min({size, dst->iov_len - dst_off, src->iov_len - src_off});
+        memcpy((char *)dst->iov_base + dst_off, (char *)src->iov_base + src_off, chunk);
+        size -= chunk;
+        dst_off += chunk;
+        src_off += chunk;
+        if (dst_off == dst->iov_len) {
+            dst++;
+            dst_count--;
+            dst_off = 0;
+        }
+        if (src_off == src->iov_len) {
+            src++;
+            src_count--;
+            src_off = 0;
         }
     }
-    if (!found)
-        return false;
+}
 
-    // Ok...
-    this->remote_spi_dev = remote_spi_dev;
-    return true;
+/// Keeps the first size bytes of the segments
+/// @return the number of segments of the slice
+static int slice_iov(struct iovec *slice, const struct iovec *iov, int count, size_t size) {
+    int idx;
+    for (idx = 0; idx < count && size; idx++) {
+        size_t len = min(size, iov[idx].iov_len);
+        slice[idx] = {iov[idx].iov_base, len};
+        size -= len;
+    }
+    return idx;
 }
 
 ///
@@ -100,24 +219,76 @@ bool SpiDevice::set_remote(SpiDevice *remote_spi_dev) {
 /// @param  rxbuf
 /// @param  size
 int SpiDevice::sync_xfer(const void *txbuf, void *rxbuf, size_t size) {
+    struct iovec tx_iov = {(void *)txbuf, size};
+    struct iovec rx_iov = {rxbuf, size};
+    return sync_xfer(&tx_iov, txbuf ? 1 : 0, &rx_iov, rxbuf ? 1 : 0, size);
+}
+
+int SpiDevice::sync_xfer(const struct iovec *tx_iov, int tx_count, const struct iovec *rx_iov,
+                         int rx_count, size_t size) {
+    int rc = transfer(tx_iov, tx_count, rx_iov, rx_count, size);
+    if (!is_master && irq_controller)
+        irq_controller->check_point();
+    return rc;
+}
+
+int SpiDevice::transfer(const struct iovec *tx_iov, int tx_count, const struct iovec *rx_iov,
+                        int rx_count, size_t size) {
+    if (tx_count > HWMOCKER_SPI_MAX_SEGMENTS || rx_count > HWMOCKER_SPI_MAX_SEGMENTS)
+        return -E2BIG;
 
-    pthread_mutex_lock(&remote_spi_dev->lock);
-    current_rx = rxbuf;
-    current_tx = txbuf;
     if (is_master) {
-        if (remote_spi_dev->is_listening)
-            remote_spi_dev->xmit_locked(txbuf, rxbuf, size);
-        current_rx = nullptr;
-        current_tx = nullptr;
-        pthread_mutex_unlock(&remote_spi_dev->lock);
+        unsigned int cs = selected.load();
+        SpiDevice *target = targets[cs];
+        if (!target)
+            return -ENODEV;
+
+        // The bus is busy until the chip select is released
+        pthread_mutex_lock(&lock);
+        if (stream_peer.load()) {
+            pthread_mutex_unlock(&lock);
+            return -EBUSY;
+        }
+        if (target->responder) {
+            // No slave thread to meet, the responder answers in this thread
+            csn[cs]->set_value(false);
+            uint64_t busy_ns = clock_xfer(size);
+            account(size, busy_ns);
+            target->account(size, busy_ns);
+            target->responder->respond(tx_iov, tx_count, rx_iov, rx_count, size);
+            if (target->capture)
+                target->capture->record(now_ns(), capture_source, cs, spi_index,
+                                        target->spi_index, tx_iov, tx_count, rx_iov, rx_count,
+                                        size);
+            csn[cs]->set_value(true);
+            pthread_mutex_unlock(&lock);
+            return size;
+        }
+        int rc = target->wait_armed(rendezvous_timeout_us);
+        if (rc) {
+            pthread_mutex_unlock(&lock);
+            return rc;
+        }
+        Transaction *transaction = target->pending_xfer();
+        bool lending = transaction->borrowing;
+        csn[cs]->set_value(false);
+        uint64_t busy_ns = clock_xfer(size);
+        account(size, busy_ns);
+        target->account(size, busy_ns);
+        target->xmit_locked(transaction, tx_iov, tx_count, rx_iov, rx_count, size);
+        csn[cs]->set_value(true);
+        pthread_mutex_unlock(&lock);
+        if (lending)
+            target->wait_released();
         return size;
     }
 
-    current_xfer_size = size;
-    is_listening = true;
-    pthread_mutex_unlock(&remote_spi_dev->lock);
-    wait_xfer_done();
-    return current_xfer_size;
+    Transaction *transaction;
+    uint32_t position;
+    int rc = claim_slot(tx_iov, tx_count, rx_iov, rx_count, size, &transaction, &position);
+    if (rc)
+        return rc;
+    return wait_slot(transaction);
 }
 
 ///
@@ -129,70 +300,471 @@ int SpiDevice::sync_xfer(const void *txbuf, void *rxbuf, size_t size) {
 /// @param  ctx
 int SpiDevice::async_xfer(const void *txbuf, void *rxbuf, size_t size, int (*callback)(void *),
                           void *ctx) {
+    struct iovec tx_iov = {(void *)txbuf, size};
+    struct iovec rx_iov = {rxbuf, size};
+    return async_xfer(&tx_iov, txbuf ? 1 : 0, &rx_iov, rxbuf ? 1 : 0, size, callback, ctx);
+}
+
+int SpiDevice::async_xfer(const struct iovec *tx_iov, int tx_count, const struct iovec *rx_iov,
+                          int rx_count, size_t size, int (*callback)(void *), void *ctx) {
     if (!irq->enabled())
         return -EINVAL;
 
-    if (is_master && remote_spi_dev->is_listening) {
+    if (is_master) {
         // Do it immediately
-        int rc = sync_xfer(txbuf, rxbuf, size);
-        if (rc && callback)
+        int rc = sync_xfer(tx_iov, tx_count, rx_iov, rx_count, size);
+        if (rc > 0 && callback)
             callback(ctx);
         return rc;
     }
 
-    // Slave
-    pthread_mutex_lock(&remote_spi_dev->lock);
-    current_rx = rxbuf;
-    current_tx = txbuf;
-    current_xfer_size = size;
-    is_listening = true;
-    slave_callback = callback;
-    slave_callback_ctx = ctx;
-    pthread_mutex_unlock(&remote_spi_dev->lock);
+    Transaction *transaction;
+    uint32_t position;
+    int rc = claim_slot(tx_iov, tx_count, rx_iov, rx_count, size, &transaction, &position);
+    if (rc)
+        return rc;
+
+    transaction->callback = callback;
+    transaction->ctx = ctx;
+    arm(transaction);
+    return 0;
+}
+
+int SpiDevice::submit_xfer(const struct iovec *tx_iov, int tx_count, const struct iovec *rx_iov,
+                           int rx_count, size_t size, int (*callback)(void *, int), void *ctx) {
+    if (!irq->enabled())
+        return -EINVAL;
+
+    if (is_master) {
+        int rc = sync_xfer(tx_iov, tx_count, rx_iov, rx_count, size);
+        if (rc < 0)
+            return rc;
+        if (callback)
+            callback(ctx, rc);
+        return 0;
+    }
+
+    Transaction *transaction;
+    uint32_t position;
+    int rc = claim_slot(tx_iov, tx_count, rx_iov, rx_count, size, &transaction, &position);
+    if (rc)
+        return rc;
+
+    transaction->status_callback = callback;
+    transaction->ctx = ctx;
+    arm(transaction);
     return 0;
 }
 
-void SpiDevice::xmit_locked(const void *txbuf, void *rxbuf, size_t size) {
-    int rc;
+int SpiDevice::borrow_xfer(const struct iovec *tx_iov, int tx_count, size_t size,
+                           const struct iovec **rx_iov, int *rx_count) {
+    if (is_master || lent.load())
+        return -EINVAL;
+
+    Transaction *transaction;
+    uint32_t position;
+    int rc = claim_slot(tx_iov, tx_count, nullptr, 0, size, &transaction, &position);
+    if (rc)
+        return rc;
+
+    transaction->borrowing = true;
+    rc = wait_slot(transaction);
+    *rx_iov = borrowed;
+    *rx_count = borrowed_count;
+    if (irq_controller)
+        irq_controller->check_point();
+    return rc;
+}
+
+int SpiDevice::release_borrowed() {
+    if (!lent.exchange(0))
+        return -EINVAL;
 
-    size = min(size, current_xfer_size);
-    if (size && current_tx)
-        memcpy(rxbuf, current_tx, size);
+    futex_wake(&lent);
+    return 0;
+}
 
-    if (size && current_rx)
-        memcpy(current_rx, txbuf, size);
+void SpiDevice::wait_released() {
+    while (lent.load())
+        futex_wait(&lent, 1);
+}
 
-    current_rx = nullptr;
-    current_tx = nullptr;
+/// Claims the next queue slot and copies the transfer in it, the caller
+/// publishes it
+/// @return 0 on success, -EBUSY if the queue is full, -E2BIG if there are too
+/// many segments
+int SpiDevice::claim_slot(const struct iovec *tx_iov, int tx_count, const struct iovec *rx_iov,
+                          int rx_count, size_t size, Transaction **claimed, uint32_t *position) {
+    // The responder answers the master, nothing reads this queue
+    if (responder)
+        return -EBUSY;
+    if (cancelled.load())
+        return -ECANCELED;
+    if (tx_count > HWMOCKER_SPI_MAX_SEGMENTS || rx_count > HWMOCKER_SPI_MAX_SEGMENTS)
+        return -E2BIG;
 
-    current_xfer_size = size;
-    is_listening = false;
-    rc = pthread_cond_signal(&cond);
-    if (rc) {
-        stringstream reason;
-        reason << "pthread_cond_signal(cond) failed with " << strerror(rc) << endl
-               << get_stacktrace_str(64) << endl;
-        throw new runtime_error(reason.str());
+    uint32_t pos = submitted.load(memory_order_relaxed);
+    for (;;) {
+        Transaction &slot = queue[pos % queue_depth];
+        int32_t diff = (int32_t)(slot.seq.load(memory_order_acquire) - pos);
+        if (!diff) {
+            if (submitted.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return -EBUSY;
+        } else {
+            pos = submitted.load(memory_order_relaxed);
+        }
+    }
+
+    Transaction *transaction = &queue[pos % queue_depth];
+    copy(tx_iov, tx_iov + tx_count, transaction->tx);
+    copy(rx_iov, rx_iov + rx_count, transaction->rx);
+    transaction->tx_count = tx_count;
+    transaction->rx_count = rx_count;
+    transaction->size = size;
+    transaction->status = 0;
+    transaction->borrowing = false;
+    transaction->waited.store(false);
+    transaction->callback = nullptr;
+    transaction->status_callback = nullptr;
+    transaction->ctx = nullptr;
+    *claimed = transaction;
+    *position = pos;
+    return 0;
+}
+
+/// Publishes a claimed slot to the master
+void SpiDevice::arm(Transaction *transaction) {
+    transaction->state.store(XFER_ARMED, memory_order_release);
+    armed.fetch_add(1);
+    if (master_parked.load())
+        futex_wake(&armed);
+}
+
+/// Publishes a claimed slot and waits for its transfer, then completes it
+/// @return the transferred size
+int SpiDevice::wait_slot(Transaction *transaction) {
+    transaction->waited.store(true);
+    arm(transaction);
+    // Armed before checking the cancellation: either this thread or
+    // cancel_xfers() sees the slot and fails it
+    if (cancelled.load())
+        cancel_xfers();
+
+    auto is_done = [transaction] {
+        return (transaction->state.load(memory_order_acquire) & ~XFER_PARKED) == XFER_DONE;
+    };
+    if (!spin(is_done)) {
+        for (;;) {
+            uint32_t state = transaction->state.load(memory_order_acquire);
+            if ((state & ~XFER_PARKED) == XFER_DONE)
+                break;
+            if (!(state & XFER_PARKED) &&
+                !transaction->state.compare_exchange_weak(state, state | XFER_PARKED))
+                continue;
+            futex_wait(&transaction->state, state | XFER_PARKED);
+        }
+    }
+
+    int status = transaction->status;
+    transaction->waited.store(false);
+    complete_xfers();
+    return status;
+}
+
+/// Runs the callbacks of the transferred slots in order and frees them, up to
+/// the first one waited for by its submitter
+void SpiDevice::complete_xfers() {
+    // A nested call gives up, the interrupted one loops again
+    while (!completing.exchange(true)) {
+        for (;;) {
+            uint32_t pos = completed.load();
+            Transaction &transaction = queue[pos % queue_depth];
+            if (pos == transferred.load() || transaction.waited.load())
+                break;
+
+            int (*callback)(void *) = transaction.callback;
+            int (*status_callback)(void *, int) = transaction.status_callback;
+            void *ctx = transaction.ctx;
+            int status = transaction.status;
+            completed.store(pos + 1);
+            transaction.state.store(XFER_IDLE);
+            transaction.seq.store(pos + queue_depth, memory_order_release);
+
+            if (callback)
+                callback(ctx);
+            if (status_callback)
+                status_callback(ctx, status);
+        }
+        completing.store(false);
+
+        uint32_t pos = completed.load();
+        if (pos == transferred.load() || queue[pos % queue_depth].waited.load())
+            return;
+    }
+}
+
+/// @return the oldest armed transfer, nullptr if none
+SpiDevice::Transaction *SpiDevice::pending_xfer() {
+    uint32_t pos = transferred.load();
+    Transaction *transaction = &queue[pos % queue_depth];
+    if (transaction->seq.load(memory_order_acquire) != pos ||
+        (transaction->state.load(memory_order_acquire) & ~XFER_PARKED) != XFER_ARMED)
+        return nullptr;
+    return transaction;
+}
+
+void SpiDevice::cancel_xfers() {
+    // The master takes the armed slots under its bus lock
+    pthread_mutex_t *bus_lock = remote_spi_dev ? &remote_spi_dev->lock : &lock;
+    Transaction *transaction;
+
+    cancelled.store(true);
+    pthread_mutex_lock(bus_lock);
+    while ((transaction = pending_xfer())) {
+        transaction->status = -ECANCELED;
+        transferred.fetch_add(1);
+        // No completion irq, the processing unit may be gone
+        if (transaction->state.exchange(XFER_DONE) & XFER_PARKED)
+            futex_wake(&transaction->state);
+    }
+    pthread_mutex_unlock(bus_lock);
+}
+
+void SpiDevice::cancel_rendezvous() {
+    for (SpiDevice *target : targets) {
+        if (!target)
+            continue;
+        // Set before the wake up: a master going to sleep sees armed change
+        target->rendezvous_cancelled.store(true);
+        target->armed.fetch_add(1);
+        futex_wake(&target->armed);
+    }
+}
+
+/// Waits for the slave to arm a transfer
+/// @return 0 on success, -ETIMEDOUT on timeout, -ECANCELED once the
+/// rendezvous is cancelled
+/// @param  timeout_us negative to wait forever
+int SpiDevice::wait_armed(int timeout_us) {
+    if (spin([this] { return pending_xfer() != nullptr || rendezvous_cancelled.load(); }))
+        return rendezvous_cancelled.load() ? -ECANCELED : 0;
+
+    struct timespec ts;
+    const struct timespec *deadline = futex_deadline(timeout_us, &ts);
+    int rc = 0;
+
+    master_parked.store(true);
+    for (;;) {
+        uint32_t seq = armed.load();
+        if (rendezvous_cancelled.load()) {
+            rc = -ECANCELED;
+            break;
+        }
+        if (pending_xfer())
+            break;
+        rc = futex_wait(&armed, seq, deadline);
+        if (rc == -ETIMEDOUT)
+            break;
+        rc = 0;
     }
+    master_parked.store(false);
+    return rc;
+}
 
+void SpiDevice::xmit_locked(Transaction *transaction, const struct iovec *tx_iov, int tx_count,
+                            const struct iovec *rx_iov, int rx_count, size_t size) {
+    transaction->state.fetch_add(XFER_TRANSFERRING - XFER_ARMED);
+    size = min(size, transaction->size);
+    copy_iov(rx_iov, rx_count, transaction->tx, transaction->tx_count, size);
+    if (transaction->borrowing) {
+        // Lent until the slave releases them
+        borrowed_count = slice_iov(borrowed, tx_iov, tx_count, size);
+        lent.store(1);
+    } else {
+        copy_iov(transaction->rx, transaction->rx_count, tx_iov, tx_count, size);
+    }
+    transaction->status = size;
+    if (capture)
+        capture->record(now_ns(), remote_spi_dev->capture_source, remote_spi_dev->selected.load(),
+                        remote_spi_dev->spi_index, spi_index, tx_iov, tx_count, transaction->tx,
+                        transaction->tx_count, size);
+    finish_xfer(transaction);
+}
+
+/// Hands a transferred slot back to the slave
+void SpiDevice::finish_xfer(Transaction *transaction) {
+    transferred.fetch_add(1);
+
+    // Not waited for, the slot is done before the raise: its completion may
+    // free and rearm it as soon as the line is pending
+    if (!transaction->waited.load()) {
+        transaction->state.store(XFER_DONE, memory_order_release);
+        if (irq_controller)
+            irq_controller->local_raise(this->irq);
+        return;
+    }
+
+    // Raise before waking the slave up so that this completion irq is not
+    // mistaken for the one of its next transfer
     if (irq_controller)
         irq_controller->local_raise(this->irq);
+    if (transaction->state.exchange(XFER_DONE) & XFER_PARKED)
+        futex_wake(&transaction->state);
 }
 
-void SpiDevice::wait_xfer_done() {
-    int rc = pthread_mutex_lock(&cond_mutex);
-    if (rc) {
-        stringstream reason;
-        reason << "pthread_mutex_lock(cond_mutex) failed with " << strerror(rc) << endl
-               << get_stacktrace_str(64) << endl;
-        throw new runtime_error(reason.str());
+uint64_t SpiDevice::xfer_duration_ns(size_t size) {
+    if (!clk_hz)
+        return 0;
+
+    uint64_t words = (size * 8 + word_bits - 1) / word_bits;
+    if (!words)
+        return 0;
+    // Split so that the bits do not overflow once in ns
+    uint64_t bits = words * word_bits;
+    uint64_t clocked_ns = bits / clk_hz * 1000000000ULL + bits % clk_hz * 1000000000ULL / clk_hz;
+    return clocked_ns + (words - 1) * word_gap_ns;
+}
+
+/// Waits for the modeled duration of a master transfer
+/// @return the duration in ns
+uint64_t SpiDevice::clock_xfer(size_t size) {
+    uint64_t duration_ns = xfer_duration_ns(size);
+    if (duration_ns && sim_clock)
+        sim_clock->wait_until(sim_clock->now_ns() + duration_ns);
+    return duration_ns;
+}
+
+void SpiDevice::account(size_t size, uint64_t busy_ns) {
+    stats_xfers.fetch_add(1, memory_order_relaxed);
+    stats_bytes.fetch_add(size, memory_order_relaxed);
+    stats_busy_ns.fetch_add(busy_ns, memory_order_relaxed);
+}
+
+void SpiDevice::get_stats(struct hwmocker_spi_stats *stats) {
+    stats->xfers = stats_xfers.load();
+    stats->bytes = stats_bytes.load();
+    stats->busy_ns = stats_busy_ns.load();
+    stats->elapsed_ns = now_ns() - stats_since_ns.load();
+}
+
+void SpiDevice::reset_stats() {
+    stats_xfers.store(0);
+    stats_bytes.store(0);
+    stats_busy_ns.store(0);
+    stats_since_ns.store(now_ns());
+}
+
+int SpiDevice::stream_start() {
+    if (!is_master)
+        return -EINVAL;
+
+    unsigned int cs = selected.load();
+    SpiDevice *target = targets[cs];
+    if (!target)
+        return -ENODEV;
+
+    pthread_mutex_lock(&lock);
+    if (stream_peer.load()) {
+        pthread_mutex_unlock(&lock);
+        return -EBUSY;
     }
+    stream_rx.reset();
+    target->stream_rx.reset();
+    target->stream_peer.store(this);
+    stream_peer.store(target);
+    csn[cs]->set_value(false);
+    pthread_mutex_unlock(&lock);
 
-    rc = pthread_cond_wait(&cond, &cond_mutex);
-    if (rc) {
-        stringstream reason;
-        reason << "pthread_cond_wait(cond, cond_mutex) failed with " << strerror(rc) << endl
-               << get_stacktrace_str(64) << endl;
-        throw new runtime_error(reason.str());
+    target->raise_stream(HWMOCKER_SPI_STREAM_START);
+    return 0;
+}
+
+int SpiDevice::stream_stop() {
+    pthread_mutex_lock(&lock);
+    SpiDevice *target = is_master ? stream_peer.load() : nullptr;
+    if (!target) {
+        pthread_mutex_unlock(&lock);
+        return -ENOTCONN;
     }
-}
\ No newline at end of file
+    target->stream_peer.store(nullptr);
+    stream_peer.store(nullptr);
+    csn[selected.load()]->set_value(true);
+    pthread_mutex_unlock(&lock);
+
+    // The received bytes stay readable
+    target->raise_stream(HWMOCKER_SPI_STREAM_STOP);
+    return 0;
+}
+
+ssize_t SpiDevice::stream_write(const void *buf, size_t size) {
+    SpiDevice *peer = stream_peer.load();
+    if (!peer)
+        return -ENOTCONN;
+
+    size_t watermark = peer->stream_watermark.load(memory_order_relaxed);
+    size_t before = peer->stream_rx.level();
+    size_t written = peer->stream_rx.write(buf, size);
+    // Raised when the level crosses the watermark, the handler drains the ring
+    if (watermark && before < watermark && before + written >= watermark)
+        peer->raise_stream(HWMOCKER_SPI_STREAM_RX);
+    return written;
+}
+
+int SpiDevice::set_stream_handler(size_t watermark, int (*handler)(unsigned int events, void *ctx),
+                                  void *ctx) {
+    if (watermark > stream_rx.capacity())
+        return -EINVAL;
+
+    stream_ctx = ctx;
+    stream_handler = handler;
+    stream_watermark.store(watermark);
+    if (handler)
+        irq->enable();
+    return 0;
+}
+
+void SpiDevice::raise_stream(unsigned int events) {
+    stream_events.fetch_or(events);
+    if (irq_controller)
+        irq_controller->local_raise(irq);
+}
+
+/// Takes the oldest armed transfer for a bit-banged chip select window
+/// @return the window, nullptr if no transfer is armed: the words are dropped
+void *SpiDevice::bitbang_begin(const struct iovec **tx_iov, int *tx_count,
+                               const struct iovec **rx_iov, int *rx_count, size_t *size) {
+    Transaction *transaction = pending_xfer();
+    if (!transaction) {
+        *tx_count = *rx_count = 0;
+        *size = 0;
+        return nullptr;
+    }
+
+    transaction->state.fetch_add(XFER_TRANSFERRING - XFER_ARMED);
+    *tx_iov = transaction->tx;
+    *tx_count = transaction->tx_count;
+    *rx_iov = transaction->rx;
+    *rx_count = transaction->rx_count;
+    *size = transaction->size;
+    return transaction;
+}
+
+/// Completes a bit-banged window as a single transfer of the clocked words
+void SpiDevice::bitbang_end(void *window, size_t clocked, uint64_t busy_ns) {
+    account(clocked, busy_ns);
+    Transaction *transaction = (Transaction *)window;
+    if (!transaction)
+        return;
+
+    size_t size = min(clocked, transaction->size);
+    transaction->status = size;
+    if (capture)
+        capture->record(now_ns(),
+                        capture_source == HWMOCKER_SPI_CAPTURE_HOST ? HWMOCKER_SPI_CAPTURE_SOC
+                                                                    : HWMOCKER_SPI_CAPTURE_HOST,
+                        0, HWMOCKER_SPI_CAPTURE_BITBANG, spi_index, transaction->rx,
+                        transaction->rx_count, transaction->tx, transaction->tx_count, size);
+    finish_xfer(transaction);
+}
@@ -0,0 +1,217 @@
+#include "SpiResponder.hpp"
+
+#include <hwmocker_internal.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <errno.h>
+
+using namespace std;
+using namespace HWMocker;
+
+/// Walks the segments of a transfer one byte at a time
+class IovCursor {
+  public:
+    IovCursor(const struct iovec *iov, int count) : iov(iov), count(count) {}
+
+    /// @return the next byte, 0 past the segments
+    uint8_t get() {
+        uint8_t *byte = next();
+        return byte ? *byte : 0;
+    }
+
+    /// Stores the next byte, dropped past the segments
+    void put(uint8_t value) {
+        uint8_t *byte = next();
+        if (byte)
+            *byte = value;
+    }
+
+  private:
+    uint8_t *next() {
+        while (idx < count && offset == iov[idx].iov_len) {
+            idx++;
+            offset = 0;
+        }
+        if (idx == count)
+            return nullptr;
+        return (uint8_t *)iov[idx].iov_base + offset++;
+    }
+
+    const struct iovec *iov;
+    int count;
+    int idx = 0;
+    size_t offset = 0;
+};
+
+/// Reads the bytes of a number or of an array of numbers
+/// @return 0 on success, -EINVAL if a number does not fit in a byte
+static int config_bytes(json &value, vector<uint8_t> &bytes) {
+    json values = value.is_array() ? value : json::array({value});
+    for (unsigned int byte : values) {
+        if (byte > 0xff) {
+            printf("spi responder value 0x%x is not a byte\n", byte);
+            return -EINVAL;
+        }
+        bytes.push_back(byte);
+    }
+    return 0;
+}
+
+/// Reads a byte option, left unchanged when missing
+/// @return 0 on success, -EINVAL if it does not fit in a byte
+static int config_byte(json &config, const char *name, uint8_t *byte) {
+    unsigned int value = config.value(name, (unsigned int)*byte);
+    if (value > 0xff) {
+        printf("spi responder %s 0x%x is not a byte\n", name, value);
+        return -EINVAL;
+    }
+    *byte = value;
+    return 0;
+}
+
+int SpiResponder::load_config(json config) {
+    if (config_byte(config, "read-mask", &read_mask) ||
+        config_byte(config, "address-mask", &address_mask) ||
+        config_byte(config, "status", &status))
+        return -EINVAL;
+    auto_increment = config.value("auto-increment", auto_increment);
+    if (address_mask & (address_mask + 1)) {
+        printf("spi responder address-mask 0x%x is not a low bits mask\n", address_mask);
+        return -EINVAL;
+    }
+
+    unsigned int register_count = address_mask + 1;
+    registers.reset(new atomic<uint8_t>[register_count]);
+    read_only.reset(new bool[register_count]);
+    for (unsigned int address = 0; address < register_count; address++) {
+        registers[address].store(0);
+        read_only[address] = false;
+    }
+
+    // Register addresses are strings, like "0x0f", consecutive values in arrays
+    if (config.contains("registers")) {
+        for (auto &[key, value] : config["registers"].items()) {
+            vector<uint8_t> bytes;
+            if (config_bytes(value, bytes))
+                return -EINVAL;
+            int rc = write_registers(stoul(key, nullptr, 0), bytes.data(), bytes.size());
+            if (rc) {
+                printf("spi responder registers %s do not fit in the map\n", key.c_str());
+                return rc;
+            }
+        }
+    }
+    if (config.contains("read-only")) {
+        for (unsigned int address : config["read-only"]) {
+            if (address >= register_count) {
+                printf("spi responder read-only register 0x%x is not in the map\n", address);
+                return -EINVAL;
+            }
+            read_only[address] = true;
+        }
+    }
+    if (config.contains("commands")) {
+        for (json &command_config : config["commands"]) {
+            Command command;
+            if (config_bytes(command_config["match"], command.match) ||
+                config_bytes(command_config["response"], command.response))
+                return -EINVAL;
+            if (command.match.empty() || command.match.size() > max_command_bytes) {
+                printf("spi responder command match is not 1..%u bytes\n", max_command_bytes);
+                return -EINVAL;
+            }
+            commands.push_back(command);
+        }
+    }
+    return 0;
+}
+
+void SpiResponder::respond(const struct iovec *mosi, int mosi_count, const struct iovec *miso,
+                           int miso_count, size_t size) {
+    enum { DECODING, CANNED, READING, WRITING } phase = DECODING;
+    IovCursor in(mosi, mosi_count), out(miso, miso_count);
+    uint8_t command[max_command_bytes];
+    unsigned int command_size = 0;
+    const Command *canned = nullptr;
+    size_t response_idx = 0;
+    unsigned int address = 0;
+
+    // Full duplex: each miso byte only depends on the mosi bytes before it
+    for (size_t idx = 0; idx < size; idx++) {
+        switch (phase) {
+        case DECODING:
+        case WRITING:
+            out.put(status);
+            break;
+        case CANNED:
+            out.put(response_idx < canned->response.size() ? canned->response[response_idx++]
+                                                            : 0);
+            break;
+        case READING:
+            out.put(registers[address].load(memory_order_relaxed));
+            if (auto_increment)
+                address = (address + 1) & address_mask;
+            break;
+        }
+
+        uint8_t byte = in.get();
+        if (phase == WRITING) {
+            if (!read_only[address])
+                registers[address].store(byte, memory_order_relaxed);
+            if (auto_increment)
+                address = (address + 1) & address_mask;
+            continue;
+        }
+        if (phase != DECODING)
+            continue;
+
+        // Waits for the canned commands starting like this one
+        command[command_size++] = byte;
+        bool pending = false;
+        for (const Command &candidate : commands) {
+            if (candidate.match.size() < command_size ||
+                memcmp(candidate.match.data(), command, command_size))
+                continue;
+            if (candidate.match.size() == command_size) {
+                canned = &candidate;
+                break;
+            }
+            pending = true;
+        }
+        if (canned) {
+            phase = CANNED;
+            continue;
+        }
+        if (pending)
+            continue;
+
+        // A register access, the bytes decoded past the command are written
+        address = command[0] & address_mask;
+        phase = command[0] & read_mask ? READING : WRITING;
+        for (unsigned int written = 1; written < command_size && phase == WRITING; written++) {
+            if (!read_only[address])
+                registers[address].store(command[written], memory_order_relaxed);
+            if (auto_increment)
+                address = (address + 1) & address_mask;
+        }
+    }
+}
+
+int SpiResponder::read_registers(unsigned int address, void *buf, size_t size) {
+    if (address + size > (size_t)address_mask + 1)
+        return -EINVAL;
+    for (size_t idx = 0; idx < size; idx++)
+        ((uint8_t *)buf)[idx] = registers[address + idx].load(memory_order_relaxed);
+    return 0;
+}
+
+int SpiResponder::write_registers(unsigned int address, const void *buf, size_t size) {
+    if (address + size > (size_t)address_mask + 1)
+        return -EINVAL;
+    for (size_t idx = 0; idx < size; idx++)
+        registers[address + idx].store(((const uint8_t *)buf)[idx], memory_order_relaxed);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "SimClock.hpp"
+
+#include <hwmocker_internal.h>
+
+#include <sstream>
+#include <stdexcept>
+
+#include <errno.h>
+
+using namespace std;
+using namespace HWMocker;
+
+SimClock::Mode SimClock::mode_from_string(const string &name) {
+    if (name == "real")
+        return Mode::REAL;
+    if (name == "virtual")
+        return Mode::VIRTUAL;
+
+    stringstream reason;
+    reason << "Unknown time mode " << name << endl << get_stacktrace_str(64) << endl;
+    throw new runtime_error(reason.str());
+}
+
+void SimClock::wait_until(uint64_t deadline_ns) {
+    if (mode == Mode::VIRTUAL) {
+        // Skips what the real time did not cover yet, concurrent waits jump
+        // to the latest deadline
+        uint64_t skipped = skipped_ns.load();
+        for (;;) {
+            uint64_t elapsed = clock_now_ns() - start_ns;
+            if (elapsed + skipped >= deadline_ns)
+                return;
+            if (skipped_ns.compare_exchange_weak(skipped, deadline_ns - elapsed))
+                return;
+        }
+    }
+
+    struct timespec ts;
+    for (;;) {
+        uint64_t now = now_ns();
+        if (now >= deadline_ns)
+            return;
+        // Real time deadline, the skipped time only grows in virtual time
+        clock_timespec(clock_now_ns() + deadline_ns - now, &ts);
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != EINTR)
+            return;
+    }
+}
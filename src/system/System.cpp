@@ -3,10 +3,12 @@
 
 #include <hwmocker_internal.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <regex>
 #include <stdexcept>
+#include <unordered_map>
 
 using namespace std;
 using namespace HWMocker;
@@ -31,6 +33,8 @@ System::System(const char *hwmcnf, int (*host_main)(void *), void *host_arg,
     soc->set_dest_processing_unit(host);
     host->set_main_function(host_main);
     host->set_main_arg(host_arg);
+    soc->set_sim_clock(&sim_clock);
+    host->set_sim_clock(&sim_clock);
 
     std::ifstream f(hwmcnf);
     if (!f) {
@@ -40,13 +44,55 @@ System::System(const char *hwmcnf, int (*host_main)(void *), void *host_arg,
     }
     config = json::parse(f);
     load_config(config["system"]);
+    net_graph.compile();
+#ifdef CONFIG_HWMOCK_SPI
+    // Once the nets hold the levels
+    for (ProcessingUnit *processing_unit : {host, soc})
+        for (SpiDevice *spi_dev : processing_unit->spi_devs)
+            spi_dev->release_chip_selects();
+#endif
+    if (config["system"].contains("waveform")) {
+        rc = setup_waveform(config["system"]["waveform"]);
+        if (rc) {
+            stringstream reason;
+            reason << "Waveform setup failed with " << strerror(-rc) << endl
+                   << get_stacktrace_str(64) << endl;
+            throw new runtime_error(reason.str());
+        }
+    }
+#ifdef CONFIG_HWMOCK_SPI
+    if (config["system"].contains("spi-capture")) {
+        rc = setup_spi_capture(config["system"]["spi-capture"]);
+        if (rc) {
+            stringstream reason;
+            reason << "Spi capture setup failed with " << strerror(-rc) << endl
+                   << get_stacktrace_str(64) << endl;
+            throw new runtime_error(reason.str());
+        }
+    }
+#endif
 }
 
 /// @brief Destroy a system
 System::~System() {
     stop();
+#ifdef CONFIG_HWMOCK_SPI
+    // A dma engine may wait on the spi devices of the other processing unit
+    for (ProcessingUnit *processing_unit : {host, soc})
+        for (DmaController *dma : processing_unit->dmas)
+            dma->stop();
+#endif
+#ifdef CONFIG_HWMOCK_MAILBOX
+    // Before the irq controllers of their endpoints
+    for (Mailbox *mailbox : mailboxes)
+        delete mailbox;
+#endif
     delete soc;
     delete host;
+    delete waveform;
+#ifdef CONFIG_HWMOCK_SPI
+    delete spi_capture;
+#endif
 }
 
 /// @brief Loads a json configuration and build
@@ -56,6 +102,22 @@ System::~System() {
 int System::load_config(json config) {
 
     int rc;
+    if (config.contains("irq-delivery")) {
+        IrqController::Delivery delivery =
+            IrqController::delivery_from_string(config["irq-delivery"]);
+        soc->get_irq_controller()->set_delivery(delivery);
+        host->get_irq_controller()->set_delivery(delivery);
+    }
+
+    if (config.contains("time"))
+        sim_clock.set_mode(SimClock::mode_from_string(config["time"]));
+
+    if (config.contains("bottom-half")) {
+        Workqueue::Context context = Workqueue::context_from_string(config["bottom-half"]);
+        soc->get_workqueue()->set_context(context);
+        host->get_workqueue()->set_context(context);
+    }
+
     printf("Loading the soc config...\n");
     rc = soc->load_config(config["soc"]);
     if (rc)
@@ -87,23 +149,261 @@ int System::load_config(json config) {
                 printf("Connection %d -> %d\n", soc_pin->pin_idx, host_pin->pin_idx);
                 soc_pin->connect(host_pin);
                 host_pin->connect(soc_pin);
+                net_graph.add_net(connection, {host_pin, soc_pin}, {host_pin, soc_pin});
             }
         } else
             printf("%s doesn't match\n", connection.c_str());
     }
 
+    // Multi-drop nets: {"name": "reset", "drivers": ["host:101"], "receivers": ["soc:1"]}
+    if (config.contains("nets")) {
+        for (json net : config["nets"]) {
+            vector<Pin *> pins[2];
+            const char *roles[2] = {"drivers", "receivers"};
+            bool found = true;
+            for (int role = 0; role < 2; role++) {
+                for (string pin_name : net.value(roles[role], json::array())) {
+                    Pin *pin = get_pin(pin_name);
+                    if (!pin) {
+                        printf("Net %s: pin %s not found\n", net.value("name", "").c_str(),
+                               pin_name.c_str());
+                        found = false;
+                    }
+                    pins[role].push_back(pin);
+                }
+            }
+            if (!found)
+                continue;
+            for (Pin *driver : pins[0])
+                for (Pin *receiver : pins[1])
+                    if (driver != receiver)
+                        driver->connect(receiver);
+            net_graph.add_net(net.value("name", ""), pins[0], pins[1]);
+        }
+    }
+
+    if (config.contains("host-soc-port-connections")) {
+        for (string connection : config["host-soc-port-connections"]) {
+            regex re("^([0-9]+):([0-9]+)$");
+            smatch m;
+            if (!regex_match(connection, m, re)) {
+                printf("%s doesn't match\n", connection.c_str());
+                continue;
+            }
+            GpioPort *host_port = host->get_gpio_port(stoi(m[1].str()));
+            GpioPort *soc_port = soc->get_gpio_port(stoi(m[2].str()));
+            if (!host_port || !soc_port) {
+                printf("Port connection %s: port not found\n", connection.c_str());
+                continue;
+            }
+            if (host_port->connect(soc_port))
+                printf("Port connection %s: widths differ\n", connection.c_str());
+        }
+    }
+
+#ifdef CONFIG_HWMOCK_SPI
+    connect_spi_devices();
+#endif
+#ifdef CONFIG_HWMOCK_UART
+    connect_uarts();
+#endif
+#ifdef CONFIG_HWMOCK_I2C
+    connect_i2c_devices();
+#endif
+#ifdef CONFIG_HWMOCK_MAILBOX
+    if (config.contains("host-soc-mailboxes")) {
+        rc = setup_mailboxes(config["host-soc-mailboxes"]);
+        if (rc)
+            return rc;
+    }
+#endif
+    return 0;
+}
+
 #ifdef CONFIG_HWMOCK_SPI
-    // Connect the spi devices
-    for (SpiDevice *host_spi : host->spi_devs) {
-        for (SpiDevice *soc_spi : soc->spi_devs) {
-            if (host_spi->set_remote(soc_spi)) {
-                assert(soc_spi->set_remote(host_spi));
-                printf("Host spi %d connected to soc spi %d\n", host_spi->get_spi_index(),
-                       soc_spi->get_spi_index());
+/// Resolves the targets of the spi masters once: the slaves whose csn pin is
+/// connected to a chip select of the master
+void System::connect_spi_devices() {
+    unordered_map<Pin *, SpiDevice *> slaves;
+    vector<SpiDevice *> masters;
+
+    for (ProcessingUnit *processing_unit : {host, soc}) {
+        for (SpiDevice *spi_dev : processing_unit->spi_devs) {
+            if (spi_dev->is_master_device())
+                masters.push_back(spi_dev);
+            else
+                slaves[spi_dev->get_csn()] = spi_dev;
+        }
+    }
+
+    for (SpiDevice *master : masters) {
+        for (unsigned int cs = 0; cs < master->get_chip_selects(); cs++) {
+            for (Pin *pin : master->get_csn(cs)->get_connected_pins()) {
+                auto it = slaves.find(pin);
+                if (it == slaves.end() || !master->connect_target(cs, it->second))
+                    continue;
+                printf("Spi %d chip select %u connected to spi %d\n", master->get_spi_index(), cs,
+                       it->second->get_spi_index());
+                break;
             }
         }
     }
+}
+
+/// @brief Logs the spi transactions into a memory mapped file:
+/// {"file": "spi.cap", "size-kb": 65536}
+/// @param config spi capture json configuration
+/// @return 0 on success
+int System::setup_spi_capture(json config) {
+    SpiCapture *capture = new SpiCapture();
+    string path = config["file"];
+    size_t capacity = config.value("size-kb", (size_t)65536) * 1024;
+
+    int rc = capture->open(path, capacity);
+    if (rc) {
+        printf("Spi capture: cannot map %s: %s\n", path.c_str(), strerror(-rc));
+        delete capture;
+        return rc;
+    }
+
+    // Recorded by the slaves, tagged with the processing unit of their master
+    for (ProcessingUnit *processing_unit : {host, soc})
+        for (SpiDevice *spi_dev : processing_unit->spi_devs)
+            spi_dev->set_capture(capture, processing_unit == host ? HWMOCKER_SPI_CAPTURE_HOST
+                                                                  : HWMOCKER_SPI_CAPTURE_SOC);
+    spi_capture = capture;
+    return 0;
+}
+#endif
+
+#ifdef CONFIG_HWMOCK_UART
+/// Links each uart to the one its tx pin drives
+void System::connect_uarts() {
+    for (ProcessingUnit *processing_unit : {host, soc}) {
+        for (UartDevice *uart : processing_unit->uarts) {
+            for (ProcessingUnit *peer_unit : {host, soc}) {
+                for (UartDevice *peer : peer_unit->uarts) {
+                    if (!uart->connect(peer))
+                        continue;
+                    printf("Uart %s:%u tx connected to uart %s:%u\n",
+                           processing_unit == host ? "host" : "soc", uart->get_uart_index(),
+                           peer_unit == host ? "host" : "soc", peer->get_uart_index());
+                }
+            }
+        }
+    }
+}
 #endif
+
+#ifdef CONFIG_HWMOCK_I2C
+/// Puts on the bus of each i2c controller the targets connected to its pins
+void System::connect_i2c_devices() {
+    for (ProcessingUnit *processing_unit : {host, soc}) {
+        for (I2cDevice *controller : processing_unit->i2c_devs) {
+            for (ProcessingUnit *peer_unit : {host, soc}) {
+                for (I2cDevice *target : peer_unit->i2c_devs) {
+                    int attached = controller->attach(target);
+                    if (attached < 0)
+                        continue;
+                    printf("I2c %s:%u bus got %d addresses of i2c %s:%u\n",
+                           processing_unit == host ? "host" : "soc",
+                           controller->get_i2c_index(), attached,
+                           peer_unit == host ? "host" : "soc", target->get_i2c_index());
+                }
+            }
+        }
+    }
+}
+#endif
+
+#ifdef CONFIG_HWMOCK_MAILBOX
+/// @brief Shares mailboxes between the host and the soc:
+/// [{"index": 0, "ring-size": 1048576, "host-irq": 175, "soc-irq": 115}]
+/// @param config mailboxes json configuration
+/// @return 0 on success
+int System::setup_mailboxes(json config) {
+    for (json mailbox_config : config) {
+        Mailbox *mailbox =
+            new Mailbox(host->get_irq_controller(), soc->get_irq_controller());
+        int rc = mailbox->load_config(mailbox_config);
+        if (rc) {
+            printf("Invalid mailbox %s\n", mailbox_config.dump().c_str());
+            delete mailbox;
+            return rc;
+        }
+        mailboxes.push_back(mailbox);
+        host->add_mailbox(mailbox->get_mailbox_index(), mailbox->get_host_endpoint());
+        soc->add_mailbox(mailbox->get_mailbox_index(), mailbox->get_soc_endpoint());
+    }
+    return 0;
+}
+#endif
+
+/// @brief Finds a pin from its "host:<pin>" or "soc:<pin>" name
+/// @return the pin or nullptr if not found
+Pin *System::get_pin(const string &name) {
+    regex re("^(host|soc):([0-9]+)$");
+    smatch m;
+    if (!regex_match(name, m, re))
+        return nullptr;
+
+    ProcessingUnit *processing_unit = m[1].str() == "host" ? host : soc;
+    return processing_unit->get_pin(stoul(m[2].str()));
+}
+
+/// @brief Traces pins and nets into a VCD file:
+/// {"file": "trace.vcd", "pins": ["host:101"], "nets": ["reset"]}
+/// A traced pin follows its own changes and the ones of the nets it receives.
+/// @param config waveform json configuration
+/// @return 0 on success
+int System::setup_waveform(json config) {
+    WaveformRecorder *recorder = new WaveformRecorder();
+    recorder->set_sim_clock(&sim_clock);
+    vector<pair<Pin *, uint32_t>> traces;
+
+    for (string pin_name : config.value("pins", json::array())) {
+        Pin *pin = get_pin(pin_name);
+        if (!pin) {
+            printf("Waveform: pin %s not found\n", pin_name.c_str());
+            continue;
+        }
+        string scope = pin_name.substr(0, pin_name.find(':'));
+        uint32_t signal = recorder->add_signal(scope, "pin" + to_string(pin->pin_idx), pin->get_level());
+        traces.push_back({pin, signal});
+        for (const NetGraph::Net &net : net_graph.get_nets()) {
+            if (find(net.receivers.begin(), net.receivers.end(), pin) == net.receivers.end())
+                continue;
+            for (Pin *driver : net.drivers)
+                if (driver != pin)
+                    traces.push_back({driver, signal});
+        }
+    }
+
+    for (string net_name : config.value("nets", json::array())) {
+        const NetGraph::Net *net = net_graph.find_net(net_name);
+        if (!net) {
+            printf("Waveform: net %s not found\n", net_name.c_str());
+            continue;
+        }
+        // Last writer wins: the receivers hold the net level
+        const vector<Pin *> &pins = net->receivers.empty() ? net->drivers : net->receivers;
+        bool level = !pins.empty() && pins[0]->get_level();
+        uint32_t signal = recorder->add_signal("nets", net_name, level);
+        for (Pin *driver : net->drivers)
+            traces.push_back({driver, signal});
+    }
+
+    string path = config.value("file", "hwmocker.vcd");
+    int rc = recorder->start(path);
+    if (rc) {
+        printf("Waveform: cannot write %s: %s\n", path.c_str(), strerror(-rc));
+        delete recorder;
+        return rc;
+    }
+
+    for (auto &[pin, signal] : traces)
+        pin->add_trace(recorder, signal);
+    waveform = recorder;
     return 0;
 }
 
@@ -0,0 +1,200 @@
+#include "UartDevice.hpp"
+
+#include <hwmocker_internal.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace HWMocker;
+
+// Constructors/Destructors
+UartDevice::UartDevice(IrqController *irq_controller, HwIrq *irq) {
+    if (!irq) {
+        stringstream reason;
+        reason << "Cannot allocate with a null hw irq" << endl << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+
+    this->irq = irq;
+    this->irq_controller = irq_controller;
+    irq->set_handler(uart_irq_handler, this);
+}
+
+UartDevice::~UartDevice() {
+    if (tx)
+        delete tx;
+    if (rx)
+        delete rx;
+    if (irq_controller)
+        irq_controller->unregister_irq(irq);
+    delete irq;
+}
+
+int UartDevice::uart_irq_handler(void *ctx) {
+    UartDevice *uart = (UartDevice *)ctx;
+    unsigned int status = uart->irq_status.exchange(0);
+
+    if (status && uart->handler)
+        return uart->handler(status, uart->handler_ctx);
+    return 0;
+}
+
+int UartDevice::load_config(json config) {
+    uart_index = config["index"];
+    tx = new Gpio(config["tx-pin"]);
+    rx = new Gpio(config["rx-pin"]);
+
+    fifo_depth = config.value("fifo-depth", fifo_depth);
+    if (!fifo_depth || (fifo_depth & (fifo_depth - 1))) {
+        stringstream reason;
+        reason << "uart fifo-depth " << fifo_depth << " is not a power of 2" << endl
+               << get_stacktrace_str(64) << endl;
+        throw new runtime_error(reason.str());
+    }
+    rx_fifo.resize(fifo_depth);
+
+    // Start bit, data bits, parity and stop bits, 8N1 by default
+    baud = config.value("baud", baud);
+    unsigned int frame_bits = 1 + config.value("data-bits", 8) +
+                              (config.value("parity", false) ? 1 : 0) +
+                              config.value("stop-bits", 1);
+    frame_ns = baud ? frame_bits * 1000000000ULL / baud : 0;
+    stats_since_ns.store(now_ns());
+
+    if (config.contains("irq")) {
+        irq->set_irqn(config["irq"]);
+        has_irq = true;
+        if (irq_controller)
+            return irq_controller->register_irq(irq, config["irq"]);
+    }
+    return 0;
+}
+
+bool UartDevice::connect(UartDevice *peer) {
+    if (peer == this || tx_peer || peer->rx_peer)
+        return false;
+
+    vector<Pin *> &pins = tx->get_connected_pins();
+    vector<Pin *> &peer_pins = peer->rx->get_connected_pins();
+    if (find(pins.begin(), pins.end(), peer->rx) == pins.end() &&
+        find(peer_pins.begin(), peer_pins.end(), tx) == peer_pins.end())
+        return false;
+
+    tx_peer = peer;
+    peer->rx_peer = this;
+    return true;
+}
+
+ssize_t UartDevice::write(const void *buf, size_t size) {
+    UartDevice *peer = tx_peer;
+    if (!peer)
+        return -ENOTCONN;
+
+    size = min(size, peer->rx_fifo.capacity() - peer->rx_fifo.level());
+    if (!size)
+        return 0;
+
+    if (frame_ns) {
+        // The line takes the bytes after the previous ones, the writer stays
+        // a fifo depth ahead of it at most
+        uint64_t now = now_ns();
+        uint64_t done_ns = max(tx_done_ns.load(memory_order_relaxed), now) + size * frame_ns;
+        uint64_t ahead_ns = fifo_depth * frame_ns;
+        tx_done_ns.store(done_ns, memory_order_relaxed);
+        if (done_ns - now > ahead_ns && sim_clock)
+            sim_clock->wait_until(done_ns - ahead_ns);
+        stats_busy_ns.fetch_add(size * frame_ns, memory_order_relaxed);
+    }
+
+    size_t written = peer->rx_fifo.write(buf, size);
+    stats_tx_bytes.fetch_add(written, memory_order_relaxed);
+    peer->stats_rx_bytes.fetch_add(written, memory_order_relaxed);
+    peer->raise_rx();
+    return written;
+}
+
+/// Raises the rx event if the level reached the threshold since the reader
+/// rearmed it
+void UartDevice::raise_rx() {
+    if (rx_fifo.level() >= rx_threshold.load() && rx_armed.exchange(false))
+        raise(HWMOCKER_UART_IRQ_RX);
+}
+
+ssize_t UartDevice::read(void *buf, size_t size) {
+    size_t before = rx_fifo.level();
+    size_t count = rx_fifo.read(buf, size);
+    consumed(before, count);
+    return count;
+}
+
+size_t UartDevice::read_span(const void **span) {
+    return rx_fifo.read_span((const uint8_t **)span);
+}
+
+size_t UartDevice::consume(size_t size) {
+    size_t before = rx_fifo.level();
+    size_t count = rx_fifo.consume(size);
+    consumed(before, count);
+    return count;
+}
+
+/// Rearms the rx event below the threshold and tells the writer once its
+/// bytes are all read
+void UartDevice::consumed(size_t before, size_t count) {
+    if (rx_fifo.level() < rx_threshold.load()) {
+        rx_armed.store(true);
+        // The writer may have crossed the threshold meanwhile
+        raise_rx();
+    }
+
+    UartDevice *peer = rx_peer;
+    if (count && count == before && peer)
+        peer->raise(HWMOCKER_UART_IRQ_TX_EMPTY);
+}
+
+int UartDevice::set_irq_handler(unsigned int irq_mask, size_t rx_threshold,
+                                int (*handler)(unsigned int status, void *ctx), void *ctx) {
+    if (!has_irq)
+        return -ENOENT;
+    if (rx_threshold > rx_fifo.capacity())
+        return -EINVAL;
+
+    this->handler_ctx = ctx;
+    this->handler = handler;
+    this->rx_threshold.store(rx_threshold);
+    this->irq_mask.store(irq_mask);
+    if (handler && irq_mask)
+        irq->enable();
+    else
+        irq->disable();
+    // The fifo may hold the threshold already
+    rx_armed.store(true);
+    raise_rx();
+    return 0;
+}
+
+void UartDevice::raise(unsigned int events) {
+    events &= irq_mask.load(memory_order_relaxed);
+    if (events && irq_controller) {
+        irq_status.fetch_or(events);
+        irq_controller->local_raise(irq);
+    }
+}
+
+void UartDevice::get_stats(struct hwmocker_uart_stats *stats) {
+    stats->tx_bytes = stats_tx_bytes.load();
+    stats->rx_bytes = stats_rx_bytes.load();
+    stats->busy_ns = stats_busy_ns.load();
+    // The line may still be sending the bytes already counted busy
+    stats->elapsed_ns = max(now_ns(), tx_done_ns.load()) - stats_since_ns.load();
+}
+
+void UartDevice::reset_stats() {
+    stats_tx_bytes.store(0);
+    stats_rx_bytes.store(0);
+    stats_busy_ns.store(0);
+    stats_since_ns.store(now_ns());
+}
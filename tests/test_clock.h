@@ -0,0 +1,13 @@
+#ifndef __HWMOCKER_TEST_CLOCK_H__
+#define __HWMOCKER_TEST_CLOCK_H__
+
+#include <time.h>
+
+/* Monotonic wall clock, to compare the tests run time with the simulation time */
+static inline unsigned long long wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif /* __HWMOCKER_TEST_CLOCK_H__ */
@@ -4,27 +4,33 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
-#include <unistd.h>
 
 #define SOC_IRQ_NUMBER 5
 #define HOST_IRQ_NUMBER 102
 #define INVALID_PIN_NUMBER 1555
+/* Written by the irq handlers once they ran */
+#define SOC_ACK_PIN 3
+#define HOST_ACK_PIN 104
+#define WAIT_TIMEOUT_US 1000000
 
 #define HOST2SOC_PIN(x) (x - 100)
 #define SOC2HOST_PIN(x) (x + 100)
 
 int soc_irq_triggered;
 int host_irq_triggered;
+void *soc;
+void *host;
 
 int soc_irq_handler(void) {
     printf("%s() called\n", __func__);
     soc_irq_triggered++;
+    hwmocker_set_gpio_level(soc, SOC_ACK_PIN, 1);
     return 0;
 }
 
 int soc_main(void *priv) {
     struct hwmocker *mocker = *((struct hwmocker **)priv);
-    void *soc = hwmocker_get_soc(mocker);
+    soc = hwmocker_get_soc(mocker);
 
     printf("%s(%p) called\n", __func__, (void *)mocker);
     /* Invalid gpio should fail with -EINVAL */
@@ -44,20 +50,24 @@ int soc_main(void *priv) {
     /* Invalid gpio should have no effect */
     hwmocker_set_gpio_level(soc, INVALID_PIN_NUMBER, 1);
 
-    /* wait 10ms here to let the signals to be handled */
-    usleep(10000);
+    /* wait for both handlers */
+    rc = hwmocker_gpio_wait_level(soc, SOC_ACK_PIN, 1, WAIT_TIMEOUT_US);
+    assert(rc == 0);
+    rc = hwmocker_gpio_wait_level(soc, HOST2SOC_PIN(HOST_ACK_PIN), 1, WAIT_TIMEOUT_US);
+    assert(rc == 0);
     return 0;
 }
 
 int host_irq_handler(void) {
     printf("%s() called\n", __func__);
     host_irq_triggered++;
+    hwmocker_set_gpio_level(host, HOST_ACK_PIN, 1);
     return 0;
 }
 
 int host_main(void *priv) {
     struct hwmocker *mocker = *((struct hwmocker **)priv);
-    void *host = hwmocker_get_host(mocker);
+    host = hwmocker_get_host(mocker);
 
     printf("%s(%p) called\n", __func__, (void *)mocker);
 
@@ -72,8 +82,11 @@ int host_main(void *priv) {
     /* Invalid gpio should have no effect */
     hwmocker_set_gpio_level(host, INVALID_PIN_NUMBER, 1);
 
-    /* wait 10ms here to let the signals to be handled */
-    usleep(10000);
+    /* wait for both handlers */
+    rc = hwmocker_gpio_wait_level(host, HOST_ACK_PIN, 1, WAIT_TIMEOUT_US);
+    assert(rc == 0);
+    rc = hwmocker_gpio_wait_level(host, SOC2HOST_PIN(SOC_ACK_PIN), 1, WAIT_TIMEOUT_US);
+    assert(rc == 0);
     return 0;
 }
 
@@ -0,0 +1,97 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "test_wait.h"
+
+/* Pins from the config */
+#define RESET_DRIVER 103
+#define RESET_HOST_RECEIVER 104
+#define RESET_RECEIVER 3
+#define RESET_IRQ_RECEIVER_0 4
+#define RESET_IRQ_RECEIVER_1 5
+#define BUS_HOST 106
+#define BUS_SOC 6
+#define BUS_SOC_RECEIVER 7
+#define WAIT_TIMEOUT_US 1000000
+
+/* Set once the soc drove the bus, its receivers included */
+volatile int bus_driven;
+volatile int reset_irqs;
+
+int reset_irq_handler(void) {
+    __atomic_fetch_add(&reset_irqs, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+
+    assert(hwmocker_set_gpio_irq_handler(soc, RESET_IRQ_RECEIVER_0, reset_irq_handler) == 0);
+    assert(hwmocker_set_gpio_irq_handler(soc, RESET_IRQ_RECEIVER_1, reset_irq_handler) == 0);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    /* One driver, every receiver follows and the irq ones are raised */
+    assert(hwmocker_gpio_wait_level(soc, RESET_RECEIVER, 1, WAIT_TIMEOUT_US) == 0);
+    WAIT_UNTIL(reset_irqs == 2);
+    assert(hwmocker_get_gpio_level(soc, RESET_IRQ_RECEIVER_0));
+    assert(hwmocker_get_gpio_level(soc, RESET_IRQ_RECEIVER_1));
+
+    /* A receiver does not drive the net */
+    hwmocker_set_gpio_level(soc, RESET_RECEIVER, 0);
+    /* Both ends of the bus drive it */
+    hwmocker_set_gpio_level(soc, BUS_SOC, 1);
+    assert(hwmocker_get_gpio_level(soc, BUS_SOC_RECEIVER));
+    bus_driven = 1;
+
+    assert(hwmocker_gpio_wait_level(soc, BUS_SOC, 0, WAIT_TIMEOUT_US) == 0);
+    assert(hwmocker_gpio_wait_level(soc, BUS_SOC_RECEIVER, 0, WAIT_TIMEOUT_US) == 0);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    hwmocker_set_gpio_level(host, RESET_DRIVER, 1);
+    assert(hwmocker_get_gpio_level(host, RESET_HOST_RECEIVER));
+
+    /* The bus level shows before the soc drove all its receivers */
+    WAIT_UNTIL(bus_driven);
+    assert(hwmocker_get_gpio_level(host, RESET_DRIVER));
+    assert(hwmocker_get_gpio_level(host, BUS_HOST));
+    hwmocker_set_gpio_level(host, BUS_HOST, 0);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "test_wait.h"
+
+#define IRQ_PORT 0
+#define NARROW_PORT 1
+#define IRQ_PINS 0xf0ULL
+/* Irq line of the soc port, from the config */
+#define PORT_IRQ 40
+/* Both sides toggle pin 9 concurrently, the host pin 8 and the soc pin 10 */
+#define HOST_TOGGLES 0x300ULL
+#define SOC_TOGGLES 0x600ULL
+#define NR_TOGGLES 10000
+
+volatile int phase;
+volatile uint64_t irq_changed;
+
+int port_irq_handler(uint64_t changed) {
+    irq_changed |= changed;
+    return 0;
+}
+
+/* Raises of the soc port irq */
+static unsigned long long port_irq_raised(void *soc) {
+    struct hwmocker_irq_stats stats;
+
+    assert(hwmocker_get_irq_stats(soc, PORT_IRQ, &stats) == 0);
+    return stats.raised;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    void *port = hwmocker_get_gpio_port(soc, IRQ_PORT);
+    void *narrow_port = hwmocker_get_gpio_port(soc, NARROW_PORT);
+
+    assert(port && narrow_port);
+    assert(!hwmocker_get_gpio_port(soc, 2));
+    assert(hwmocker_gpio_port_set_irq_handler(narrow_port, 1, port_irq_handler) == -ENOENT);
+    assert(hwmocker_gpio_port_set_irq_handler(port, IRQ_PINS, port_irq_handler) == 0);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    /* Whole banks propagate at once */
+    WAIT_UNTIL(phase == 1);
+    assert(hwmocker_gpio_port_read(port) == 0xff00ULL);
+    assert(hwmocker_gpio_port_read(narrow_port) == 0xffffffffULL);
+    phase = 2;
+
+    WAIT_UNTIL(phase == 3);
+    assert(hwmocker_gpio_port_read(port) == 0x00ffULL);
+    WAIT_UNTIL(irq_changed == IRQ_PINS);
+    unsigned long long raised = port_irq_raised(soc);
+    assert(raised);
+    phase = 4;
+
+    /* Only the irq pins raise the port irq */
+    WAIT_UNTIL(phase == 5);
+    assert(hwmocker_gpio_port_read(port) == 0xf0000000000000f0ULL);
+    assert(port_irq_raised(soc) == raised);
+    phase = 6;
+
+    /* Both sides see the concurrent toggles in the same order */
+    for (int idx = 0; idx <= NR_TOGGLES; idx++)
+        hwmocker_gpio_port_toggle_mask(port, SOC_TOGGLES);
+    WAIT_UNTIL(phase == 7);
+    assert(hwmocker_gpio_port_read(port) == (0xf0000000000000f0ULL | 0x600ULL));
+    phase = 8;
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *port = hwmocker_get_gpio_port(host, IRQ_PORT);
+    void *narrow_port = hwmocker_get_gpio_port(host, NARROW_PORT);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    hwmocker_gpio_port_set_mask(port, 0xff00ULL);
+    /* Pins out of the port width are ignored */
+    hwmocker_gpio_port_set_mask(narrow_port, UINT64_MAX);
+    assert(hwmocker_gpio_port_read(narrow_port) == 0xffffffffULL);
+    phase = 1;
+
+    WAIT_UNTIL(phase == 2);
+    hwmocker_gpio_port_toggle_mask(port, 0xffffULL);
+    phase = 3;
+
+    WAIT_UNTIL(phase == 4);
+    hwmocker_gpio_port_clear_mask(port, 0x0fULL);
+    hwmocker_gpio_port_set_mask(port, 0xf000000000000000ULL);
+    hwmocker_gpio_port_clear_mask(port, 0xf000000000000000ULL);
+    hwmocker_gpio_port_set_mask(port, 0xf000000000000000ULL);
+    phase = 5;
+
+    WAIT_UNTIL(phase == 6);
+    for (int idx = 0; idx < NR_TOGGLES; idx++)
+        hwmocker_gpio_port_toggle_mask(port, HOST_TOGGLES);
+    phase = 7;
+
+    WAIT_UNTIL(phase == 8);
+    assert(hwmocker_gpio_port_read(port) == (0xf0000000000000f0ULL | 0x600ULL));
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Pins and trace file from the config */
+#define HOST_PIN 101
+#define RESET_DRIVER 103
+#define VCD_FILE "test_gpio_waveform.vcd"
+/* VCD ids of the traced soc pin and reset net */
+#define SOC_PIN_ID "!"
+#define RESET_ID "\""
+#define TOGGLES 5
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    hwmocker_set_gpio_level(host, RESET_DRIVER, 1);
+    for (int toggle = 0; toggle < TOGGLES; toggle++) {
+        hwmocker_set_gpio_level(host, HOST_PIN, 1);
+        hwmocker_set_gpio_level(host, HOST_PIN, 0);
+    }
+    hwmocker_set_gpio_level(host, RESET_DRIVER, 0);
+    return 0;
+}
+
+/* Checks the transitions recorded after the initial values */
+static void check_vcd(void) {
+    FILE *vcd = fopen(VCD_FILE, "r");
+    char line[256];
+    int definitions = 0, dumpvars = 0, pin_changes = 0, reset_changes = 0;
+    unsigned long time = 0, last_time = 0;
+
+    assert(vcd);
+    while (fgets(line, sizeof(line), vcd)) {
+        line[strcspn(line, "\n")] = 0;
+        if (!strcmp(line, "$enddefinitions $end"))
+            definitions = 1;
+        else if (!strcmp(line, "$dumpvars"))
+            dumpvars = 1;
+        else if (!strcmp(line, "$end"))
+            dumpvars = 0;
+        else if (line[0] == '#') {
+            time = strtoul(line + 1, NULL, 10);
+            assert(time >= last_time);
+            last_time = time;
+        } else if (definitions && !dumpvars) {
+            if (!strcmp(line + 1, SOC_PIN_ID))
+                pin_changes++;
+            else if (!strcmp(line + 1, RESET_ID))
+                reset_changes++;
+        }
+    }
+    fclose(vcd);
+
+    printf("%d pin and %d reset changes traced\n", pin_changes, reset_changes);
+    assert(definitions);
+    assert(pin_changes == 2 * TOGGLES);
+    assert(reset_changes == 2);
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    /* Flushes the trace */
+    hwmocker_destroy(mocker);
+    check_vcd();
+
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,237 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_clock.h"
+
+#define HOST_I2C_IDX 0
+#define SOC_I2C_IDX 2
+/* From the config: a register mapped sensor and a fifo sensor on the host target */
+#define REGS_ADDR 0x48
+#define FIFO_ADDR 0x1d
+#define ABSENT_ADDR 0x50
+#define CLK_HZ 400000ULL
+#define REGS_COUNT 16
+#define FIFO_SAMPLE 6
+#define FIFO_STRETCH_NS 50000ULL
+/* Bits of a transfer: start, address and ack, 9 bits a byte, stop */
+#define MSG_BITS(len) (1 + 9 + 9 * (len))
+#define BITS_NS(bits) ((bits) * 1000000000ULL / CLK_HZ)
+#define POLLS 10000
+/* The virtual time skips the 3.5s of the polling loop */
+#define MAX_WALL_NS 2000000000ULL
+
+unsigned char regs[REGS_COUNT];
+unsigned int reg_ptr;
+int regs_stops;
+unsigned char fifo_next;
+/* The ctx of the alternate binding the host swaps in while the soc polls */
+const int alt_tag;
+int polls_done;
+
+/* The first byte written sets the register pointer, the next ones the registers */
+int regs_write(void *ctx, const unsigned char *buf, size_t size) {
+    (void)ctx;
+    assert(!ctx);
+    for (size_t idx = 0; idx < size; idx++) {
+        if (!idx) {
+            if (buf[idx] >= REGS_COUNT)
+                return 0;
+            reg_ptr = buf[idx];
+        } else {
+            regs[reg_ptr++ % REGS_COUNT] = buf[idx];
+        }
+    }
+    return size;
+}
+
+int regs_read(void *ctx, unsigned char *buf, size_t size) {
+    (void)ctx;
+    assert(!ctx);
+    for (size_t idx = 0; idx < size; idx++)
+        buf[idx] = regs[reg_ptr++ % REGS_COUNT];
+    return size;
+}
+
+void regs_stop(void *ctx) {
+    (void)ctx;
+    assert(!ctx);
+    regs_stops++;
+}
+
+/* Read only, a sample at most, the clock is stretched while it is sampled */
+int fifo_read(void *ctx, unsigned char *buf, size_t size) {
+    hwmocker_i2c_stretch(ctx, FIFO_STRETCH_NS);
+    size = size < FIFO_SAMPLE ? size : FIFO_SAMPLE;
+    for (size_t idx = 0; idx < size; idx++)
+        buf[idx] = fifo_next++;
+    return size;
+}
+
+/* The same registers, only reachable with the alternate ctx */
+int alt_write(void *ctx, const unsigned char *buf, size_t size) {
+    assert(ctx == &alt_tag);
+    return regs_write(NULL, buf, size);
+}
+
+int alt_read(void *ctx, unsigned char *buf, size_t size) {
+    assert(ctx == &alt_tag);
+    return regs_read(NULL, buf, size);
+}
+
+void alt_stop(void *ctx) {
+    assert(ctx == &alt_tag);
+    regs_stop(NULL);
+}
+
+const struct hwmocker_i2c_target_ops regs_ops = {regs_write, regs_read, NULL, regs_stop};
+const struct hwmocker_i2c_target_ops alt_ops = {alt_write, alt_read, NULL, alt_stop};
+const struct hwmocker_i2c_target_ops fifo_ops = {NULL, fifo_read, NULL, NULL};
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    void *i2c_dev = hwmocker_get_i2c_device(soc, SOC_I2C_IDX);
+    struct hwmocker_i2c_stats stats;
+    unsigned char reg = 3, value, sample[FIFO_SAMPLE + 2];
+    unsigned char set[] = {reg, 0xa5, 0x5a};
+    unsigned long long start_ns, wall_start_ns;
+    int rc;
+
+    assert(i2c_dev);
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+    hwmocker_i2c_reset_stats(i2c_dev);
+
+    /* Writes two registers, then reads the second one back after a repeated start */
+    struct hwmocker_i2c_msg write = {REGS_ADDR, 0, sizeof(set), set};
+    start_ns = hwmocker_get_time_ns(mocker);
+    rc = hwmocker_i2c_transfer(i2c_dev, &write, 1);
+    assert(rc == 1);
+    assert(hwmocker_get_time_ns(mocker) - start_ns >= BITS_NS(MSG_BITS(sizeof(set)) + 1));
+    reg = 4;
+    struct hwmocker_i2c_msg read_reg[] = {{REGS_ADDR, 0, 1, &reg},
+                                          {REGS_ADDR, HWMOCKER_I2C_M_RD, 1, &value}};
+    rc = hwmocker_i2c_transfer(i2c_dev, read_reg, 2);
+    assert(rc == 2);
+    assert(value == 0x5a);
+    assert(regs_stops == 2);
+    assert(hwmocker_i2c_xfer_duration_ns(i2c_dev, read_reg, 2) ==
+           BITS_NS(MSG_BITS(1) + MSG_BITS(1) + 1));
+
+    /* Not acknowledged: the absent address, the register out of the map */
+    struct hwmocker_i2c_msg absent = {ABSENT_ADDR, HWMOCKER_I2C_M_RD, 1, &value};
+    rc = hwmocker_i2c_transfer(i2c_dev, &absent, 1);
+    assert(rc == -ENXIO);
+    reg = REGS_COUNT;
+    rc = hwmocker_i2c_transfer(i2c_dev, read_reg, 2);
+    assert(rc == -EIO);
+    /* No write callback */
+    struct hwmocker_i2c_msg fifo_write = {FIFO_ADDR, 0, 1, &reg};
+    rc = hwmocker_i2c_transfer(i2c_dev, &fifo_write, 1);
+    assert(rc == -EIO);
+
+    /* A sample then the released bus, the clock stretched by the target */
+    struct hwmocker_i2c_msg fifo_read = {FIFO_ADDR, HWMOCKER_I2C_M_RD, sizeof(sample), sample};
+    start_ns = hwmocker_get_time_ns(mocker);
+    rc = hwmocker_i2c_transfer(i2c_dev, &fifo_read, 1);
+    assert(rc == 1);
+    assert(hwmocker_get_time_ns(mocker) - start_ns >=
+           BITS_NS(MSG_BITS(sizeof(sample)) + 1) + FIFO_STRETCH_NS);
+    for (int idx = 0; idx < FIFO_SAMPLE; idx++)
+        assert(sample[idx] == idx);
+    assert(sample[FIFO_SAMPLE] == 0xff && sample[FIFO_SAMPLE + 1] == 0xff);
+
+    /* Polls both sensors */
+    hwmocker_i2c_reset_stats(i2c_dev);
+    wall_start_ns = wall_ns();
+    reg = 3;
+    for (int poll = 0; poll < POLLS; poll++) {
+        rc = hwmocker_i2c_transfer(i2c_dev, read_reg, 2);
+        assert(rc == 2);
+        assert(value == 0xa5);
+        rc = hwmocker_i2c_transfer(i2c_dev, &fifo_read, 1);
+        assert(rc == 1);
+        assert(sample[0] == (unsigned char)((poll + 1) * FIFO_SAMPLE));
+        /* Lets the host rebind the registers between the polls */
+        sched_yield();
+    }
+    assert(wall_ns() - wall_start_ns < MAX_WALL_NS);
+    __atomic_store_n(&polls_done, 1, __ATOMIC_RELEASE);
+
+    rc = hwmocker_i2c_get_stats(i2c_dev, &stats);
+    assert(rc == 0);
+    assert(stats.transfers == 2 * POLLS);
+    assert(stats.messages == 3 * POLLS);
+    assert(stats.bytes == (2 + sizeof(sample)) * POLLS);
+    assert(stats.nacks == 0);
+    assert(stats.busy_ns ==
+           POLLS * (BITS_NS(MSG_BITS(1) + MSG_BITS(1) + 1) +
+                    BITS_NS(MSG_BITS(sizeof(sample)) + 1) + FIFO_STRETCH_NS));
+    assert(stats.elapsed_ns >= stats.busy_ns);
+    printf("%s - %d polls in %llu ns, bus utilization %.1f%%\n", __func__, POLLS,
+           stats.elapsed_ns, 100.0 * stats.busy_ns / stats.elapsed_ns);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *i2c_dev = hwmocker_get_i2c_device(host, HOST_I2C_IDX);
+    struct hwmocker_i2c_msg msg = {REGS_ADDR, 0, 0, NULL};
+    unsigned long rebinds = 0;
+    int rc;
+
+    rc = hwmocker_i2c_set_target(i2c_dev, ABSENT_ADDR, &regs_ops, NULL);
+    assert(rc == -ENOENT);
+    rc = hwmocker_i2c_set_target(i2c_dev, REGS_ADDR, &regs_ops, NULL);
+    assert(rc == 0);
+    rc = hwmocker_i2c_set_target(i2c_dev, FIFO_ADDR, &fifo_ops, i2c_dev);
+    assert(rc == 0);
+    rc = hwmocker_i2c_transfer(i2c_dev, &msg, 1);
+    assert(rc == -ENOTCONN);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    /* Rebinds the registers while they are polled, a callback never sees the other ctx */
+    while (!__atomic_load_n(&polls_done, __ATOMIC_ACQUIRE)) {
+        if (rebinds++ & 1)
+            rc = hwmocker_i2c_set_target(i2c_dev, REGS_ADDR, &regs_ops, NULL);
+        else
+            rc = hwmocker_i2c_set_target(i2c_dev, REGS_ADDR, &alt_ops, (void *)&alt_tag);
+        assert(rc == 0);
+        sched_yield();
+    }
+    printf("%s - %lu rebinds while polled\n", __func__, rebinds);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(fifo_next == (unsigned char)((POLLS + 1) * FIFO_SAMPLE));
+    printf("That's all folks!!!\n");
+    return 0;
+}
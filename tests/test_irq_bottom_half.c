@@ -0,0 +1,88 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#define __USE_GNU 1
+#include <pthread.h>
+
+#include "test_wait.h"
+
+#define SOC_IRQ_NUMBER 5
+
+#define SOC2HOST_PIN(x) (x + 100)
+
+volatile int soc_irq_triggered;
+pthread_t soc_thread;
+
+int soc_irq_handler(void) {
+    /* Out of the signal handler, printf is fine */
+    printf("%s() called\n", __func__);
+    assert(pthread_equal(pthread_self(), soc_thread));
+    soc_irq_triggered++;
+    return 0;
+}
+
+/* Top half runs of the irq */
+static unsigned long long soc_irq_delivered(void *soc) {
+    struct hwmocker_irq_stats stats;
+
+    assert(hwmocker_get_irq_stats(soc, SOC_IRQ_NUMBER, &stats) == 0);
+    return stats.delivered;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+
+    soc_thread = pthread_self();
+    assert(hwmocker_set_gpio_irq_handler(soc, SOC_IRQ_NUMBER, soc_irq_handler) == 0);
+    assert(hwmocker_set_irq_bottom_half(soc, HWMOCK_IRQ_LINES, true) == -EINVAL);
+    assert(hwmocker_set_irq_bottom_half(soc, SOC_IRQ_NUMBER, true) == 0);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    /* The top half ran, the bottom half waits for a check point */
+    WAIT_UNTIL(soc_irq_delivered(soc) == 1);
+    assert(soc_irq_triggered == 0);
+    hwmocker_poll_irqs(soc);
+    assert(soc_irq_triggered == 1);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(SOC_IRQ_NUMBER), 1);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <hwmocker/hwmocker.h>
+#include <hwmocker/irq.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define SOC_IRQ_NUMBER 5
+#define SOC_COALESCED_IRQ_NUMBER 6
+#define TOGGLES 1000
+#define IRQ_TIMEOUT_US 1000000
+
+#define SOC2HOST_PIN(x) (x + 100)
+
+int soc_irq_triggered;
+int soc_coalesced_irq_triggered;
+int toggles_done;
+
+int soc_irq_handler(void) {
+    soc_irq_triggered++;
+    return 0;
+}
+
+int soc_coalesced_irq_handler(void) {
+    soc_coalesced_irq_triggered++;
+    return 0;
+}
+
+static void check_latency(void *soc, unsigned int irqn, unsigned long long delivered) {
+    struct hwmocker_irq_latency latency;
+    int rc = hwmocker_get_irq_latency(soc, irqn, &latency);
+    assert(rc == 0);
+    assert(latency.count == delivered);
+    assert(latency.min <= latency.p50 && latency.p50 <= latency.p90);
+    assert(latency.p90 <= latency.p99 && latency.p99 <= latency.p999);
+    assert(latency.p999 <= latency.max && latency.mean <= latency.max);
+}
+
+static void wait_all_raises_handled(void *soc, unsigned int irqn) {
+    struct hwmocker_irq_stats stats;
+    int rc;
+
+    for (;;) {
+        rc = hwmocker_get_irq_stats(soc, irqn, &stats);
+        assert(rc == 0);
+        if (stats.delivered + stats.merged == TOGGLES)
+            break;
+        rc = hwmocker_wait_irq(soc, IRQ_TIMEOUT_US);
+        assert(rc == 0);
+    }
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    struct hwmocker_irq_stats stats;
+
+    int rc = hwmocker_set_gpio_irq_handler(soc, SOC_IRQ_NUMBER, soc_irq_handler);
+    assert(rc == 0);
+    rc = hwmocker_set_gpio_irq_handler(soc, SOC_COALESCED_IRQ_NUMBER, soc_coalesced_irq_handler);
+    assert(rc == 0);
+
+    /* max-events without max-delay would never deliver a partial batch */
+    rc = hwmocker_set_irq_coalescing(soc, SOC_IRQ_NUMBER, 4, 0);
+    assert(rc == -EINVAL);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    wait_all_raises_handled(soc, SOC_IRQ_NUMBER);
+    wait_all_raises_handled(soc, SOC_COALESCED_IRQ_NUMBER);
+
+    rc = hwmocker_get_irq_stats(soc, SOC_COALESCED_IRQ_NUMBER, &stats);
+    assert(rc == 0);
+    printf("%s: coalesced irq raised %llu delivered %llu merged %llu polled %llu\n", __func__,
+           stats.raised, stats.delivered, stats.merged, stats.polled);
+    assert(stats.raised == TOGGLES);
+    assert(stats.delivered == (unsigned long long)soc_coalesced_irq_triggered);
+    /* At most one run per max-events raises, plus the ones flushed by max-delay */
+    assert(stats.delivered < TOGGLES / 2);
+
+    rc = hwmocker_get_irq_stats(soc, SOC_IRQ_NUMBER, &stats);
+    assert(rc == 0);
+    printf("%s: irq raised %llu delivered %llu merged %llu polled %llu\n", __func__,
+           stats.raised, stats.delivered, stats.merged, stats.polled);
+    assert(stats.raised == TOGGLES);
+    assert(stats.delivered == (unsigned long long)soc_irq_triggered);
+    assert(stats.delivered + stats.merged == TOGGLES);
+
+    check_latency(soc, SOC_IRQ_NUMBER, stats.delivered);
+    rc = hwmocker_get_irq_stats(soc, SOC_COALESCED_IRQ_NUMBER, &stats);
+    assert(rc == 0);
+    check_latency(soc, SOC_COALESCED_IRQ_NUMBER, stats.delivered);
+    hwmocker_dump_irq_latencies(soc, stdout);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    for (int toggle = 0; toggle < TOGGLES; toggle++) {
+        hwmocker_set_gpio_level(host, SOC2HOST_PIN(SOC_IRQ_NUMBER), !(toggle & 1));
+        hwmocker_set_gpio_level(host, SOC2HOST_PIN(SOC_COALESCED_IRQ_NUMBER), !(toggle & 1));
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <hwmocker/hwmocker.h>
+#include <hwmocker/irq.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define __USE_GNU 1
+#include <pthread.h>
+
+#define SOC_IRQ_NUMBER 5
+#define HOST_IRQ_NUMBER 102
+#define IRQ_TIMEOUT_US 1000000
+
+#define HOST2SOC_PIN(x) (x - 100)
+#define SOC2HOST_PIN(x) (x + 100)
+
+int soc_irq_triggered;
+int host_irq_triggered;
+
+/* With the doorbell delivery, the handlers run on their processing unit thread */
+static void check_thread(const char *expected) {
+    char tname[16];
+    pthread_getname_np(pthread_self(), tname, sizeof(tname));
+    assert(!strcmp(tname, expected));
+}
+
+int soc_irq_handler(void) {
+    printf("%s() called\n", __func__);
+    check_thread("soc");
+    soc_irq_triggered++;
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+
+    printf("%s(%p) called\n", __func__, (void *)mocker);
+    int rc = hwmocker_set_gpio_irq_handler(soc, SOC_IRQ_NUMBER, soc_irq_handler);
+    assert(rc == 0);
+
+    /* Nothing raised yet */
+    rc = hwmocker_wait_irq(soc, 1000);
+    assert(rc == -ETIMEDOUT);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    hwmocker_set_gpio_level(soc, HOST2SOC_PIN(HOST_IRQ_NUMBER), 1);
+
+    while (!soc_irq_triggered) {
+        rc = hwmocker_wait_irq(soc, IRQ_TIMEOUT_US);
+        assert(rc == 0);
+    }
+    return 0;
+}
+
+int host_irq_handler(void) {
+    printf("%s() called\n", __func__);
+    check_thread("host");
+    host_irq_triggered++;
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+
+    printf("%s(%p) called\n", __func__, (void *)mocker);
+    int rc = hwmocker_set_gpio_irq_handler(host, HOST_IRQ_NUMBER, host_irq_handler);
+    assert(rc == 0);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(SOC_IRQ_NUMBER), 1);
+
+    while (!host_irq_triggered) {
+        rc = hwmocker_wait_irq(host, IRQ_TIMEOUT_US);
+        assert(rc == 0);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    printf("hwmocker_create returned %p\n", (void *)mocker);
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    printf("hwmocker waiting for system to exit...\n");
+    hwmocker_wait(mocker);
+
+    printf("hwmocker cleaning up...\n");
+    hwmocker_destroy(mocker);
+
+    assert(soc_irq_triggered == 1);
+    assert(host_irq_triggered == 1);
+
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <hwmocker/hwmocker.h>
+#include <hwmocker/irq.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#define __USE_GNU 1
+#include <pthread.h>
+
+#include "test_wait.h"
+
+#define NR_IRQS 200
+#define NR_HANDLERS 64
+#define MASKED_IRQ 7
+
+struct hwmocker_irq_handler *soc_irqhs[NR_HANDLERS];
+volatile int irq_triggered[NR_HANDLERS][NR_IRQS];
+volatile int irq_total;
+pthread_t soc_thread;
+
+int soc_irq_handler(int irq_number, void *priv) {
+    volatile int *triggered = (volatile int *)priv;
+    assert(pthread_equal(pthread_self(), soc_thread));
+    triggered[irq_number]++;
+    __atomic_fetch_add(&irq_total, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+int other_irq_handler(int irq_number, void *priv) {
+    (void)irq_number;
+    (void)priv;
+    return 0;
+}
+
+static void wait_irq_total(int expected) {
+    WAIT_UNTIL(irq_total >= expected);
+    assert(irq_total == expected);
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+
+    soc_thread = pthread_self();
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    /* Every handler got every irq once, except the masked one */
+    wait_irq_total(NR_HANDLERS * (NR_IRQS - 1));
+    for (int idx = 0; idx < NR_HANDLERS; idx++)
+        for (int irq = 0; irq < NR_IRQS; irq++)
+            assert(irq_triggered[idx][irq] == (irq != MASKED_IRQ));
+
+    /* The postponed irq fires once unmasked */
+    for (int idx = 0; idx < NR_HANDLERS; idx++) {
+        struct hwmocker_irq_desc *desc =
+            hwmocker_irq_handler_get_irq_desc(soc_irqhs[idx], MASKED_IRQ);
+        assert(hwmocker_irq_handler_unmask_irq(desc) == 0);
+    }
+    wait_irq_total(NR_HANDLERS * NR_IRQS);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    for (int irq = 0; irq < NR_IRQS; irq++) {
+        for (int idx = 0; idx < NR_HANDLERS; idx++) {
+            struct hwmocker_irq_desc *desc =
+                hwmocker_irq_handler_get_irq_desc(soc_irqhs[idx], irq);
+            int rc = hwmocker_irq_handler_trigger_irq(desc);
+            assert(rc == 0);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    /* More handlers than realtime signals */
+    for (int idx = 0; idx < NR_HANDLERS; idx++) {
+        struct hwmocker_irq_handler *irqh = hwmocker_irq_handler_create(mocker, 1);
+        assert(irqh);
+        soc_irqhs[idx] = irqh;
+
+        assert(hwmocker_irq_handler_declare_irq(irqh, -1) == -EINVAL);
+        for (int irq = 0; irq < NR_IRQS; irq++) {
+            rc = hwmocker_irq_handler_declare_irq(irqh, irq);
+            assert(rc == 0);
+            rc = hwmocker_irq_handler_register_handler(irqh, irq, soc_irq_handler,
+                                                       (void *)irq_triggered[idx],
+                                                       HWMOCKER_IRQ_RISING_EDGE, 1);
+            assert(rc == 0);
+        }
+        assert(hwmocker_irq_handler_declare_irq(irqh, 0) == -EEXIST);
+        /* irqs are exclusive */
+        rc = hwmocker_irq_handler_register_handler(irqh, 0, other_irq_handler, NULL,
+                                                   HWMOCKER_IRQ_RISING_EDGE, 0);
+        assert(rc == -EINVAL);
+        assert(hwmocker_irq_handler_unregister_handler(irqh, 0, other_irq_handler) == -ENOENT);
+        rc = hwmocker_irq_handler_mask_irq(hwmocker_irq_handler_get_irq_desc(irqh, MASKED_IRQ));
+        assert(rc == 0);
+    }
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+
+    for (int idx = 0; idx < NR_HANDLERS; idx++)
+        hwmocker_irq_handler_destroy(soc_irqhs[idx]);
+    hwmocker_destroy(mocker);
+
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "test_wait.h"
+
+/* Priorities from the config */
+#define LOW_IRQ 1
+#define LOW_PRIORITY 8
+#define HIGH_IRQ 2
+#define HIGH_PRIORITY 1
+
+#define SOC2HOST_PIN(x) (x + 100)
+
+void *soc;
+volatile int phase;
+volatile int low_triggered;
+volatile int high_triggered;
+volatile int in_low;
+volatile int low_preempted;
+volatile int high_in_low;
+/* How long the low priority handler waits to be preempted */
+volatile int low_wait_ms;
+
+
+int low_irq_handler(void) {
+    int high_before = high_triggered;
+    unsigned long long deadline_ns = wall_ns() + low_wait_ms * 1000000ULL;
+
+    assert(hwmocker_get_irq_running_priority(soc) == LOW_PRIORITY);
+    in_low = 1;
+    while (high_triggered == high_before && wall_ns() < deadline_ns)
+        ;
+    low_preempted = high_triggered != high_before;
+    in_low = 0;
+    assert(hwmocker_get_irq_running_priority(soc) == LOW_PRIORITY);
+    low_triggered++;
+    return 0;
+}
+
+int high_irq_handler(void) {
+    assert(hwmocker_get_irq_running_priority(soc) == HIGH_PRIORITY);
+    high_in_low = in_low;
+    high_triggered++;
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+
+    soc = hwmocker_get_soc(mocker);
+    assert(hwmocker_set_gpio_irq_handler(soc, LOW_IRQ, low_irq_handler) == 0);
+    assert(hwmocker_set_gpio_irq_handler(soc, HIGH_IRQ, high_irq_handler) == 0);
+    assert(hwmocker_set_irq_basepri(soc, HWMOCK_IRQ_PRIORITIES) == -EINVAL);
+    assert(hwmocker_get_irq_running_priority(soc) == HWMOCK_IRQ_PRIORITIES);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    /* The high priority irq preempts the low priority handler */
+    low_wait_ms = 1000;
+    phase = 1;
+    WAIT_UNTIL(low_triggered == 1);
+    assert(low_preempted && high_in_low && high_triggered == 1);
+
+    /* basepri masks the low priority irq only */
+    assert(hwmocker_set_irq_basepri(soc, 4) == 0);
+    phase = 2;
+    WAIT_UNTIL(high_triggered == 2);
+    /* Raised before the high priority irq, left pending */
+    struct hwmocker_irq_stats stats;
+    assert(hwmocker_get_irq_stats(soc, LOW_IRQ, &stats) == 0);
+    assert(stats.raised == 2 && stats.delivered == 1);
+    assert(low_triggered == 1);
+    assert(hwmocker_set_irq_basepri(soc, 0) == 0);
+    WAIT_UNTIL(low_triggered == 2);
+
+    /* A single group priority: no more preemption */
+    assert(hwmocker_set_irq_priority_grouping(soc, 5) == -EINVAL);
+    assert(hwmocker_set_irq_priority_grouping(soc, 4) == 0);
+    low_wait_ms = 20;
+    phase = 3;
+    WAIT_UNTIL(low_triggered == 3);
+    assert(!low_preempted);
+    WAIT_UNTIL(high_triggered == 3);
+    assert(!high_in_low);
+    phase = 4;
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    /* Every level change raises the gpio irqs */
+    WAIT_UNTIL(phase == 1);
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(LOW_IRQ), 1);
+    WAIT_UNTIL(in_low == 1);
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(HIGH_IRQ), 1);
+
+    WAIT_UNTIL(phase == 2);
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(LOW_IRQ), 0);
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(HIGH_IRQ), 0);
+
+    WAIT_UNTIL(phase == 3);
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(LOW_IRQ), 1);
+    WAIT_UNTIL(in_low == 1);
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(HIGH_IRQ), 1);
+
+    WAIT_UNTIL(phase == 4);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "test_wait.h"
+
+/* Lines raised together, in this order, and their priorities (LOW_IRQ's from the config) */
+#define LOW_IRQ 2
+#define LOW_PRIORITY 8
+#define MID_IRQ_HIGH_LINE 6
+#define MID_IRQ_LOW_LINE 4
+#define MID_PRIORITY 4
+#define HIGH_IRQ 3
+#define HIGH_PRIORITY 1
+#define NR_RAISED 4
+
+#define SOC2HOST_PIN(x) (x + 100)
+
+volatile int host_done;
+int handled[NR_RAISED];
+int nr_handled;
+
+static void record(int irq) {
+    assert(nr_handled < NR_RAISED);
+    handled[nr_handled++] = irq;
+}
+
+int low_irq_handler(void) {
+    record(LOW_IRQ);
+    return 0;
+}
+
+int mid_high_line_irq_handler(void) {
+    record(MID_IRQ_HIGH_LINE);
+    return 0;
+}
+
+int mid_low_line_irq_handler(void) {
+    record(MID_IRQ_LOW_LINE);
+    return 0;
+}
+
+int high_irq_handler(void) {
+    record(HIGH_IRQ);
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+
+    assert(hwmocker_set_gpio_irq_handler(soc, LOW_IRQ, low_irq_handler) == 0);
+    assert(hwmocker_set_gpio_irq_handler(soc, MID_IRQ_HIGH_LINE, mid_high_line_irq_handler) == 0);
+    assert(hwmocker_set_gpio_irq_handler(soc, MID_IRQ_LOW_LINE, mid_low_line_irq_handler) == 0);
+    assert(hwmocker_set_gpio_irq_handler(soc, HIGH_IRQ, high_irq_handler) == 0);
+    assert(hwmocker_set_irq_priority(soc, HIGH_IRQ, HWMOCK_IRQ_PRIORITIES) == -EINVAL);
+    assert(hwmocker_set_irq_priority(soc, HWMOCK_IRQ_LINES, HIGH_PRIORITY) == -EINVAL);
+    assert(hwmocker_set_irq_priority(soc, HIGH_IRQ, HIGH_PRIORITY) == 0);
+    assert(hwmocker_set_irq_priority(soc, MID_IRQ_HIGH_LINE, MID_PRIORITY) == 0);
+    assert(hwmocker_set_irq_priority(soc, MID_IRQ_LOW_LINE, MID_PRIORITY) == 0);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    /* With the doorbell delivery, the lines stay pending until the check point */
+    WAIT_UNTIL(host_done);
+    assert(nr_handled == 0);
+    hwmocker_poll_irqs(soc);
+
+    /* Highest priority first, the lowest line first within a priority */
+    assert(nr_handled == NR_RAISED);
+    assert(handled[0] == HIGH_IRQ);
+    assert(handled[1] == MID_IRQ_LOW_LINE);
+    assert(handled[2] == MID_IRQ_HIGH_LINE);
+    assert(handled[3] == LOW_IRQ);
+    printf("%s - handled %d, %d, %d, %d\n", __func__, handled[0], handled[1], handled[2],
+           handled[3]);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(LOW_IRQ), 1);
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(MID_IRQ_HIGH_LINE), 1);
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(MID_IRQ_LOW_LINE), 1);
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(HIGH_IRQ), 1);
+    host_done = 1;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    printf("That's all folks!!!\n");
+    return 0;
+}
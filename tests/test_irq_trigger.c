@@ -0,0 +1,157 @@
+#include <hwmocker/hwmocker.h>
+#include <hwmocker/irq.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+
+#include "test_wait.h"
+
+#define RISING_IRQ 0
+#define FALLING_IRQ 1
+#define LEVEL_IRQ 2
+#define STALE_IRQ 3
+/* Handled once every irq queued before it was */
+#define SENTINEL_IRQ 4
+#define NR_LEVEL_WRITES 100
+#define SOC_GPIO_IRQ 5
+
+#define SOC2HOST_PIN(x) (x + 100)
+
+struct hwmocker_irq_handler *soc_irqh;
+volatile int irq_triggered[5];
+volatile int gpio_irq_triggered;
+volatile int host_done;
+
+int soc_irq_handler(int irq_number, void *priv) {
+    (void)priv;
+    irq_triggered[irq_number]++;
+    return 0;
+}
+
+int soc_gpio_irq_handler(void) {
+    gpio_irq_triggered++;
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+
+    assert(hwmocker_set_gpio_irq_handler(soc, SOC_GPIO_IRQ, soc_gpio_irq_handler) == 0);
+    assert(hwmocker_set_gpio_irq_trigger(soc, SOC_GPIO_IRQ, 0x10) == -EINVAL);
+    assert(hwmocker_set_gpio_irq_trigger(soc, SOC_GPIO_IRQ, HWMOCKER_IRQ_RISING_EDGE) == 0);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    /* One edge each, the level held high fires once unmasked */
+    WAIT_UNTIL(host_done);
+    WAIT_UNTIL(irq_triggered[RISING_IRQ] && irq_triggered[FALLING_IRQ] && gpio_irq_triggered);
+    assert(irq_triggered[LEVEL_IRQ] == 0);
+
+    struct hwmocker_irq_desc *desc = hwmocker_irq_handler_get_irq_desc(soc_irqh, LEVEL_IRQ);
+    assert(hwmocker_irq_handler_unmask_irq(desc) == 0);
+    WAIT_UNTIL(irq_triggered[LEVEL_IRQ]);
+
+    /* No late storm: the irqs queued before the sentinel are handled before it */
+    desc = hwmocker_irq_handler_get_irq_desc(soc_irqh, SENTINEL_IRQ);
+    assert(hwmocker_irq_handler_trigger_irq(desc) == 0);
+    WAIT_UNTIL(irq_triggered[SENTINEL_IRQ]);
+    assert(irq_triggered[RISING_IRQ] == 1);
+    assert(irq_triggered[FALLING_IRQ] == 1);
+    assert(irq_triggered[LEVEL_IRQ] == 1);
+    assert(gpio_irq_triggered == 1);
+    struct hwmocker_irq_stats stats;
+    assert(hwmocker_get_irq_stats(soc, SOC_GPIO_IRQ, &stats) == 0);
+    assert(stats.raised == 1 && stats.delivered == 1);
+
+    /* A signal still queued when its handler is destroyed is ignored */
+    struct hwmocker_irq_handler *stale_irqh = hwmocker_irq_handler_create(mocker, 1);
+    assert(stale_irqh);
+    assert(hwmocker_irq_handler_declare_irq(stale_irqh, STALE_IRQ) == 0);
+    assert(hwmocker_irq_handler_register_handler(stale_irqh, STALE_IRQ, soc_irq_handler, NULL,
+                                                 HWMOCKER_IRQ_RISING_EDGE, 1) == 0);
+    sigset_t rt_signals, old_signals;
+    sigemptyset(&rt_signals);
+    for (int signum = SIGRTMIN; signum <= SIGRTMAX; signum++)
+        sigaddset(&rt_signals, signum);
+    pthread_sigmask(SIG_BLOCK, &rt_signals, &old_signals);
+    desc = hwmocker_irq_handler_get_irq_desc(stale_irqh, STALE_IRQ);
+    assert(hwmocker_irq_handler_trigger_irq(desc) == 0);
+    hwmocker_irq_handler_destroy(stale_irqh);
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    assert(irq_triggered[STALE_IRQ] == 0);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    for (int irq = RISING_IRQ; irq <= FALLING_IRQ; irq++) {
+        struct hwmocker_irq_desc *desc = hwmocker_irq_handler_get_irq_desc(soc_irqh, irq);
+        assert(hwmocker_irq_handler_set_irq_level(desc, 1) == 0);
+        assert(hwmocker_irq_handler_set_irq_level(desc, 1) == 0);
+        assert(hwmocker_irq_handler_set_irq_level(desc, 0) == 0);
+    }
+
+    struct hwmocker_irq_desc *desc = hwmocker_irq_handler_get_irq_desc(soc_irqh, LEVEL_IRQ);
+    for (int idx = 0; idx < NR_LEVEL_WRITES; idx++)
+        assert(hwmocker_irq_handler_set_irq_level(desc, 1) == 0);
+
+    /* The falling edge is ignored */
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(SOC_GPIO_IRQ), 1);
+    hwmocker_set_gpio_level(host, SOC2HOST_PIN(SOC_GPIO_IRQ), 0);
+
+    host_done = 1;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    soc_irqh = hwmocker_irq_handler_create(mocker, 1);
+    assert(soc_irqh);
+
+    enum hwmocker_irq_type types[] = {HWMOCKER_IRQ_RISING_EDGE, HWMOCKER_IRQ_FALLING_EDGE,
+                                      HWMOCKER_IRQ_HIGH_LEVEL};
+    for (int irq = RISING_IRQ; irq <= LEVEL_IRQ; irq++) {
+        assert(hwmocker_irq_handler_declare_irq(soc_irqh, irq) == 0);
+        rc = hwmocker_irq_handler_register_handler(soc_irqh, irq, soc_irq_handler, NULL,
+                                                   types[irq], 1);
+        assert(rc == 0);
+    }
+    assert(hwmocker_irq_handler_declare_irq(soc_irqh, SENTINEL_IRQ) == 0);
+    rc = hwmocker_irq_handler_register_handler(soc_irqh, SENTINEL_IRQ, soc_irq_handler, NULL,
+                                               HWMOCKER_IRQ_RISING_EDGE, 1);
+    assert(rc == 0);
+    rc = hwmocker_irq_handler_mask_irq(hwmocker_irq_handler_get_irq_desc(soc_irqh, LEVEL_IRQ));
+    assert(rc == 0);
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+
+    hwmocker_irq_handler_destroy(soc_irqh);
+    hwmocker_destroy(mocker);
+
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test_wait.h"
+
+#define MAILBOX_IDX 0
+#define WAIT_TIMEOUT_US 1000000
+/* From the config: 1MB rings */
+#define RING_SIZE (1024 * 1024)
+#define CHUNK_SIZE (64 * 1024)
+#define UPLOAD_SIZE (1024ULL * 1024 * 1024)
+#define PATTERN(x) ((unsigned char)((x) * 7 + ((x) >> 8)))
+/* Messages written while the soc handler drains the first one */
+#define BURST_MSGS 16
+#define BURST_MSG_SIZE 32
+
+void *soc_mailbox;
+void *host_mailbox;
+unsigned char chunk[CHUNK_SIZE];
+/* Soc side: upload bytes drained and the irqs draining them */
+volatile unsigned long long received;
+volatile int rx_irqs;
+/* Burst messages received, the handler stalled once after the first one */
+volatile int burst_msgs;
+volatile int burst_stalled;
+volatile int host_burst_done;
+/* Host side events */
+volatile unsigned int host_events;
+
+/*
+ * Drains the burst, then stalls once while the host writes the rest of it: returning without
+ * looking again, only the re-raised irq delivers the messages whose doorbell was suppressed
+ */
+static int soc_burst_irq(void) {
+    unsigned char msg[BURST_MSG_SIZE];
+    ssize_t count;
+
+    while ((count = hwmocker_mailbox_read(soc_mailbox, msg, sizeof(msg)))) {
+        assert(count == sizeof(msg));
+        assert(msg[0] == burst_msgs && msg[sizeof(msg) - 1] == burst_msgs);
+        burst_msgs++;
+    }
+    if (!burst_stalled) {
+        burst_stalled = 1;
+        WAIT_UNTIL(host_burst_done);
+    }
+    return 0;
+}
+
+/* Drains in place, checking the first and the last byte of each span */
+int soc_mailbox_irq(unsigned int status, void *ctx) {
+    const unsigned char *span;
+    size_t size, consumed;
+
+    assert(ctx == soc_mailbox);
+    assert(status == HWMOCKER_MAILBOX_IRQ_RX);
+    rx_irqs++;
+    if (received == UPLOAD_SIZE)
+        return soc_burst_irq();
+    while ((size = hwmocker_mailbox_read_span(soc_mailbox, (const void **)&span))) {
+        assert(span[0] == PATTERN(received % CHUNK_SIZE));
+        assert(span[size - 1] == PATTERN((received + size - 1) % CHUNK_SIZE));
+        received += size;
+        consumed = hwmocker_mailbox_consume(soc_mailbox, size);
+        assert(consumed == size);
+    }
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    unsigned long long answer;
+    int rc;
+
+    soc_mailbox = hwmocker_get_mailbox(soc, MAILBOX_IDX);
+    assert(soc_mailbox);
+    assert(hwmocker_get_mailbox(soc, MAILBOX_IDX + 1) == NULL);
+    rc = hwmocker_mailbox_set_irq_handler(soc_mailbox, HWMOCKER_MAILBOX_IRQ_RX, soc_mailbox_irq,
+                                          soc_mailbox);
+    assert(rc == 0);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    while (received < UPLOAD_SIZE) {
+        rc = hwmocker_wait_irq(soc, WAIT_TIMEOUT_US);
+        assert(rc == 0 || received == UPLOAD_SIZE);
+    }
+    assert(received == UPLOAD_SIZE);
+
+    /* Acknowledges the upload */
+    answer = received;
+    rc = hwmocker_mailbox_write(soc_mailbox, &answer, sizeof(answer));
+    assert(rc == sizeof(answer));
+    printf("%s - %llu bytes received in %d irqs\n", __func__, UPLOAD_SIZE, rx_irqs);
+
+    while (burst_msgs < BURST_MSGS) {
+        rc = hwmocker_wait_irq(soc, WAIT_TIMEOUT_US);
+        assert(rc == 0 || burst_msgs == BURST_MSGS);
+    }
+    assert(burst_msgs == BURST_MSGS);
+    return 0;
+}
+
+int host_mailbox_irq(unsigned int status, void *ctx) {
+    assert(ctx == host_mailbox);
+    host_events |= status;
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    struct hwmocker_mailbox_stats stats;
+    unsigned long long sent = 0, answer, wall_start_ns, elapsed_ns;
+    unsigned char msg[BURST_MSG_SIZE];
+    int rc;
+
+    host_mailbox = hwmocker_get_mailbox(host, MAILBOX_IDX);
+    for (int idx = 0; idx < CHUNK_SIZE; idx++)
+        chunk[idx] = PATTERN(idx);
+    rc = hwmocker_mailbox_set_irq_handler(host_mailbox,
+                                          HWMOCKER_MAILBOX_IRQ_RX | HWMOCKER_MAILBOX_IRQ_TX,
+                                          host_mailbox_irq, host_mailbox);
+    assert(rc == 0);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+    hwmocker_mailbox_reset_stats(host_mailbox);
+
+    wall_start_ns = wall_ns();
+    while (sent < UPLOAD_SIZE) {
+        size_t offset = sent % CHUNK_SIZE;
+        ssize_t written =
+            hwmocker_mailbox_write(host_mailbox, chunk + offset, CHUNK_SIZE - offset);
+        assert(written >= 0);
+        sent += written;
+        /* Full: waits for the soc to read */
+        if ((size_t)written < CHUNK_SIZE - offset) {
+            while (!(host_events & HWMOCKER_MAILBOX_IRQ_TX)) {
+                rc = hwmocker_wait_irq(host, WAIT_TIMEOUT_US);
+                assert(rc == 0);
+            }
+            /* Not to lose an event set by the handler meanwhile */
+            __atomic_fetch_and(&host_events, ~HWMOCKER_MAILBOX_IRQ_TX, __ATOMIC_RELAXED);
+        }
+    }
+
+    while (!(host_events & HWMOCKER_MAILBOX_IRQ_RX)) {
+        rc = hwmocker_wait_irq(host, WAIT_TIMEOUT_US);
+        assert(rc == 0);
+    }
+    assert(hwmocker_mailbox_rx_level(host_mailbox) == sizeof(answer));
+    rc = hwmocker_mailbox_read(host_mailbox, &answer, sizeof(answer));
+    assert(rc == sizeof(answer));
+    assert(answer == UPLOAD_SIZE);
+    elapsed_ns = wall_ns() - wall_start_ns;
+
+    hwmocker_mailbox_get_stats(host_mailbox, &stats);
+    assert(stats.tx_bytes == UPLOAD_SIZE);
+    assert(stats.rx_bytes == sizeof(answer));
+    printf("%s - %llu bytes uploaded at %.1f GB/s, %llu doorbells, %llu suppressed\n", __func__,
+           UPLOAD_SIZE, (double)UPLOAD_SIZE / elapsed_ns, stats.doorbells, stats.suppressed);
+
+    /* The first message rings, the ones written while the soc handler drains do not */
+    hwmocker_mailbox_reset_stats(host_mailbox);
+    for (int idx = 0; idx < BURST_MSGS; idx++) {
+        memset(msg, idx, sizeof(msg));
+        rc = hwmocker_mailbox_write(host_mailbox, msg, sizeof(msg));
+        assert(rc == sizeof(msg));
+        if (!idx)
+            WAIT_UNTIL(burst_stalled);
+    }
+    host_burst_done = 1;
+
+    hwmocker_mailbox_get_stats(host_mailbox, &stats);
+    assert(stats.tx_bytes == BURST_MSGS * BURST_MSG_SIZE);
+    assert(stats.doorbells == 1);
+    assert(stats.suppressed == BURST_MSGS - 1);
+    printf("%s - %d messages burst, %llu doorbells, %llu suppressed\n", __func__, BURST_MSGS,
+           stats.doorbells, stats.suppressed);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(received == UPLOAD_SIZE);
+    assert(burst_msgs == BURST_MSGS);
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -5,7 +5,6 @@
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
-#include <unistd.h>
 
 #define __USE_GNU 1
 #include <pthread.h>
@@ -15,6 +14,11 @@
 #define XFER_SIZE 256
 #define SOC_TX_PATTERN 0xaa
 #define HOST_TX_PATTERN 0x55
+/* Soc gpios: its async transfer is queued and it is done */
+#define SOC_ASYNC_PIN 1
+#define SOC_DONE_PIN 2
+#define SOC2HOST_PIN(x) (x + 100)
+#define WAIT_TIMEOUT_US 1000000
 
 struct async_spi_ctx {
     unsigned char *rxbuf;
@@ -75,9 +79,14 @@ int soc_main(void *priv) {
     rc = hwmocker_spi_xfer_async(spi_dev, txbuf, rxbuf, XFER_SIZE, async_spi_callback, &async_ctx);
     assert(rc == 0);
     printf("%s - hwmocker_spi_xfer_async returned %d\n", __func__, rc);
+    hwmocker_set_gpio_level(soc, SOC_ASYNC_PIN, 1);
 
-    /* wait 10ms here to let the signals to be handled */
-    usleep(100000);
+    /* wait for the host transfer to complete the async one */
+    while (!rx_completed) {
+        rc = hwmocker_wait_irq(soc, 1000000);
+        assert(rc == 0);
+    }
+    hwmocker_set_gpio_level(soc, SOC_DONE_PIN, 1);
     return 0;
 }
 
@@ -99,9 +108,6 @@ int host_main(void *priv) {
     hwmocker_set_host_ready(mocker);
     hwmocker_wait_soc_ready(mocker);
 
-    /* wait 100ms so the soc is ready to xfer */
-    usleep(10000);
-
     rc = hwmocker_spi_xfer_async(spi_dev, txbuf, rxbuf, XFER_SIZE, async_spi_callback, NULL);
     assert(rc == -EINVAL);
 
@@ -110,15 +116,17 @@ int host_main(void *priv) {
     printf("%s - hwmocker_spi_xfer returned %d\n", __func__, rc);
     check_rxbuf(rxbuf, SOC_TX_PATTERN, XFER_SIZE);
 
-    usleep(100000);
+    rc = hwmocker_gpio_wait_level(host, SOC2HOST_PIN(SOC_ASYNC_PIN), 1, WAIT_TIMEOUT_US);
+    assert(rc == 0);
     memset(rxbuf, 0, XFER_SIZE);
     rc = hwmocker_spi_xfer(spi_dev, txbuf, rxbuf, XFER_SIZE);
     assert(rc == XFER_SIZE);
     printf("%s - hwmocker_spi_xfer returned %d\n", __func__, rc);
     check_rxbuf(rxbuf, SOC_TX_PATTERN, XFER_SIZE);
 
-    /* wait 10ms here to let the signals to be handled */
-    usleep(10000);
+    /* wait for the soc to handle its completion irq */
+    rc = hwmocker_gpio_wait_level(host, SOC2HOST_PIN(SOC_DONE_PIN), 1, WAIT_TIMEOUT_US);
+    assert(rc == 0);
     return 0;
 }
 
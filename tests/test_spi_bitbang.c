@@ -0,0 +1,230 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SOC_SPI_IDX 4
+/* Mode 3, least significant bit first */
+#define SOC_LSB_SPI_IDX 5
+#define WAIT_TIMEOUT_US 1000000
+#define XFER_SIZE 64
+/* The second window clocks past the slave transfer, split in segments */
+#define LONG_SIZE (XFER_SIZE + 6)
+#define DROPPED_SIZE 8
+#define SOC_PATTERN(xfer, idx) ((0x80 + (xfer) * 0x20 + (idx)) & 0xff)
+#define HOST_PATTERN(xfer, idx) (((xfer) * 0x40 + (idx)) & 0xff)
+/* The last two transfers are clocked in whole words by hwmocker_spi_bitbang_xfer() */
+#define XFERS 5
+#define MSB_WORDS_XFER 3
+#define LSB_WORDS_XFER 4
+
+/* Host gpios connected to the soc spi pins and the bit-bang config of the soc spi */
+struct bitbang_bus {
+    unsigned int clk_pin;
+    unsigned int mosi_pin;
+    unsigned int miso_pin;
+    unsigned int csn_pin;
+    int mode;
+    int lsb_first;
+};
+
+static const struct bitbang_bus msb_bus = {101, 102, 103, 104, 0, 0};
+static const struct bitbang_bus lsb_bus = {105, 106, 107, 108, 3, 1};
+
+void *soc_spi_dev;
+void *soc_lsb_spi_dev;
+unsigned char soc_tx[XFERS][XFER_SIZE];
+unsigned char soc_rx[XFERS][XFER_SIZE];
+int statuses[XFERS];
+volatile int completed;
+
+int spi_complete(void *ctx, int status) {
+    statuses[(long)ctx] = status;
+    completed++;
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    struct iovec tx_iov[2], rx_iov[3];
+    int rc;
+
+    soc_spi_dev = hwmocker_get_spi_device(soc, SOC_SPI_IDX);
+    soc_lsb_spi_dev = hwmocker_get_spi_device(soc, SOC_LSB_SPI_IDX);
+    hwmocker_spi_enable_irq(soc_spi_dev);
+    hwmocker_spi_enable_irq(soc_lsb_spi_dev);
+    for (int xfer = 0; xfer < XFERS; xfer++)
+        for (int idx = 0; idx < XFER_SIZE; idx++)
+            soc_tx[xfer][idx] = SOC_PATTERN(xfer, idx);
+
+    tx_iov[0] = (struct iovec){soc_tx[0], XFER_SIZE};
+    rx_iov[0] = (struct iovec){soc_rx[0], XFER_SIZE};
+    rc = hwmocker_spi_submit(soc_spi_dev, tx_iov, 1, rx_iov, 1, spi_complete, (void *)0);
+    assert(rc == 0);
+
+    tx_iov[0] = (struct iovec){soc_tx[1], 16};
+    tx_iov[1] = (struct iovec){soc_tx[1] + 16, XFER_SIZE - 16};
+    rx_iov[0] = (struct iovec){soc_rx[1], 10};
+    rx_iov[1] = (struct iovec){soc_rx[1] + 10, 1};
+    rx_iov[2] = (struct iovec){soc_rx[1] + 11, XFER_SIZE - 11};
+    rc = hwmocker_spi_submit(soc_spi_dev, tx_iov, 2, rx_iov, 3, spi_complete, (void *)1);
+    assert(rc == 0);
+
+    tx_iov[0] = (struct iovec){soc_tx[2], XFER_SIZE};
+    rx_iov[0] = (struct iovec){soc_rx[2], XFER_SIZE};
+    rc = hwmocker_spi_submit(soc_lsb_spi_dev, tx_iov, 1, rx_iov, 1, spi_complete, (void *)2);
+    assert(rc == 0);
+
+    for (long xfer = MSB_WORDS_XFER; xfer <= LSB_WORDS_XFER; xfer++) {
+        void *spi_dev = xfer == MSB_WORDS_XFER ? soc_spi_dev : soc_lsb_spi_dev;
+        tx_iov[0] = (struct iovec){soc_tx[xfer], XFER_SIZE};
+        rx_iov[0] = (struct iovec){soc_rx[xfer], 20};
+        rx_iov[1] = (struct iovec){soc_rx[xfer] + 20, XFER_SIZE - 20};
+        rc = hwmocker_spi_submit(spi_dev, tx_iov, 1, rx_iov, 2, spi_complete, (void *)xfer);
+        assert(rc == 0);
+    }
+
+    hwmocker_set_soc_ready(mocker);
+    while (completed < XFERS) {
+        rc = hwmocker_wait_irq(soc, WAIT_TIMEOUT_US);
+        assert(rc == 0);
+    }
+
+    /* The long window completes the slave transfer with its size */
+    for (int xfer = 0; xfer < XFERS; xfer++)
+        assert(statuses[xfer] == XFER_SIZE);
+    for (int xfer = 0; xfer < XFERS; xfer++)
+        for (int idx = 0; idx < XFER_SIZE; idx++)
+            assert(soc_rx[xfer][idx] == HOST_PATTERN(xfer, idx));
+    printf("%s - %d bit-banged transfers received\n", __func__, completed);
+    return 0;
+}
+
+/* Spi master over gpios, in the mode and bit order of the bus */
+static void bitbang_xfer(void *host, const struct bitbang_bus *bus, const unsigned char *tx,
+                         unsigned char *rx, size_t size) {
+    int cpol = bus->mode >> 1, cpha = bus->mode & 1;
+
+    hwmocker_set_gpio_level(host, bus->clk_pin, cpol);
+    hwmocker_set_gpio_level(host, bus->csn_pin, 0);
+    for (size_t idx = 0; idx < size; idx++) {
+        unsigned char word = 0;
+        for (int shift = 0; shift < 8; shift++) {
+            int bit = bus->lsb_first ? shift : 7 - shift;
+            if (cpha)
+                hwmocker_set_gpio_level(host, bus->clk_pin, !cpol);
+            hwmocker_set_gpio_level(host, bus->mosi_pin, (tx[idx] >> bit) & 1);
+            hwmocker_set_gpio_level(host, bus->clk_pin, cpha ? cpol : !cpol);
+            word |= hwmocker_get_gpio_level(host, bus->miso_pin) << bit;
+            if (!cpha)
+                hwmocker_set_gpio_level(host, bus->clk_pin, cpol);
+        }
+        rx[idx] = word;
+    }
+    hwmocker_set_gpio_level(host, bus->csn_pin, 1);
+}
+
+/* Spi master clocking whole words, in two calls resumed between two words */
+static void bitbang_words_xfer(void *host, const struct bitbang_bus *bus, const unsigned char *tx,
+                               unsigned char *rx, size_t size) {
+    struct hwmocker_spi_bitbang words_bus = {bus->clk_pin, bus->mosi_pin, bus->miso_pin,
+                                             bus->mode, bus->lsb_first};
+
+    hwmocker_set_gpio_level(host, bus->csn_pin, 0);
+    assert(hwmocker_spi_bitbang_xfer(host, &words_bus, tx, rx, 1) == 1);
+    assert(hwmocker_spi_bitbang_xfer(host, &words_bus, tx + 1, rx + 1, size - 1) ==
+           (int)size - 1);
+    hwmocker_set_gpio_level(host, bus->csn_pin, 1);
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    unsigned char tx[LONG_SIZE], rx[LONG_SIZE];
+    struct hwmocker_spi_stats stats;
+
+    /* Chip selects released */
+    hwmocker_set_gpio_level(host, msb_bus.csn_pin, 1);
+    hwmocker_set_gpio_level(host, lsb_bus.csn_pin, 1);
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    for (int idx = 0; idx < LONG_SIZE; idx++)
+        tx[idx] = HOST_PATTERN(0, idx);
+    bitbang_xfer(host, &msb_bus, tx, rx, XFER_SIZE);
+    for (int idx = 0; idx < XFER_SIZE; idx++)
+        assert(rx[idx] == SOC_PATTERN(0, idx));
+
+    /* Zeros are shifted out past the slave transfer */
+    for (int idx = 0; idx < LONG_SIZE; idx++)
+        tx[idx] = HOST_PATTERN(1, idx);
+    bitbang_xfer(host, &msb_bus, tx, rx, LONG_SIZE);
+    for (int idx = 0; idx < LONG_SIZE; idx++)
+        assert(rx[idx] == (idx < XFER_SIZE ? SOC_PATTERN(1, idx) : 0));
+
+    /* Taken in whole words by the slave, without clock edges */
+    for (int idx = 0; idx < XFER_SIZE; idx++)
+        tx[idx] = HOST_PATTERN(MSB_WORDS_XFER, idx);
+    bitbang_words_xfer(host, &msb_bus, tx, rx, XFER_SIZE);
+    for (int idx = 0; idx < XFER_SIZE; idx++)
+        assert(rx[idx] == SOC_PATTERN(MSB_WORDS_XFER, idx));
+
+    /* Nothing armed: the words are dropped */
+    bitbang_xfer(host, &msb_bus, tx, rx, DROPPED_SIZE);
+    for (int idx = 0; idx < DROPPED_SIZE; idx++)
+        assert(rx[idx] == 0);
+
+    hwmocker_spi_get_stats(soc_spi_dev, &stats);
+    assert(stats.xfers == 4);
+    assert(stats.bytes == 2 * XFER_SIZE + LONG_SIZE + DROPPED_SIZE);
+
+    struct hwmocker_spi_bitbang bad_bus = {msb_bus.clk_pin, msb_bus.mosi_pin, msb_bus.miso_pin, 4,
+                                           0};
+    assert(hwmocker_spi_bitbang_xfer(host, &bad_bus, tx, rx, 1) == -EINVAL);
+
+    /* Shifted out on the leading edge, least significant bit first */
+    for (int idx = 0; idx < XFER_SIZE; idx++)
+        tx[idx] = HOST_PATTERN(2, idx);
+    bitbang_xfer(host, &lsb_bus, tx, rx, XFER_SIZE);
+    for (int idx = 0; idx < XFER_SIZE; idx++)
+        assert(rx[idx] == SOC_PATTERN(2, idx));
+
+    for (int idx = 0; idx < XFER_SIZE; idx++)
+        tx[idx] = HOST_PATTERN(LSB_WORDS_XFER, idx);
+    bitbang_words_xfer(host, &lsb_bus, tx, rx, XFER_SIZE);
+    for (int idx = 0; idx < XFER_SIZE; idx++)
+        assert(rx[idx] == SOC_PATTERN(LSB_WORDS_XFER, idx));
+
+    hwmocker_spi_get_stats(soc_lsb_spi_dev, &stats);
+    assert(stats.xfers == 2);
+    assert(stats.bytes == 2 * XFER_SIZE);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(completed == XFERS);
+    printf("That's all folks!!!\n");
+    return 0;
+}
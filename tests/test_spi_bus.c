@@ -0,0 +1,130 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HOST_SPI_IDX 0
+/* From the config: 4 soc slaves on the host spi bus, chip select n is the soc spi n */
+#define TARGETS 4
+#define SOC_CSN_PIN(x) (12 + 10 * (x))
+#define HOST_CSN0_PIN 114
+#define SOC_QUEUED_PIN 1
+#define SOC2HOST_PIN(x) (x + 100)
+#define WAIT_TIMEOUT_US 1000000
+#define XFER_SIZE 32
+#define HOST_PATTERN(x) (0x40 + (x))
+#define SOC_PATTERN(x) (0x80 + (x))
+
+unsigned char soc_txbufs[TARGETS][XFER_SIZE];
+unsigned char soc_rxbufs[TARGETS][XFER_SIZE];
+volatile int completed;
+
+int spi_complete(void *ctx, int status) {
+    int target = (int)(long)ctx;
+
+    assert(status == XFER_SIZE);
+    for (int idx = 0; idx < XFER_SIZE; idx++)
+        assert(soc_rxbufs[target][idx] == HOST_PATTERN(target));
+    completed++;
+    return 0;
+}
+
+int csn_irq_handler(void) {
+    assert(0);
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    int rc;
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    /* All the targets wait for the master at once */
+    for (int target = 0; target < TARGETS; target++) {
+        void *spi_dev = hwmocker_get_spi_device(soc, target);
+        struct iovec tx_iov = {soc_txbufs[target], XFER_SIZE};
+        struct iovec rx_iov = {soc_rxbufs[target], XFER_SIZE};
+
+        assert(spi_dev);
+        assert(hwmocker_get_gpio_level(soc, SOC_CSN_PIN(target)) == 1);
+        memset(soc_txbufs[target], SOC_PATTERN(target), XFER_SIZE);
+        hwmocker_spi_enable_irq(spi_dev);
+        rc = hwmocker_spi_submit(spi_dev, &tx_iov, 1, &rx_iov, 1, spi_complete,
+                                 (void *)(long)target);
+        assert(rc == 0);
+    }
+    hwmocker_set_gpio_level(soc, SOC_QUEUED_PIN, 1);
+
+    while (completed < TARGETS) {
+        rc = hwmocker_wait_irq(soc, WAIT_TIMEOUT_US);
+        assert(rc == 0);
+    }
+
+    for (int target = 0; target < TARGETS; target++) {
+        rc = hwmocker_gpio_wait_level(soc, SOC_CSN_PIN(target), 1, WAIT_TIMEOUT_US);
+        assert(rc == 0);
+    }
+    printf("%s - %d targets transferred\n", __func__, TARGETS);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *spi_dev = hwmocker_get_spi_device(host, HOST_SPI_IDX);
+    unsigned char txbuf[XFER_SIZE];
+    unsigned char rxbuf[XFER_SIZE];
+    int rc;
+
+    assert(hwmocker_spi_select(spi_dev, TARGETS) == -EINVAL);
+    /* The chip selects stay owned by their spi device */
+    assert(hwmocker_set_gpio_irq_handler(host, HOST_CSN0_PIN, csn_irq_handler) == -EINVAL);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    rc = hwmocker_gpio_wait_level(host, SOC2HOST_PIN(SOC_QUEUED_PIN), 1, WAIT_TIMEOUT_US);
+    assert(rc == 0);
+
+    /* Out of order: each transfer reaches the selected target only */
+    for (int target = TARGETS - 1; target >= 0; target--) {
+        rc = hwmocker_spi_select(spi_dev, target);
+        assert(rc == 0);
+        memset(txbuf, HOST_PATTERN(target), XFER_SIZE);
+        rc = hwmocker_spi_xfer(spi_dev, txbuf, rxbuf, XFER_SIZE);
+        assert(rc == XFER_SIZE);
+        for (int idx = 0; idx < XFER_SIZE; idx++)
+            assert(rxbuf[idx] == SOC_PATTERN(target));
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(completed == TARGETS);
+    printf("That's all folks!!!\n");
+    return 0;
+}
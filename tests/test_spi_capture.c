@@ -0,0 +1,222 @@
+#include <hwmocker/hwmocker.h>
+#include <hwmocker/spi_capture.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SOC_SPI_IDX 4
+#define HOST_SPI_IDX 0
+#define CAPTURE_FILE "test_spi_capture.cap"
+#define PCAP_FILE "test_spi_capture.pcap"
+#define CORRUPT_FILE "test_spi_capture_corrupt.cap"
+/* From the config: a 1KB log holds the header and 6 records of 64 bytes transfers */
+#define CAPTURE_SIZE 1024
+#define XFER_SIZE 64
+#define XFERS 8
+#define CAPTURED 6
+#define HOST_PATTERN(x) (0x10 + (x))
+#define SOC_PATTERN(x) (0x80 + (x))
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    void *spi_dev = hwmocker_get_spi_device(soc, SOC_SPI_IDX);
+    unsigned char txbuf[XFER_SIZE];
+    unsigned char rxbuf[XFER_SIZE];
+    int rc;
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    for (int xfer = 0; xfer < XFERS; xfer++) {
+        /* The last slave tx captured is shorter, the master receives zeros */
+        struct iovec tx_iov = {txbuf, xfer == CAPTURED - 1 ? 1 : XFER_SIZE};
+        struct iovec rx_iov = {rxbuf, XFER_SIZE};
+
+        memset(txbuf, SOC_PATTERN(xfer), XFER_SIZE);
+        rc = hwmocker_spi_xfer_iov(spi_dev, &tx_iov, 1, &rx_iov, 1);
+        assert(rc == XFER_SIZE);
+    }
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *spi_dev = hwmocker_get_spi_device(host, HOST_SPI_IDX);
+    unsigned char txbuf[XFER_SIZE];
+    int rc;
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    for (int xfer = 0; xfer < XFERS; xfer++) {
+        memset(txbuf, HOST_PATTERN(xfer), XFER_SIZE);
+        rc = hwmocker_spi_xfer(spi_dev, txbuf, NULL, XFER_SIZE);
+        assert(rc == XFER_SIZE);
+    }
+    return 0;
+}
+
+/* Reads back the log truncated to its records on close */
+static void check_capture(void) {
+    unsigned char log[CAPTURE_SIZE];
+    struct hwmocker_spi_capture_header *header = (struct hwmocker_spi_capture_header *)log;
+    unsigned long long last_ns = 0;
+    FILE *file = fopen(CAPTURE_FILE, "r");
+    size_t size, offset;
+
+    assert(file);
+    size = fread(log, 1, sizeof(log), file);
+    fclose(file);
+
+    assert(!memcmp(header->magic, HWMOCKER_SPI_CAPTURE_MAGIC, sizeof(header->magic)));
+    assert(header->version == HWMOCKER_SPI_CAPTURE_VERSION);
+    offset = (header->header_size + 7) & ~7U;
+    for (int xfer = 0; xfer < CAPTURED; xfer++) {
+        struct hwmocker_spi_capture_record *record =
+            (struct hwmocker_spi_capture_record *)(log + offset);
+        unsigned char *mosi = (unsigned char *)(record + 1);
+        unsigned char *miso = mosi + ((record->mosi_length + 7) & ~7U);
+        uint32_t miso_length = xfer == CAPTURED - 1 ? 1 : XFER_SIZE;
+
+        assert(offset + sizeof(*record) <= size);
+        assert(record->magic == HWMOCKER_SPI_CAPTURE_RECORD_MAGIC);
+        assert(record->master == HWMOCKER_SPI_CAPTURE_HOST);
+        assert(record->master_index == HOST_SPI_IDX);
+        assert(record->target_index == SOC_SPI_IDX);
+        assert(record->cs == 0);
+        assert(record->length == XFER_SIZE);
+        assert(record->mosi_length == XFER_SIZE);
+        assert(record->miso_length == miso_length);
+        assert(record->timestamp_ns >= last_ns);
+        for (int idx = 0; idx < XFER_SIZE; idx++)
+            assert(mosi[idx] == HOST_PATTERN(xfer));
+        for (uint32_t idx = 0; idx < miso_length; idx++)
+            assert(miso[idx] == SOC_PATTERN(xfer));
+        last_ns = record->timestamp_ns;
+        offset += record->size;
+    }
+    /* The next ones did not fit */
+    assert(offset == size);
+    printf("%s - %d transactions captured in %zu bytes\n", __func__, CAPTURED, size);
+}
+
+#ifdef SPICAP_TOOL
+/* Runs the capture decoder with args, its output in out */
+static int run_spicap(const char *args, char *out, size_t size) {
+    char command[1024];
+    size_t length;
+    FILE *pipe;
+
+    snprintf(command, sizeof(command), "%s %s 2>&1", SPICAP_TOOL, args);
+    pipe = popen(command, "r");
+    assert(pipe);
+    length = fread(out, 1, size - 1, pipe);
+    out[length] = 0;
+    return pclose(pipe);
+}
+
+static int count_lines(const char *out, const char *line) {
+    int count = 0;
+
+    for (const char *match = out; (match = strstr(match, line)); match += strlen(line))
+        count++;
+    return count;
+}
+
+/* Decodes the log to text and to pcap, then a copy with a corrupt record */
+static void check_decoder(void) {
+    const char *record_line = "host spi0 cs0 -> spi4 64 bytes";
+    struct hwmocker_spi_capture_header *header;
+    struct hwmocker_spi_capture_record *record;
+    unsigned char log[CAPTURE_SIZE];
+    uint32_t pcap_header[6], packet[4];
+    char out[8192], summary[128];
+    size_t size;
+    FILE *file;
+    int rc, packets = 0;
+
+    rc = run_spicap("-m host -c 0 " CAPTURE_FILE, out, sizeof(out));
+    assert(rc == 0);
+    assert(count_lines(out, record_line) == CAPTURED);
+    snprintf(summary, sizeof(summary), "%d transactions, %d bytes, 0 incomplete, 0 corrupt",
+             CAPTURED, CAPTURED * XFER_SIZE);
+    assert(strstr(out, summary));
+
+    rc = run_spicap("-m soc " CAPTURE_FILE, out, sizeof(out));
+    assert(rc == 0);
+    assert(strstr(out, "0 transactions, 0 bytes"));
+    rc = run_spicap("-m any " CAPTURE_FILE, out, sizeof(out));
+    assert(rc != 0);
+    assert(strstr(out, "Usage"));
+
+    rc = run_spicap("-w " PCAP_FILE " " CAPTURE_FILE, out, sizeof(out));
+    assert(rc == 0);
+    file = fopen(PCAP_FILE, "r");
+    assert(file);
+    assert(fread(pcap_header, sizeof(pcap_header), 1, file) == 1);
+    assert(pcap_header[0] == 0xa1b23c4d);
+    /* LINKTYPE_USER0 */
+    assert(pcap_header[5] == 147);
+    while (fread(packet, sizeof(packet), 1, file) == 1) {
+        uint32_t miso_length = packets == CAPTURED - 1 ? 1 : XFER_SIZE;
+        assert(packet[2] == packet[3]);
+        assert(packet[3] == sizeof(*record) + XFER_SIZE + miso_length);
+        assert(!fseek(file, packet[2], SEEK_CUR));
+        packets++;
+    }
+    fclose(file);
+    assert(packets == CAPTURED);
+
+    /* Payloads ending past the record are rejected, not read */
+    file = fopen(CAPTURE_FILE, "r");
+    assert(file);
+    size = fread(log, 1, sizeof(log), file);
+    fclose(file);
+    header = (struct hwmocker_spi_capture_header *)log;
+    record = (struct hwmocker_spi_capture_record *)(log + ((header->header_size + 7) & ~7U));
+    record->mosi_length = 0xfffffff0;
+    file = fopen(CORRUPT_FILE, "w");
+    assert(file);
+    assert(fwrite(log, 1, size, file) == size);
+    fclose(file);
+    rc = run_spicap(CORRUPT_FILE, out, sizeof(out));
+    assert(rc == 0);
+    assert(count_lines(out, record_line) == CAPTURED - 1);
+    snprintf(summary, sizeof(summary), "%d transactions, %d bytes, 0 incomplete, 1 corrupt",
+             CAPTURED - 1, (CAPTURED - 1) * XFER_SIZE);
+    assert(strstr(out, summary));
+    printf("%s - %d transactions decoded, %d exported\n", __func__, CAPTURED, packets);
+}
+#endif
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    check_capture();
+#ifdef SPICAP_TOOL
+    check_decoder();
+#endif
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_wait.h"
+
+#define SOC_SPI_IDX 4
+#define HOST_SPI_IDX 0
+#define SOC_DMA_IDX 0
+#define WAIT_TIMEOUT_US 1000000
+#define RING_SIZE 4
+/* The second descriptor ends the first chain, its irq kicks the second one */
+#define CHAIN_END 1
+#define XFER_SIZE 64
+#define SOC_PATTERN(x) (0x80 + (x))
+
+void *soc_dma;
+struct hwmocker_dma_desc ring[RING_SIZE];
+unsigned char txbufs[RING_SIZE][XFER_SIZE];
+unsigned char rxbufs[RING_SIZE][XFER_SIZE];
+volatile unsigned int dma_events;
+volatile int dma_irqs;
+
+int dma_complete(unsigned int status, void *ctx) {
+    assert(ctx == soc_dma);
+    assert(!(status & HWMOCKER_DMA_IRQ_ERROR));
+    if (status & HWMOCKER_DMA_IRQ_DESC) {
+        int rc = hwmocker_dma_kick(soc_dma);
+        assert(rc == 0);
+    }
+    dma_events |= status;
+    dma_irqs++;
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    struct hwmocker_dma_stats stats;
+    int rc;
+
+    soc_dma = hwmocker_get_dma(soc, SOC_DMA_IDX);
+    assert(soc_dma);
+    assert(hwmocker_get_dma(soc, SOC_DMA_IDX + 1) == NULL);
+
+    for (int desc = 0; desc < RING_SIZE; desc++) {
+        memset(txbufs[desc], SOC_PATTERN(desc), XFER_SIZE);
+        ring[desc] = (struct hwmocker_dma_desc){txbufs[desc], rxbufs[desc], XFER_SIZE,
+                                                HWMOCKER_DMA_DESC_OWN | HWMOCKER_DMA_DESC_CHAIN,
+                                                0};
+    }
+    ring[CHAIN_END].flags = HWMOCKER_DMA_DESC_OWN | HWMOCKER_DMA_DESC_IRQ;
+    ring[RING_SIZE - 1].flags = HWMOCKER_DMA_DESC_OWN;
+
+    rc = hwmocker_dma_set_ring(soc_dma, ring, RING_SIZE);
+    assert(rc == 0);
+    /* Not kicked yet, the engine ran nothing and the ring can be set again */
+    rc = hwmocker_dma_set_ring(soc_dma, ring, RING_SIZE);
+    assert(rc == 0);
+    hwmocker_dma_get_stats(soc_dma, &stats);
+    assert(stats.descriptors == 0 && stats.errors == 0);
+    assert(ring[0].flags & HWMOCKER_DMA_DESC_OWN);
+    rc = hwmocker_dma_set_irq_handler(soc_dma,
+                                      HWMOCKER_DMA_IRQ_DESC | HWMOCKER_DMA_IRQ_HALF |
+                                          HWMOCKER_DMA_IRQ_FULL | HWMOCKER_DMA_IRQ_ERROR,
+                                      dma_complete, soc_dma);
+    assert(rc == 0);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    rc = hwmocker_dma_kick(soc_dma);
+    assert(rc == 0);
+    while (!(dma_events & HWMOCKER_DMA_IRQ_FULL)) {
+        rc = hwmocker_wait_irq(soc, WAIT_TIMEOUT_US);
+        assert(rc == 0);
+    }
+    assert(dma_events == (HWMOCKER_DMA_IRQ_DESC | HWMOCKER_DMA_IRQ_HALF | HWMOCKER_DMA_IRQ_FULL));
+
+    for (int desc = 0; desc < RING_SIZE; desc++) {
+        assert(!(__atomic_load_n(&ring[desc].flags, __ATOMIC_ACQUIRE) & HWMOCKER_DMA_DESC_OWN));
+        assert(ring[desc].status == XFER_SIZE);
+        for (int idx = 0; idx < XFER_SIZE; idx++)
+            assert(rxbufs[desc][idx] == desc);
+    }
+
+    hwmocker_dma_get_stats(soc_dma, &stats);
+    assert(stats.descriptors == RING_SIZE);
+    assert(stats.bytes == RING_SIZE * XFER_SIZE);
+    assert(stats.errors == 0);
+    printf("%s - %d descriptors in %d irqs, %llu bytes in %llu ns\n", __func__, RING_SIZE,
+           dma_irqs, stats.bytes, stats.busy_ns);
+
+    /* Left waiting for a master transfer which never comes: the teardown cancels it */
+    __atomic_store_n(&ring[0].flags, HWMOCKER_DMA_DESC_OWN, __ATOMIC_RELEASE);
+    rc = hwmocker_dma_kick(soc_dma);
+    assert(rc == 0);
+    /* The ring cannot be set while the engine runs it */
+    WAIT_UNTIL(hwmocker_dma_set_ring(soc_dma, ring, RING_SIZE) == -EBUSY);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *spi_dev = hwmocker_get_spi_device(host, HOST_SPI_IDX);
+    unsigned char txbuf[XFER_SIZE];
+    unsigned char rxbuf[XFER_SIZE];
+    int rc;
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    for (int xfer = 0; xfer < RING_SIZE; xfer++) {
+        memset(txbuf, xfer, XFER_SIZE);
+        rc = hwmocker_spi_xfer(spi_dev, txbuf, rxbuf, XFER_SIZE);
+        assert(rc == XFER_SIZE);
+        for (int idx = 0; idx < XFER_SIZE; idx++)
+            assert(rxbuf[idx] == SOC_PATTERN(xfer));
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(dma_events & HWMOCKER_DMA_IRQ_FULL);
+    assert((ring[0].flags & HWMOCKER_DMA_DESC_OWN) || ring[0].status == -ECANCELED);
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "test_wait.h"
+
+#define HOST_DMA_IDX 0
+#define XFER_SIZE 64
+
+unsigned char txbuf[XFER_SIZE];
+struct hwmocker_dma_desc ring[1];
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+
+    /* The slave never arms a transfer */
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *host_dma = hwmocker_get_dma(host, HOST_DMA_IDX);
+    int rc;
+
+    assert(host_dma);
+    ring[0] = (struct hwmocker_dma_desc){txbuf, NULL, XFER_SIZE, HWMOCKER_DMA_DESC_OWN, 0};
+    rc = hwmocker_dma_set_ring(host_dma, ring, 1);
+    assert(rc == 0);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    /* Left waiting for the slave without timeout: the teardown cancels it */
+    rc = hwmocker_dma_kick(host_dma);
+    assert(rc == 0);
+    WAIT_UNTIL(hwmocker_dma_set_ring(host_dma, ring, 1) == -EBUSY);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(!(ring[0].flags & HWMOCKER_DMA_DESC_OWN));
+    assert(ring[0].status == -ECANCELED);
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SOC_SPI_IDX 4
+#define HOST_SPI_IDX 0
+/* Soc gpio: its async transfer is queued */
+#define SOC_READY_PIN 1
+#define SOC2HOST_PIN(x) (x + 100)
+#define WAIT_TIMEOUT_US 1000000
+#define CMD_SIZE 4
+#define PAYLOAD_SIZE 252
+#define XFER_SIZE (CMD_SIZE + PAYLOAD_SIZE)
+
+volatile int rx_completed;
+
+/* Byte idx of a transfer carries idx + seed */
+static void fill(unsigned char *buf, size_t size, size_t offset, unsigned char seed) {
+    for (size_t idx = 0; idx < size; idx++)
+        buf[idx] = (unsigned char)(offset + idx + seed);
+}
+
+static void check_iov(const struct iovec *iov, int count, unsigned char seed) {
+    size_t offset = 0;
+    for (int seg = 0; seg < count; seg++) {
+        const unsigned char *buf = (const unsigned char *)iov[seg].iov_base;
+        for (size_t idx = 0; idx < iov[seg].iov_len; idx++)
+            assert(buf[idx] == (unsigned char)(offset + idx + seed));
+        offset += iov[seg].iov_len;
+    }
+    assert(offset == XFER_SIZE);
+}
+
+int async_spi_callback(void *ctx) {
+    (void)ctx;
+    rx_completed++;
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    void *spi_dev = hwmocker_get_spi_device(soc, SOC_SPI_IDX);
+    unsigned char txbuf[XFER_SIZE];
+    unsigned char head[10], middle[100], tail[XFER_SIZE - 110];
+    struct iovec tx_iov[2] = {{txbuf, 50}, {txbuf + 50, XFER_SIZE - 50}};
+    struct iovec rx_iov[3] = {{head, sizeof(head)}, {middle, sizeof(middle)}, {tail, sizeof(tail)}};
+    const struct iovec *borrowed;
+    int borrowed_count;
+    int rc;
+
+    fill(txbuf, XFER_SIZE, 0, 0x80);
+    hwmocker_spi_enable_irq(spi_dev);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    /* The host command and payload segments land in the 3 rx ones */
+    rc = hwmocker_spi_xfer_iov_async(spi_dev, tx_iov, 2, rx_iov, 3, async_spi_callback, NULL);
+    assert(rc == 0);
+    hwmocker_set_gpio_level(soc, SOC_READY_PIN, 1);
+    while (!rx_completed) {
+        rc = hwmocker_wait_irq(soc, WAIT_TIMEOUT_US);
+        assert(rc == 0);
+    }
+    check_iov(rx_iov, 3, 0);
+    printf("%s - scatter-gather transfer succeeded\n", __func__);
+
+    /* Reads the host segments in place, the host waits for the release */
+    rc = hwmocker_spi_xfer_borrow(spi_dev, tx_iov, 2, XFER_SIZE, &borrowed, &borrowed_count);
+    assert(rc == XFER_SIZE);
+    assert(borrowed_count == 2);
+    check_iov(borrowed, borrowed_count, 0);
+    assert(hwmocker_spi_release_borrowed(spi_dev) == 0);
+    assert(hwmocker_spi_release_borrowed(spi_dev) == -EINVAL);
+    printf("%s - borrowing transfer succeeded\n", __func__);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *spi_dev = hwmocker_get_spi_device(host, HOST_SPI_IDX);
+    unsigned char cmd[CMD_SIZE], payload[PAYLOAD_SIZE];
+    unsigned char rxbuf[XFER_SIZE];
+    struct iovec tx_iov[2] = {{cmd, CMD_SIZE}, {payload, PAYLOAD_SIZE}};
+    struct iovec rx_iov[1] = {{rxbuf, XFER_SIZE}};
+    int rc;
+
+    fill(cmd, CMD_SIZE, 0, 0);
+    fill(payload, PAYLOAD_SIZE, CMD_SIZE, 0);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    rc = hwmocker_gpio_wait_level(host, SOC2HOST_PIN(SOC_READY_PIN), 1, WAIT_TIMEOUT_US);
+    assert(rc == 0);
+    rc = hwmocker_spi_xfer_iov(spi_dev, tx_iov, 2, rx_iov, 1);
+    assert(rc == XFER_SIZE);
+    check_iov(rx_iov, 1, 0x80);
+
+    memset(rxbuf, 0, XFER_SIZE);
+    rc = hwmocker_spi_xfer_iov(spi_dev, tx_iov, 2, rx_iov, 1);
+    assert(rc == XFER_SIZE);
+    check_iov(rx_iov, 1, 0x80);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(rx_completed == 1);
+    printf("That's all folks!!!\n");
+    return 0;
+}
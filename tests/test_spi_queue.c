@@ -0,0 +1,130 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SOC_SPI_IDX 4
+#define HOST_SPI_IDX 0
+/* Soc gpios: its transfers are queued, the last one is queued */
+#define SOC_QUEUED_PIN 1
+#define SOC_REQUEUED_PIN 2
+#define SOC2HOST_PIN(x) (x + 100)
+#define WAIT_TIMEOUT_US 1000000
+/* From the config */
+#define QUEUE_DEPTH 4
+#define XFERS (QUEUE_DEPTH + 1)
+#define XFER_SIZE 64
+
+void *soc;
+void *soc_spi_dev;
+unsigned char rxbufs[XFERS][XFER_SIZE];
+struct iovec rx_iovs[XFERS];
+/* Transfer indexes in completion order */
+int completions[XFERS];
+volatile int completed;
+
+int spi_complete(void *ctx, int status) {
+    int xfer = (int)(long)ctx;
+
+    assert(status == XFER_SIZE);
+    completions[completed] = xfer;
+    /* Pipelined: the first completion queues the last transfer */
+    if (xfer == 0) {
+        int rc = hwmocker_spi_submit(soc_spi_dev, NULL, 0, &rx_iovs[QUEUE_DEPTH], 1, spi_complete,
+                                     (void *)(long)QUEUE_DEPTH);
+        assert(rc == 0);
+        hwmocker_set_gpio_level(soc, SOC_REQUEUED_PIN, 1);
+    }
+    completed++;
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    int rc;
+
+    soc = hwmocker_get_soc(mocker);
+    soc_spi_dev = hwmocker_get_spi_device(soc, SOC_SPI_IDX);
+    hwmocker_spi_enable_irq(soc_spi_dev);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    for (int xfer = 0; xfer < XFERS; xfer++)
+        rx_iovs[xfer] = (struct iovec){rxbufs[xfer], XFER_SIZE};
+
+    for (int xfer = 0; xfer < QUEUE_DEPTH; xfer++) {
+        rc = hwmocker_spi_submit(soc_spi_dev, NULL, 0, &rx_iovs[xfer], 1, spi_complete,
+                                 (void *)(long)xfer);
+        assert(rc == 0);
+    }
+    rc = hwmocker_spi_submit(soc_spi_dev, NULL, 0, &rx_iovs[QUEUE_DEPTH], 1, spi_complete,
+                             (void *)(long)QUEUE_DEPTH);
+    assert(rc == -EBUSY);
+    hwmocker_set_gpio_level(soc, SOC_QUEUED_PIN, 1);
+
+    while (completed < XFERS) {
+        rc = hwmocker_wait_irq(soc, WAIT_TIMEOUT_US);
+        assert(rc == 0);
+    }
+
+    for (int xfer = 0; xfer < XFERS; xfer++) {
+        assert(completions[xfer] == xfer);
+        for (int idx = 0; idx < XFER_SIZE; idx++)
+            assert(rxbufs[xfer][idx] == xfer);
+    }
+    printf("%s - %d transfers completed in order\n", __func__, XFERS);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *spi_dev = hwmocker_get_spi_device(host, HOST_SPI_IDX);
+    unsigned char txbuf[XFER_SIZE];
+    int rc;
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    rc = hwmocker_gpio_wait_level(host, SOC2HOST_PIN(SOC_QUEUED_PIN), 1, WAIT_TIMEOUT_US);
+    assert(rc == 0);
+    for (int xfer = 0; xfer < XFERS; xfer++) {
+        if (xfer == QUEUE_DEPTH) {
+            rc = hwmocker_gpio_wait_level(host, SOC2HOST_PIN(SOC_REQUEUED_PIN), 1,
+                                          WAIT_TIMEOUT_US);
+            assert(rc == 0);
+        }
+        memset(txbuf, xfer, XFER_SIZE);
+        rc = hwmocker_spi_xfer(spi_dev, txbuf, NULL, XFER_SIZE);
+        assert(rc == XFER_SIZE);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(completed == XFERS);
+    printf("That's all folks!!!\n");
+    return 0;
+}
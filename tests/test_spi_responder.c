@@ -0,0 +1,136 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_clock.h"
+
+#define SOC_SPI_IDX 4
+#define HOST_SPI_IDX 0
+/* From the responder config */
+#define READ_BIT 0x80
+#define STATUS 90
+#define WHO_AM_I 0x0f
+#define WHO_AM_I_VALUE 107
+#define CTRL 0x20
+/* Also the register of the canned command READ_MANUFACTURER */
+#define ID_REG 0x10
+#define ID_REG_VALUE 51
+#define SAMPLES 0x28
+#define SAMPLES_SIZE 6
+#define READ_ID 159
+#define READ_MANUFACTURER (READ_BIT | ID_REG)
+#define BENCH_XFERS 100000
+
+static const unsigned char samples[SAMPLES_SIZE] = {1, 2, 3, 4, 5, 6};
+void *soc_spi_dev;
+int soc_done;
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    unsigned char buf[SAMPLES_SIZE];
+    int rc;
+
+    soc_spi_dev = hwmocker_get_spi_device(soc, SOC_SPI_IDX);
+    assert(soc_spi_dev);
+    rc = hwmocker_spi_responder_write(soc_spi_dev, SAMPLES, samples, SAMPLES_SIZE);
+    assert(rc == 0);
+    rc = hwmocker_spi_responder_write(soc_spi_dev, READ_BIT, samples, 1);
+    assert(rc == -EINVAL);
+
+    /* The responder answers the master, the slave does not transfer */
+    rc = hwmocker_spi_xfer(soc_spi_dev, NULL, buf, sizeof(buf));
+    assert(rc == -EBUSY);
+
+    /* No slave thread needed past this point */
+    hwmocker_set_soc_ready(mocker);
+    soc_done = 1;
+    return 0;
+}
+
+static void xfer(void *spi_dev, const unsigned char *tx, unsigned char *rx, size_t size) {
+    int rc = hwmocker_spi_xfer(spi_dev, tx, rx, size);
+    assert(rc == (int)size);
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *spi_dev = hwmocker_get_spi_device(host, HOST_SPI_IDX);
+    unsigned char tx[SAMPLES_SIZE + 1], rx[SAMPLES_SIZE + 1], reg;
+    unsigned long long start_ns, bench_ns;
+    int rc;
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    /* Register read, the status clocked out with the command */
+    xfer(spi_dev, (unsigned char[]){READ_BIT | WHO_AM_I, 0}, rx, 2);
+    assert(rx[0] == STATUS && rx[1] == WHO_AM_I_VALUE);
+
+    /* Auto incremented burst read of the registers written by the soc */
+    memset(tx, 0, sizeof(tx));
+    tx[0] = READ_BIT | SAMPLES;
+    xfer(spi_dev, tx, rx, SAMPLES_SIZE + 1);
+    assert(rx[0] == STATUS && !memcmp(rx + 1, samples, SAMPLES_SIZE));
+
+    /* Burst write, read back by both sides */
+    xfer(spi_dev, (unsigned char[]){CTRL, 0x67, 0x01}, NULL, 3);
+    xfer(spi_dev, (unsigned char[]){READ_BIT | CTRL, 0, 0}, rx, 3);
+    assert(rx[1] == 0x67 && rx[2] == 0x01);
+    rc = hwmocker_spi_responder_read(soc_spi_dev, CTRL, &reg, 1);
+    assert(rc == 0 && reg == 0x67);
+
+    /* Read only register */
+    xfer(spi_dev, (unsigned char[]){WHO_AM_I, 0}, NULL, 2);
+    xfer(spi_dev, (unsigned char[]){READ_BIT | WHO_AM_I, 0}, rx, 2);
+    assert(rx[1] == WHO_AM_I_VALUE);
+
+    /* Canned commands, zero padded past their response */
+    xfer(spi_dev, (unsigned char[]){READ_ID, 0, 0, 0, 0}, rx, 5);
+    assert(rx[0] == STATUS && rx[1] == 239 && rx[2] == 64 && rx[3] == 24 && rx[4] == 0);
+    xfer(spi_dev, (unsigned char[]){READ_MANUFACTURER, 0, 0, 0}, rx, 4);
+    assert(rx[0] == STATUS && rx[1] == STATUS && rx[2] == 239 && rx[3] == 23);
+    /* Not the canned command: a read of the register of the command */
+    xfer(spi_dev, (unsigned char[]){READ_MANUFACTURER, 1, 0}, rx, 3);
+    assert(rx[1] == STATUS && rx[2] == ID_REG_VALUE);
+
+    memset(tx, 0, sizeof(tx));
+    tx[0] = READ_BIT | SAMPLES;
+    start_ns = wall_ns();
+    for (int idx = 0; idx < BENCH_XFERS; idx++)
+        xfer(spi_dev, tx, rx, SAMPLES_SIZE + 1);
+    bench_ns = wall_ns() - start_ns;
+    assert(!memcmp(rx + 1, samples, SAMPLES_SIZE));
+    printf("%s - %d register reads in %llu ns, %llu ns per read\n", __func__, BENCH_XFERS,
+           bench_ns, bench_ns / BENCH_XFERS);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(soc_done);
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SOC_SPI_IDX 4
+#define HOST_SPI_IDX 0
+#define WAIT_TIMEOUT_US 1000000
+/* From the config */
+#define RING_SIZE 1024
+#define SOC_WATERMARK 256
+#define HOST_WATERMARK 128
+/* Host samples streamed in tiny writes, soc samples written at once */
+#define HOST_TOTAL (64 * 1024)
+#define HOST_CHUNK 16
+#define SOC_TOTAL 512
+#define SOC_PATTERN(x) ((unsigned char)(0xff - (x)))
+
+void *soc_spi_dev;
+unsigned char soc_rx[HOST_TOTAL];
+volatile size_t soc_received;
+volatile int soc_started, soc_stopped, soc_rx_events;
+volatile int host_rx_events;
+
+static void soc_drain(void) {
+    ssize_t rc;
+    while ((rc = hwmocker_spi_stream_read(soc_spi_dev, soc_rx + soc_received,
+                                          HOST_TOTAL - soc_received)) > 0)
+        soc_received += rc;
+}
+
+int soc_stream_handler(unsigned int events, void *ctx) {
+    assert(ctx == soc_spi_dev);
+    if (events & HWMOCKER_SPI_STREAM_START) {
+        unsigned char samples[SOC_TOTAL];
+        for (int idx = 0; idx < SOC_TOTAL; idx++)
+            samples[idx] = SOC_PATTERN(idx);
+        assert(hwmocker_spi_stream_write(soc_spi_dev, samples, SOC_TOTAL) == SOC_TOTAL);
+        soc_started = 1;
+    }
+    if (events & HWMOCKER_SPI_STREAM_RX)
+        soc_rx_events++;
+    soc_drain();
+    if (events & HWMOCKER_SPI_STREAM_STOP)
+        soc_stopped = 1;
+    return 0;
+}
+
+int host_stream_handler(unsigned int events, void *ctx) {
+    (void)ctx;
+    assert(!(events & (HWMOCKER_SPI_STREAM_START | HWMOCKER_SPI_STREAM_STOP)));
+    if (events & HWMOCKER_SPI_STREAM_RX)
+        host_rx_events++;
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    int rc;
+
+    soc_spi_dev = hwmocker_get_spi_device(soc, SOC_SPI_IDX);
+    assert(hwmocker_spi_stream_start(soc_spi_dev) == -EINVAL);
+    assert(hwmocker_spi_stream_write(soc_spi_dev, "x", 1) == -ENOTCONN);
+    assert(hwmocker_spi_stream_set_handler(soc_spi_dev, RING_SIZE + 1, soc_stream_handler,
+                                           soc_spi_dev) == -EINVAL);
+    rc = hwmocker_spi_stream_set_handler(soc_spi_dev, SOC_WATERMARK, soc_stream_handler,
+                                         soc_spi_dev);
+    assert(rc == 0);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    while (!soc_stopped) {
+        rc = hwmocker_wait_irq(soc, WAIT_TIMEOUT_US);
+        assert(rc == 0);
+    }
+    soc_drain();
+
+    assert(soc_started);
+    assert(soc_received == HOST_TOTAL);
+    for (int idx = 0; idx < HOST_TOTAL; idx++)
+        assert(soc_rx[idx] == (unsigned char)idx);
+    assert(hwmocker_spi_stream_write(soc_spi_dev, "x", 1) == -ENOTCONN);
+    printf("%s - %d bytes streamed, %d watermark irqs\n", __func__, HOST_TOTAL, soc_rx_events);
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *spi_dev = hwmocker_get_spi_device(host, HOST_SPI_IDX);
+    unsigned char txbuf[HOST_TOTAL];
+    unsigned char rxbuf[SOC_TOTAL];
+    size_t written = 0, received = 0;
+    int rc;
+
+    for (int idx = 0; idx < HOST_TOTAL; idx++)
+        txbuf[idx] = idx;
+    rc = hwmocker_spi_stream_set_handler(spi_dev, HOST_WATERMARK, host_stream_handler, NULL);
+    assert(rc == 0);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+
+    assert(hwmocker_spi_stream_stop(spi_dev) == -ENOTCONN);
+    rc = hwmocker_spi_stream_start(spi_dev);
+    assert(rc == 0);
+    assert(hwmocker_spi_stream_start(spi_dev) == -EBUSY);
+    assert(hwmocker_spi_xfer(spi_dev, txbuf, NULL, 1) == -EBUSY);
+
+    while (written < HOST_TOTAL) {
+        ssize_t count = hwmocker_spi_stream_write(spi_dev, txbuf + written, HOST_CHUNK);
+        assert(count >= 0);
+        /* Full until the soc drains its ring */
+        if (!count)
+            sched_yield();
+        written += count;
+    }
+
+    while (received < SOC_TOTAL) {
+        ssize_t count = hwmocker_spi_stream_read(spi_dev, rxbuf + received, SOC_TOTAL - received);
+        assert(count >= 0);
+        if (!count)
+            sched_yield();
+        received += count;
+    }
+    for (int idx = 0; idx < SOC_TOTAL; idx++)
+        assert(rxbuf[idx] == SOC_PATTERN(idx));
+
+    rc = hwmocker_spi_stream_stop(spi_dev);
+    assert(rc == 0);
+    while (!host_rx_events) {
+        rc = hwmocker_wait_irq(host, WAIT_TIMEOUT_US);
+        assert(rc == 0);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(soc_stopped);
+    printf("That's all folks!!!\n");
+    return 0;
+}
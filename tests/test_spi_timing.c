@@ -0,0 +1,162 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_clock.h"
+
+#define SOC_SPI_IDX 4
+#define HOST_SPI_IDX 0
+/* From the config: 1MHz clock, 8 bit words separated by 1us */
+#define CLK_HZ 1000000ULL
+#define WORD_GAP_NS 1000ULL
+#define SMALL_SIZE 1
+#define LARGE_SIZE (1024 * 1024)
+#define XFER_NS(size) ((size) * 8 * 1000000000ULL / CLK_HZ + ((size) - 1) * WORD_GAP_NS)
+/* The virtual time skips the 9.4s of the large transfer */
+#define MAX_WALL_NS 2000000000ULL
+/* Host pin high during the large transfer, traced with the VCD id "!" */
+#define LARGE_XFER_PIN 101
+#define VCD_FILE "test_spi_timing.vcd"
+#define LARGE_XFER_ID "!"
+/* Chip select released high before the trace starts, VCD id "\"" */
+#define CSN_ID "\""
+
+unsigned char txbuf[LARGE_SIZE];
+unsigned char rxbuf[LARGE_SIZE];
+int soc_done;
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    void *spi_dev = hwmocker_get_spi_device(soc, SOC_SPI_IDX);
+    struct hwmocker_spi_stats stats;
+    int rc;
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    rc = hwmocker_spi_xfer(spi_dev, NULL, rxbuf, SMALL_SIZE);
+    assert(rc == SMALL_SIZE);
+    rc = hwmocker_spi_xfer(spi_dev, NULL, rxbuf, LARGE_SIZE);
+    assert(rc == LARGE_SIZE);
+    for (int idx = 0; idx < LARGE_SIZE; idx++)
+        assert(rxbuf[idx] == (unsigned char)idx);
+
+    /* The slave sees the bus time of its transfers */
+    hwmocker_spi_get_stats(spi_dev, &stats);
+    assert(stats.xfers == 2);
+    assert(stats.bytes == SMALL_SIZE + LARGE_SIZE);
+    assert(stats.busy_ns == XFER_NS(SMALL_SIZE) + XFER_NS(LARGE_SIZE));
+    soc_done = 1;
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    void *spi_dev = hwmocker_get_spi_device(host, HOST_SPI_IDX);
+    struct hwmocker_spi_stats stats;
+    unsigned long long start_ns, small_ns, large_ns, wall_start_ns;
+    int rc;
+
+    assert(hwmocker_spi_xfer_duration_ns(spi_dev, SMALL_SIZE) == XFER_NS(SMALL_SIZE));
+    assert(hwmocker_spi_xfer_duration_ns(spi_dev, LARGE_SIZE) == XFER_NS(LARGE_SIZE));
+    for (int idx = 0; idx < LARGE_SIZE; idx++)
+        txbuf[idx] = idx;
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+    hwmocker_spi_reset_stats(spi_dev);
+
+    wall_start_ns = wall_ns();
+    start_ns = hwmocker_get_time_ns(mocker);
+    rc = hwmocker_spi_xfer(spi_dev, txbuf, NULL, SMALL_SIZE);
+    assert(rc == SMALL_SIZE);
+    small_ns = hwmocker_get_time_ns(mocker) - start_ns;
+
+    hwmocker_set_gpio_level(host, LARGE_XFER_PIN, 1);
+    start_ns = hwmocker_get_time_ns(mocker);
+    rc = hwmocker_spi_xfer(spi_dev, txbuf, NULL, LARGE_SIZE);
+    assert(rc == LARGE_SIZE);
+    large_ns = hwmocker_get_time_ns(mocker) - start_ns;
+    hwmocker_set_gpio_level(host, LARGE_XFER_PIN, 0);
+
+    assert(small_ns >= XFER_NS(SMALL_SIZE));
+    assert(large_ns >= XFER_NS(LARGE_SIZE));
+    assert(wall_ns() - wall_start_ns < MAX_WALL_NS);
+
+    hwmocker_spi_get_stats(spi_dev, &stats);
+    assert(stats.xfers == 2);
+    assert(stats.bytes == SMALL_SIZE + LARGE_SIZE);
+    assert(stats.busy_ns == XFER_NS(SMALL_SIZE) + XFER_NS(LARGE_SIZE));
+    assert(stats.elapsed_ns >= stats.busy_ns);
+    printf("%s - %d bytes in %llu ns, %d bytes in %llu ns, bus utilization %.1f%%\n", __func__,
+           SMALL_SIZE, small_ns, LARGE_SIZE, large_ns, 100.0 * stats.busy_ns / stats.elapsed_ns);
+    return 0;
+}
+
+/* The trace is timed on the simulation clock: the pin pulse lasts the large transfer */
+static void check_vcd(void) {
+    FILE *vcd = fopen(VCD_FILE, "r");
+    char line[256];
+    int definitions = 0, dumpvars = 0, csn_level = -1, csn_asserts = 0;
+    unsigned long long time = 0, rise_ns = 0, fall_ns = 0;
+
+    assert(vcd);
+    while (fgets(line, sizeof(line), vcd)) {
+        line[strcspn(line, "\n")] = 0;
+        if (!strcmp(line, "$enddefinitions $end"))
+            definitions = 1;
+        else if (!strcmp(line, "$dumpvars"))
+            dumpvars = 1;
+        else if (!strcmp(line, "$end"))
+            dumpvars = 0;
+        else if (line[0] == '#')
+            time = strtoull(line + 1, NULL, 10);
+        else if (definitions && !dumpvars && !strcmp(line + 1, LARGE_XFER_ID))
+            *(line[0] == '1' ? &rise_ns : &fall_ns) = time;
+        else if (definitions && !strcmp(line + 1, CSN_ID)) {
+            /* Dumped high, then each transfer asserts it with a falling edge */
+            assert(dumpvars ? line[0] == '1' : line[0] != '0' + csn_level);
+            csn_asserts += csn_level == 1 && line[0] == '0';
+            csn_level = line[0] - '0';
+        }
+    }
+    fclose(vcd);
+
+    assert(csn_asserts == 2 && csn_level == 1);
+
+    printf("%s - pin high for %llu ns\n", __func__, fall_ns - rise_ns);
+    assert(fall_ns - rise_ns >= XFER_NS(LARGE_SIZE));
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    /* Flushes the trace */
+    hwmocker_destroy(mocker);
+    check_vcd();
+
+    assert(soc_done);
+    printf("That's all folks!!!\n");
+    return 0;
+}
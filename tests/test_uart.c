@@ -0,0 +1,184 @@
+#include <hwmocker/hwmocker.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_clock.h"
+
+#define HOST_UART_IDX 0
+#define SOC_UART_IDX 1
+#define WAIT_TIMEOUT_US 1000000
+/* From the config: 1Mbaud 8N1 frames of 10 bits, 1KB fifos */
+#define FRAME_NS 10000ULL
+#define FIFO_DEPTH 1024
+#define UPLOAD_SIZE (256 * 1024)
+#define CHUNK_SIZE 1000
+#define RX_THRESHOLD 256
+#define PATTERN(x) ((unsigned char)((x) * 7 + 3))
+/* The virtual time skips the 2.6s of the upload */
+#define MAX_WALL_NS 2000000000ULL
+
+void *soc_uart;
+void *host_uart;
+/* Soc side: upload bytes checked and the irqs taking them */
+volatile size_t received;
+volatile int rx_irqs;
+unsigned int checksum;
+/* Host side events */
+volatile unsigned int host_events;
+
+int soc_uart_irq(unsigned int status, void *ctx) {
+    const void *span;
+    size_t size, consumed;
+
+    assert(ctx == soc_uart);
+    assert(status == HWMOCKER_UART_IRQ_RX);
+    rx_irqs++;
+    /* Checked in place, drained below the threshold to rearm the irq */
+    while ((size = hwmocker_uart_read_span(soc_uart, &span))) {
+        for (size_t idx = 0; idx < size; idx++) {
+            assert(((const unsigned char *)span)[idx] == PATTERN(received + idx));
+            checksum += ((const unsigned char *)span)[idx];
+        }
+        received += size;
+        consumed = hwmocker_uart_consume(soc_uart, size);
+        assert(consumed == size);
+    }
+    /* The tail of the upload is shorter than the threshold */
+    if (received < UPLOAD_SIZE && UPLOAD_SIZE - received < RX_THRESHOLD) {
+        int rc = hwmocker_uart_set_irq_handler(soc_uart, HWMOCKER_UART_IRQ_RX,
+                                               UPLOAD_SIZE - received, soc_uart_irq, soc_uart);
+        assert(rc == 0);
+    }
+    return 0;
+}
+
+int soc_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *soc = hwmocker_get_soc(mocker);
+    int rc;
+
+    soc_uart = hwmocker_get_uart(soc, SOC_UART_IDX);
+    assert(soc_uart);
+    assert(hwmocker_get_uart(soc, SOC_UART_IDX + 1) == NULL);
+    rc = hwmocker_uart_set_irq_handler(soc_uart, HWMOCKER_UART_IRQ_RX, FIFO_DEPTH + 1,
+                                       soc_uart_irq, soc_uart);
+    assert(rc == -EINVAL);
+    rc = hwmocker_uart_set_irq_handler(soc_uart, HWMOCKER_UART_IRQ_RX, RX_THRESHOLD,
+                                       soc_uart_irq, soc_uart);
+    assert(rc == 0);
+
+    hwmocker_set_soc_ready(mocker);
+    hwmocker_wait_host_ready(mocker);
+
+    while (received < UPLOAD_SIZE) {
+        rc = hwmocker_wait_irq(soc, WAIT_TIMEOUT_US);
+        assert(rc == 0 || received == UPLOAD_SIZE);
+    }
+    assert(received == UPLOAD_SIZE);
+    assert(rx_irqs < UPLOAD_SIZE / RX_THRESHOLD);
+
+    /* Answers the checksum */
+    rc = hwmocker_uart_write(soc_uart, &checksum, sizeof(checksum));
+    assert(rc == sizeof(checksum));
+    printf("%s - %d bytes received in %d irqs\n", __func__, UPLOAD_SIZE, rx_irqs);
+    return 0;
+}
+
+int host_uart_irq(unsigned int status, void *ctx) {
+    assert(ctx == host_uart);
+    host_events |= status;
+    return 0;
+}
+
+int host_main(void *priv) {
+    struct hwmocker *mocker = *((struct hwmocker **)priv);
+    void *host = hwmocker_get_host(mocker);
+    static unsigned char upload[UPLOAD_SIZE];
+    struct hwmocker_uart_stats stats;
+    unsigned long long start_ns, elapsed_ns, wall_start_ns;
+    unsigned int expected = 0, answer;
+    size_t sent = 0;
+    int rc;
+
+    host_uart = hwmocker_get_uart(host, HOST_UART_IDX);
+    for (int idx = 0; idx < UPLOAD_SIZE; idx++) {
+        upload[idx] = PATTERN(idx);
+        expected += upload[idx];
+    }
+    assert(hwmocker_uart_xfer_duration_ns(host_uart, UPLOAD_SIZE) == UPLOAD_SIZE * FRAME_NS);
+    rc = hwmocker_uart_set_irq_handler(host_uart,
+                                       HWMOCKER_UART_IRQ_RX | HWMOCKER_UART_IRQ_TX_EMPTY,
+                                       sizeof(answer), host_uart_irq, host_uart);
+    assert(rc == 0);
+
+    hwmocker_set_host_ready(mocker);
+    hwmocker_wait_soc_ready(mocker);
+    hwmocker_uart_reset_stats(host_uart);
+
+    wall_start_ns = wall_ns();
+    start_ns = hwmocker_get_time_ns(mocker);
+    while (sent < UPLOAD_SIZE) {
+        size_t chunk = UPLOAD_SIZE - sent < CHUNK_SIZE ? UPLOAD_SIZE - sent : CHUNK_SIZE;
+        ssize_t written = hwmocker_uart_write(host_uart, upload + sent, chunk);
+        assert(written >= 0);
+        sent += written;
+        /* Full: waits for the soc to drain its fifo */
+        if (!written) {
+            while (!(host_events & HWMOCKER_UART_IRQ_TX_EMPTY)) {
+                rc = hwmocker_wait_irq(host, WAIT_TIMEOUT_US);
+                assert(rc == 0);
+            }
+        }
+        /* Not to lose an event set by the handler meanwhile */
+        __atomic_fetch_and(&host_events, ~HWMOCKER_UART_IRQ_TX_EMPTY, __ATOMIC_RELAXED);
+    }
+
+    while (!(host_events & HWMOCKER_UART_IRQ_RX)) {
+        rc = hwmocker_wait_irq(host, WAIT_TIMEOUT_US);
+        assert(rc == 0);
+    }
+    assert(hwmocker_uart_rx_level(host_uart) == sizeof(answer));
+    rc = hwmocker_uart_read(host_uart, &answer, sizeof(answer));
+    assert(rc == sizeof(answer));
+    assert(answer == expected);
+    elapsed_ns = hwmocker_get_time_ns(mocker) - start_ns;
+
+    /* Paced by the line, a fifo ahead of it at most */
+    assert(elapsed_ns >= (UPLOAD_SIZE - FIFO_DEPTH) * FRAME_NS);
+    assert(wall_ns() - wall_start_ns < MAX_WALL_NS);
+    hwmocker_uart_get_stats(host_uart, &stats);
+    assert(stats.tx_bytes == UPLOAD_SIZE);
+    assert(stats.rx_bytes == sizeof(answer));
+    assert(stats.busy_ns == UPLOAD_SIZE * FRAME_NS);
+    printf("%s - %d bytes uploaded in %llu ns, line utilization %.1f%%\n", __func__,
+           UPLOAD_SIZE, elapsed_ns, 100.0 * stats.busy_ns / stats.elapsed_ns);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct hwmocker *mocker;
+    int rc;
+
+    if (argc != 2) {
+        fprintf(stderr, "No config file given\n");
+        fprintf(stderr, "Usage: %s <config JSON file>\n", argv[0]);
+        return -EINVAL;
+    }
+
+    mocker = hwmocker_create(argv[1], host_main, &mocker, soc_main, &mocker);
+    if (!mocker)
+        return -ENOMEM;
+
+    rc = hwmocker_start(mocker);
+    printf("hwmocker_start returned %d\n", rc);
+
+    hwmocker_wait(mocker);
+    hwmocker_destroy(mocker);
+
+    assert(received == UPLOAD_SIZE);
+    printf("That's all folks!!!\n");
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef __HWMOCKER_TEST_WAIT_H__
+#define __HWMOCKER_TEST_WAIT_H__
+
+#include <assert.h>
+#include <sched.h>
+
+#include "test_clock.h"
+
+/* Longest wall time a test waits for the other processing unit or for an irq handler */
+#define WAIT_TIMEOUT_NS 1000000000ULL
+
+/* Yield until cond holds, asserts if it still does not after WAIT_TIMEOUT_NS */
+#define WAIT_UNTIL(cond)                                                                         \
+    do {                                                                                         \
+        unsigned long long __deadline_ns = wall_ns() + WAIT_TIMEOUT_NS;                          \
+        while (!(cond)) {                                                                        \
+            assert(wall_ns() < __deadline_ns);                                                   \
+            sched_yield();                                                                       \
+        }                                                                                        \
+    } while (0)
+
+#endif /* __HWMOCKER_TEST_WAIT_H__ */
@@ -0,0 +1,280 @@
+/*
+ * MIT License - Copyright (c) 2023 Jean-Christophe PINCE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Decoder of the spi capture logs: prints the transactions, filtered on their master, chip select
+ * and time, or exports them to a pcap file of LINKTYPE_USER0 packets holding the record header
+ * and the payloads.
+ */
+
+#include <hwmocker/spi_capture.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAP_LINKTYPE_USER0 147
+#define PCAP_SNAPLEN 262144
+#define PREVIEW_BYTES 16
+
+struct filter {
+    int master; /* HWMOCKER_SPI_CAPTURE_HOST, HWMOCKER_SPI_CAPTURE_SOC or -1 for any */
+    int master_index;
+    int target_index;
+    int cs;
+    unsigned long long start_ns;
+    unsigned long long end_ns;
+};
+
+struct pcap_header {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+};
+
+struct pcap_packet {
+    uint32_t ts_sec;
+    uint32_t ts_nsec;
+    uint32_t caplen;
+    uint32_t len;
+};
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [-m host|soc] [-d master_idx] [-t target_idx] [-c cs] [-s start_ns]\n"
+            "          [-e end_ns] [-x] [-q] [-w out.pcap] <capture file>\n"
+            "  -x: dump the whole payloads, -q: summary only, -w: export to pcap\n",
+            name);
+}
+
+static bool match(const struct filter *filter, const struct hwmocker_spi_capture_record *record) {
+    return (filter->master < 0 || record->master == filter->master) &&
+           (filter->master_index < 0 || record->master_index == filter->master_index) &&
+           (filter->target_index < 0 || record->target_index == filter->target_index) &&
+           (filter->cs < 0 || record->cs == filter->cs) &&
+           record->timestamp_ns >= filter->start_ns && record->timestamp_ns <= filter->end_ns;
+}
+
+/* The payloads end within the record, a corrupt one would make them read past the log */
+static bool record_fits(const struct hwmocker_spi_capture_record *record, uint32_t size) {
+    return sizeof(*record) + ((record->mosi_length + 7ULL) & ~7ULL) + record->miso_length <= size;
+}
+
+static void print_payload(const char *name, const uint8_t *payload, uint32_t length, bool all) {
+    uint32_t shown = all || length < PREVIEW_BYTES ? length : PREVIEW_BYTES;
+
+    printf("  %s:", name);
+    for (uint32_t idx = 0; idx < shown; idx++) {
+        if (idx && !(idx % 32))
+            printf("\n       ");
+        printf(" %02x", payload[idx]);
+    }
+    if (shown < length)
+        printf(" ...");
+    printf("\n");
+}
+
+static void print_record(const struct hwmocker_spi_capture_record *record, bool all) {
+    const uint8_t *mosi = (const uint8_t *)(record + 1);
+    const uint8_t *miso = mosi + ((record->mosi_length + 7) & ~7U);
+
+    printf("%llu.%09llu %s spi%u cs%u -> spi%u %u bytes\n",
+           (unsigned long long)record->timestamp_ns / 1000000000ULL,
+           (unsigned long long)record->timestamp_ns % 1000000000ULL,
+           record->master == HWMOCKER_SPI_CAPTURE_HOST ? "host" : "soc", record->master_index,
+           record->cs, record->target_index, record->length);
+    print_payload("mosi", mosi, record->mosi_length, all);
+    print_payload("miso", miso, record->miso_length, all);
+}
+
+static int write_packet(FILE *pcap, const struct hwmocker_spi_capture_record *record) {
+    const uint8_t *mosi = (const uint8_t *)(record + 1);
+    const uint8_t *miso = mosi + ((record->mosi_length + 7) & ~7U);
+    uint32_t len = sizeof(*record) + record->mosi_length + record->miso_length;
+    struct pcap_packet packet = {
+        .ts_sec = record->timestamp_ns / 1000000000ULL,
+        .ts_nsec = record->timestamp_ns % 1000000000ULL,
+        .caplen = len < PCAP_SNAPLEN ? len : PCAP_SNAPLEN,
+        .len = len,
+    };
+    uint32_t left = packet.caplen;
+    uint32_t chunk;
+
+    if (fwrite(&packet, sizeof(packet), 1, pcap) != 1)
+        return -EIO;
+
+    chunk = left < sizeof(*record) ? left : sizeof(*record);
+    fwrite(record, 1, chunk, pcap);
+    left -= chunk;
+    chunk = left < record->mosi_length ? left : record->mosi_length;
+    fwrite(mosi, 1, chunk, pcap);
+    left -= chunk;
+    chunk = left < record->miso_length ? left : record->miso_length;
+    fwrite(miso, 1, chunk, pcap);
+    return ferror(pcap) ? -EIO : 0;
+}
+
+int main(int argc, char **argv) {
+    struct filter filter = {-1, -1, -1, -1, 0, ~0ULL};
+    const char *pcap_path = NULL;
+    bool all = false, quiet = false;
+    unsigned long long records = 0, bytes = 0, incomplete = 0, corrupt = 0;
+    FILE *pcap = NULL;
+    struct stat st;
+    int opt, fd;
+
+    while ((opt = getopt(argc, argv, "m:d:t:c:s:e:xqw:")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (!strcmp(optarg, "host")) {
+                filter.master = HWMOCKER_SPI_CAPTURE_HOST;
+            } else if (!strcmp(optarg, "soc")) {
+                filter.master = HWMOCKER_SPI_CAPTURE_SOC;
+            } else {
+                usage(argv[0]);
+                return EINVAL;
+            }
+            break;
+        case 'd':
+            filter.master_index = atoi(optarg);
+            break;
+        case 't':
+            filter.target_index = atoi(optarg);
+            break;
+        case 'c':
+            filter.cs = atoi(optarg);
+            break;
+        case 's':
+            filter.start_ns = strtoull(optarg, NULL, 0);
+            break;
+        case 'e':
+            filter.end_ns = strtoull(optarg, NULL, 0);
+            break;
+        case 'x':
+            all = true;
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        case 'w':
+            pcap_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return EINVAL;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return EINVAL;
+    }
+
+    fd = open(argv[optind], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st)) {
+        perror(argv[optind]);
+        return errno;
+    }
+    if ((size_t)st.st_size < sizeof(struct hwmocker_spi_capture_header)) {
+        fprintf(stderr, "%s: not a spi capture\n", argv[optind]);
+        return EINVAL;
+    }
+
+    const uint8_t *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        return errno;
+    }
+    madvise((void *)base, st.st_size, MADV_SEQUENTIAL);
+
+    const struct hwmocker_spi_capture_header *header =
+        (const struct hwmocker_spi_capture_header *)base;
+    if (memcmp(header->magic, HWMOCKER_SPI_CAPTURE_MAGIC, sizeof(header->magic)) ||
+        header->version != HWMOCKER_SPI_CAPTURE_VERSION) {
+        fprintf(stderr, "%s: not a spi capture version %d\n", argv[optind],
+                HWMOCKER_SPI_CAPTURE_VERSION);
+        return EINVAL;
+    }
+
+    if (pcap_path) {
+        struct pcap_header pcap_header = {PCAP_MAGIC_NS, 2, 4, 0, 0, PCAP_SNAPLEN,
+                                          PCAP_LINKTYPE_USER0};
+        pcap = fopen(pcap_path, "w");
+        if (!pcap || fwrite(&pcap_header, sizeof(pcap_header), 1, pcap) != 1) {
+            perror(pcap_path);
+            return errno;
+        }
+    }
+
+    size_t offset = (header->header_size + 7) & ~7U;
+    while (offset + sizeof(struct hwmocker_spi_capture_record) <= (size_t)st.st_size) {
+        const struct hwmocker_spi_capture_record *record =
+            (const struct hwmocker_spi_capture_record *)(base + offset);
+        uint32_t size = __atomic_load_n(&record->size, __ATOMIC_RELAXED);
+        if (size < sizeof(*record) || offset + size > (size_t)st.st_size)
+            break;
+        offset += size;
+
+        // Cut while being written
+        if (__atomic_load_n(&record->magic, __ATOMIC_ACQUIRE) !=
+            HWMOCKER_SPI_CAPTURE_RECORD_MAGIC) {
+            incomplete++;
+            continue;
+        }
+        if (!record_fits(record, size)) {
+            corrupt++;
+            continue;
+        }
+        if (!match(&filter, record))
+            continue;
+
+        records++;
+        bytes += record->length;
+        if (pcap && write_packet(pcap, record)) {
+            perror(pcap_path);
+            return EIO;
+        }
+        if (!quiet && !pcap)
+            print_record(record, all);
+    }
+
+    if (pcap && fclose(pcap)) {
+        perror(pcap_path);
+        return errno;
+    }
+    fprintf(stderr, "%llu transactions, %llu bytes, %llu incomplete, %llu corrupt\n", records,
+            bytes, incomplete, corrupt);
+    munmap((void *)base, st.st_size);
+    close(fd);
+    return 0;
+}